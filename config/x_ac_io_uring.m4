@@ -0,0 +1,56 @@
+##*****************************************************************************
+## $Id$
+##*****************************************************************************
+#  AUTHOR:
+#    Mark Grondona <mgrondona@llnl.gov>
+#
+#  SYNOPSIS:
+#    X_AC_IO_URING
+#
+#  DESCRIPTION:
+#    Adds support for the "--disable-io-uring" configure script option.
+#    By default libedac is built with support for batched counter reads
+#    through io_uring(7) if <linux/io_uring.h> is available. No library
+#    is required; at run time libedac falls back to pread(2) if the
+#    kernel does not support io_uring. Defines HAVE_IO_URING.
+#
+#  WARNINGS:
+#    This macro must be placed after AC_PROG_CC or equivalent.
+##*****************************************************************************
+
+AC_DEFUN([X_AC_IO_URING],
+[
+  AC_ARG_ENABLE(
+    [io-uring],
+    AS_HELP_STRING([--disable-io-uring],
+                   [do not batch counter reads with io_uring]),
+    [ case "$enableval" in
+        yes) x_ac_io_uring=yes ;;
+         no) x_ac_io_uring=no ;;
+          *) AC_MSG_ERROR([bad value "$enableval" for --enable-io-uring]) ;;
+      esac
+    ]
+  )
+
+  if test "${x_ac_io_uring=yes}" = "yes"; then
+    AC_MSG_CHECKING([for io_uring support])
+    AC_COMPILE_IFELSE(
+       [AC_LANG_PROGRAM([[#include <sys/syscall.h>
+                          #include <linux/io_uring.h>]],
+                        [[struct io_uring_params p;
+                          struct io_uring_probe pr;
+                          int op = IORING_OP_READ + IORING_REGISTER_PROBE;
+                          long n = SYS_io_uring_setup + SYS_io_uring_enter
+                                 + SYS_io_uring_register;
+                          (void) p; (void) pr; (void) op; (void) n;]])],
+       [x_ac_io_uring=yes],
+       [x_ac_io_uring=no]
+    )
+    AC_MSG_RESULT([$x_ac_io_uring])
+  fi
+
+  if test "$x_ac_io_uring" = "yes"; then
+    AC_DEFINE([HAVE_IO_URING], [1],
+              [Define to 1 to batch counter reads with io_uring])
+  fi
+])
@@ -8,7 +8,10 @@
 #    X_AC_LIBSYSFS
 #
 #  DESCRIPTION:
-#    Adds support for the "--with-libsysfs=PATH" configure script option.
+#    Adds support for the "--with-libsysfs" configure script option.
+#    By default libedac uses its own built-in sysfs scanner. With
+#    --with-libsysfs, libedac is built against libsysfs instead, and
+#    WITH_LIBSYSFS is set for automake.
 #
 #  WARNINGS:
 #    This macro must be placed after AC_PROG_CC or equivalent.
@@ -16,35 +19,59 @@
 
 AC_DEFUN([X_AC_LIBSYSFS],
 [
-  AC_MSG_CHECKING([for libsysfs])
-  savedLIBS="$LIBS"
-  LIBS="-lsysfs $LIBS"
-  AC_LINK_IFELSE(
-     [AC_LANG_PROGRAM([[#include <sysfs/libsysfs.h>]], 
-                     [[char buf[4096]; sysfs_get_mnt_path (buf, 4096)]])],
-     [ac_have_libsysfs=yes], 
-     [ac_have_sysfs=no]
+  AC_MSG_CHECKING([whether to use libsysfs])
+  AC_ARG_WITH(
+    [libsysfs],
+    AS_HELP_STRING([--with-libsysfs], 
+                   [use libsysfs instead of built-in sysfs scanner]),
+    [ case "$withval" in
+        yes) x_ac_libsysfs=yes ;;
+         no) x_ac_libsysfs=no ;;
+          *) AC_MSG_RESULT([doh!])
+             AC_MSG_ERROR([bad value "$withval" for --with-libsysfs]) ;;
+      esac
+    ]
   )
-  AC_MSG_RESULT([${ac_have_libsysfs=no}]) 
-  if test "$ac_have_libsysfs" = "yes"; then
-    LIBSYSFS_LIBS="-lsysfs"
-    AC_DEFINE([HAVE_LIBSYSFS], [1], [Define to 1 if you have libsysfs])
-  else
-    AC_MSG_ERROR("Unable to find working libsysfs library!")
-  fi
+  AC_MSG_RESULT([${x_ac_libsysfs=no}])
 
-  AC_MSG_CHECKING([for sysfs_open_device_tree in libsysfs])
-  AC_LINK_IFELSE(
-	  [AC_LANG_PROGRAM(
-		  [[#include <sysfs/libsysfs.h>]],
-		  [[struct sysfs_device *d = sysfs_open_device_tree("/sys"); 
-		    sysfs_close_device(d);]])],
-	  [AC_DEFINE([HAVE_SYSFS_OPEN_DEVICE_TREE], [1], 
-		         [Define to 1 if libsysfs has sysfs_open_device_tree.])],
-	  [ac_have_sysfs_open_device_tree=no]
-  )
-  AC_MSG_RESULT([${ac_have_sysfs_open_device_tree=yes}]) 
+  if test "$x_ac_libsysfs" = "yes"; then
+    AC_CHECK_HEADER([sysfs/libsysfs.h], [],
+		    [AC_MSG_ERROR(
+	             [Required header file sysfs/libsysfs.h not found.])
+		    ])
+
+    AC_MSG_CHECKING([for libsysfs])
+    savedLIBS="$LIBS"
+    LIBS="-lsysfs $LIBS"
+    AC_LINK_IFELSE(
+       [AC_LANG_PROGRAM([[#include <sysfs/libsysfs.h>]], 
+                       [[char buf[4096]; sysfs_get_mnt_path (buf, 4096)]])],
+       [ac_have_libsysfs=yes], 
+       [ac_have_sysfs=no]
+    )
+    AC_MSG_RESULT([${ac_have_libsysfs=no}]) 
+    if test "$ac_have_libsysfs" = "yes"; then
+      LIBSYSFS_LIBS="-lsysfs"
+      AC_DEFINE([HAVE_LIBSYSFS], [1], [Define to 1 if you have libsysfs])
+    else
+      AC_MSG_ERROR("Unable to find working libsysfs library!")
+    fi
+
+    AC_MSG_CHECKING([for sysfs_open_device_tree in libsysfs])
+    AC_LINK_IFELSE(
+	    [AC_LANG_PROGRAM(
+		    [[#include <sysfs/libsysfs.h>]],
+		    [[struct sysfs_device *d = sysfs_open_device_tree("/sys"); 
+		      sysfs_close_device(d);]])],
+	    [AC_DEFINE([HAVE_SYSFS_OPEN_DEVICE_TREE], [1], 
+		           [Define to 1 if libsysfs has sysfs_open_device_tree.])],
+	    [ac_have_sysfs_open_device_tree=no]
+    )
+    AC_MSG_RESULT([${ac_have_sysfs_open_device_tree=yes}]) 
+
+    LIBS="$savedLIBS"
+  fi
 
-  LIBS=$saveLIBS;
+  AM_CONDITIONAL([WITH_LIBSYSFS], [test "$x_ac_libsysfs" = "yes"])
   AC_SUBST([LIBSYSFS_LIBS])
 ])
@@ -8,15 +8,14 @@ License:   GPL
 Source:    %{name}-%{version}.tgz
 BuildRoot: %{_tmppath}/%{name}-%{version}
 
-%{?el5:%define _with_libsysfs 1}
-%{?el6:%define _with_libsysfs 1}
-
+# libedac uses a built-in sysfs scanner by default. 
+#  Build with `rpmbuild --with libsysfs' to link against libsysfs instead.
 %if 0%{?_with_libsysfs}
-BuildRequires: libsysfs-devel
-Requires: libsysfs
-%else
-BuildRequires: sysfsutils-devel
-Requires: sysfsutils
+%{?el5:%define _libsysfs_pkg libsysfs}
+%{?el6:%define _libsysfs_pkg libsysfs}
+%{!?_libsysfs_pkg:%define _libsysfs_pkg sysfsutils}
+BuildRequires: %{_libsysfs_pkg}-devel
+Requires: %{_libsysfs_pkg}
 %endif
 
 %define debug_package %{nil}
@@ -36,7 +35,7 @@ sysfs files.
 %setup
 
 %build
-%configure
+%configure %{?_with_libsysfs:--with-libsysfs}
 make %{_smp_mflags} CFLAGS="$RPM_OPT_FLAGS"
 
 %install
@@ -63,6 +62,7 @@ fi
 %defattr(-,root,root,0755)
 %doc README NEWS DISCLAIMER
 %{_sbindir}/edac-ctl
+%{_sbindir}/edac-labels
 %{_bindir}/edac-util
 %{_libdir}/*
 %{_mandir}/*/*
@@ -0,0 +1,257 @@
+/*****************************************************************************
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2005-2007 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  Written by Mark Grondona <mgrondona@llnl.gov>
+ *  UCRL-CODE-230739.
+ *
+ *  This file is part of edac-utils.
+ *
+ *  This is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *****************************************************************************/
+
+/*
+ *  edac-bench: measure libedac latency.
+ *
+ *  Times repeated edac_handle_create ()/edac_handle_init ()/
+ *   edac_handle_destroy () cycles, edac_handle_refresh (), and a full
+ *   report walk over all MCs, csrows and DIMMs, against the EDAC sysfs
+ *   tree or a synthetic tree from edac-mktree (--root). Building
+ *   libedac with and without --with-libsysfs compares the backends.
+ *   Refresh is timed twice: with the default counter reads (batched
+ *   through io_uring when available) and with one pread(2) per
+ *   counter (EDAC_IO_URING=0). --threads runs every handle with
+ *   edac_handle_set_threads () for the parallel scan and refresh.
+ */
+
+#if HAVE_CONFIG_H
+#  include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+
+#include <edac.h>
+
+#if HAVE_LIBSYSFS
+#  define BACKEND "libsysfs"
+#else
+#  define BACKEND "native"
+#endif
+
+#define USAGE "\
+Usage: %s [OPTIONS]\n\
+  -h, --help           Display this help\n\
+  -n, --iterations=N   Number of iterations per measurement (default 1000)\n\
+  -r, --root=DIR       Read EDAC data from DIR instead of sysfs\n\
+  -t, --threads=N      Scan and refresh with N threads (default 1)\n\
+  -H, --no-header      Do not print the column header\n"
+
+struct option opt_table[] = {
+    { "help",         0, NULL, 'h' },
+    { "iterations",   1, NULL, 'n' },
+    { "root",         1, NULL, 'r' },
+    { "threads",      1, NULL, 't' },
+    { "no-header",    0, NULL, 'H' },
+    {  NULL,          0, NULL,  0  }
+};
+
+const char * const opt_string = "hn:r:t:H";
+
+static const char *root = NULL;
+static int         nthreads = 1;
+
+static double now_usec (void)
+{
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (ts.tv_sec * 1.0e6 + ts.tv_nsec / 1.0e3);
+}
+
+static edac_handle * handle_open (void)
+{
+    edac_handle *edac = edac_handle_create ();
+
+    if (!edac || (edac_handle_set_root (edac, root) < 0)
+       || (edac_handle_set_threads (edac, nthreads) < 0)
+       || (edac_handle_init (edac) < 0)) {
+        fprintf (stderr, "edac-bench: Unable to get EDAC data: %s\n",
+                 edac ? edac_strerror (edac) : "Out of memory");
+        exit (1);
+    }
+
+    return (edac);
+}
+
+static double bench_init (int iterations)
+{
+    double t0;
+    int    i;
+
+    t0 = now_usec ();
+    for (i = 0; i < iterations; i++)
+        edac_handle_destroy (handle_open ());
+
+    return ((now_usec () - t0) / iterations);
+}
+
+static double bench_refresh (edac_handle *edac, int iterations)
+{
+    double t0;
+    int    i;
+
+    t0 = now_usec ();
+    for (i = 0; i < iterations; i++) {
+        if (edac_handle_refresh (edac) < 0) {
+            fprintf (stderr, "edac-bench: refresh: %s\n",
+                     edac_strerror (edac));
+            exit (1);
+        }
+    }
+
+    return ((now_usec () - t0) / iterations);
+}
+
+/*  Walk everything a report would print, the same way edac-util does.
+ */
+static unsigned int report_walk (edac_handle *edac)
+{
+    edac_mc *              mc;
+    edac_csrow *           csrow;
+    edac_dimm *            dimm;
+    struct edac_mc_info    mci;
+    struct edac_csrow_info csi;
+    struct edac_dimm_info  di;
+    struct edac_totals     tot;
+    unsigned int           count = 0;
+    int                    i;
+
+    edac_for_each_mc_info (edac, mc, mci) {
+        count += mci.ce_noinfo_count + mci.ue_noinfo_count;
+        edac_for_each_csrow_info (mc, csrow, csi) {
+            count += csi.ue_count;
+            for (i = 0; i < EDAC_MAX_CHANNELS; i++)
+                count += csi.channel[i].ce_count;
+        }
+        edac_for_each_dimm_info (mc, dimm, di)
+            count += di.ce_count + di.ue_count;
+    }
+
+    edac_error_totals (edac, &tot);
+
+    return (count + tot.ce_total);
+}
+
+static double bench_report (edac_handle *edac, int iterations)
+{
+    volatile unsigned int sink = 0;
+    double                t0;
+    int                   i;
+
+    t0 = now_usec ();
+    for (i = 0; i < iterations; i++) {
+        edac_handle_refresh (edac);
+        sink += report_walk (edac);
+    }
+
+    return ((now_usec () - t0) / iterations);
+}
+
+int main (int ac, char *av[])
+{
+    edac_handle *edac;
+    edac_handle *serial;
+    edac_mc *    mc;
+    unsigned int ncsrows = 0;
+    unsigned int ndimms = 0;
+    int          iterations = 1000;
+    int          header = 1;
+    int          c;
+
+    while ((c = getopt_long (ac, av, opt_string, opt_table, NULL)) != -1) {
+        switch (c) {
+            case 'h':
+                fprintf (stdout, USAGE, av[0]);
+                exit (0);
+            case 'n':
+                iterations = strtol (optarg, NULL, 10);
+                break;
+            case 'r':
+                root = optarg;
+                break;
+            case 't':
+                nthreads = strtol (optarg, NULL, 10);
+                break;
+            case 'H':
+                header = 0;
+                break;
+            default:
+                fprintf (stderr, USAGE, av[0]);
+                exit (1);
+        }
+    }
+
+    if (iterations <= 0) {
+        fprintf (stderr, "edac-bench: Invalid iteration count\n");
+        exit (1);
+    }
+
+    if (nthreads <= 0) {
+        fprintf (stderr, "edac-bench: Invalid thread count\n");
+        exit (1);
+    }
+
+    edac = handle_open ();
+
+    /*  EDAC_IO_URING_ENV is read whenever the counter table is built,
+     *   which includes the lazy csrow/DIMM load, so keep it set until
+     *   the serial handle has loaded everything.
+     */
+    setenv (EDAC_IO_URING_ENV, "0", 1);
+    serial = handle_open ();
+    while ((mc = edac_next_mc (serial)))
+        edac_mc_csrow_count (mc);
+    unsetenv (EDAC_IO_URING_ENV);
+
+    while ((mc = edac_next_mc (edac))) {
+        ncsrows += edac_mc_csrow_count (mc);
+        ndimms += edac_mc_dimm_count (mc);
+    }
+
+    if (header)
+        fprintf (stdout, "%-8s %7s %6s %7s %6s %12s %12s %12s %12s\n",
+                 "backend", "threads", "mcs", "csrows", "dimms",
+                 "init(us)", "refresh(us)", "pread(us)", "report(us)");
+
+    fprintf (stdout, "%-8s %7d %6u %7u %6u %12.2f %12.2f %12.2f %12.2f\n",
+             BACKEND, nthreads, edac_mc_count (edac), ncsrows, ndimms,
+             bench_init (iterations),
+             bench_refresh (edac, iterations),
+             bench_refresh (serial, iterations),
+             bench_report (edac, iterations));
+
+    edac_handle_destroy (serial);
+    edac_handle_destroy (edac);
+
+    return (0);
+}
+
+/*
+ * vi: ts=4 sw=4 expandtab
+ */
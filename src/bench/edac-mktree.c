@@ -0,0 +1,654 @@
+/*****************************************************************************
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2005-2007 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  Written by Mark Grondona <mgrondona@llnl.gov>
+ *  UCRL-CODE-230739.
+ *
+ *  This file is part of edac-utils.
+ *
+ *  This is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *****************************************************************************/
+
+/*
+ *  edac-mktree: create a synthetic EDAC sysfs tree.
+ *
+ *  Writes DIR/mc/mcN/csrowM/... (and optionally mcN/dimmN/...) with
+ *   the attributes libedac reads, plus DIR/pci/pci_parity_count.
+ *   Point libedac at the tree with EDAC_SYSFS_ROOT=DIR or
+ *   edac_handle_set_root (). With --rate, keeps running and bumps
+ *   random corrected error counters R times per second. With --dmi,
+ *   also writes an SMBIOS table with a memory device for each DIMM,
+ *   in the format of /sys/firmware/dmi/tables/DMI. With --events,
+ *   also writes a tracefs directory holding a ras:mc_event corrected
+ *   error for each DIMM, as recorded from per_cpu/cpuN/trace_pipe_raw,
+ *   for edac_events_open () and edac-util --events.
+ */
+
+#if HAVE_CONFIG_H
+#  include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#define USAGE "\
+Usage: %s [OPTIONS] DIR\n\
+  -h, --help           Display this help\n\
+  -m, --mcs=N          Number of memory controllers (default 2)\n\
+  -c, --csrows=M       Number of csrows per MC (default 4)\n\
+  -k, --channels=K     Number of channels per csrow (default 2)\n\
+  -l, --layout=TYPE    Create csrow, dimm or both layouts (default csrow)\n\
+  -r, --rate=R         Bump R random CE counters per second until killed\n\
+  -t, --time=SECS      With --rate, stop after SECS seconds\n\
+  -s, --seed=S         Random seed for --rate (default 1)\n\
+  -d, --dmi=FILE       Also write a matching SMBIOS table to FILE\n\
+  -e, --events=DIR     Also write ras:mc_event trace pages under DIR\n"
+
+struct option opt_table[] = {
+    { "help",         0, NULL, 'h' },
+    { "mcs",          1, NULL, 'm' },
+    { "csrows",       1, NULL, 'c' },
+    { "channels",     1, NULL, 'k' },
+    { "layout",       1, NULL, 'l' },
+    { "rate",         1, NULL, 'r' },
+    { "time",         1, NULL, 't' },
+    { "seed",         1, NULL, 's' },
+    { "dmi",          1, NULL, 'd' },
+    { "events",       1, NULL, 'e' },
+    {  NULL,          0, NULL,  0  }
+};
+
+const char * const opt_string = "hm:c:k:l:r:t:s:d:e:";
+
+#define LAYOUT_CSROW  0x1
+#define LAYOUT_DIMM   0x2
+
+struct tree {
+    const char *root;
+    int         nmcs;
+    int         ncsrows;
+    int         nchannels;
+    int         layout;
+};
+
+static const char *prog;
+
+static void fatal (const char *format, ...)
+{
+    va_list ap;
+
+    fprintf (stderr, "%s: ", prog);
+    va_start (ap, format);
+    vfprintf (stderr, format, ap);
+    va_end (ap);
+    exit (1);
+}
+
+static void make_dir (const char *format, ...)
+{
+    char    path[4096];
+    va_list ap;
+
+    va_start (ap, format);
+    vsnprintf (path, sizeof (path), format, ap);
+    va_end (ap);
+
+    if ((mkdir (path, 0755) < 0) && (errno != EEXIST))
+        fatal ("mkdir %s: %s\n", path, strerror (errno));
+}
+
+static void write_attr (const char *value, const char *format, ...)
+{
+    char    path[4096];
+    FILE *  fp;
+    va_list ap;
+
+    va_start (ap, format);
+    vsnprintf (path, sizeof (path), format, ap);
+    va_end (ap);
+
+    if (!(fp = fopen (path, "w")))
+        fatal ("%s: %s\n", path, strerror (errno));
+    fprintf (fp, "%s\n", value);
+    fclose (fp);
+}
+
+static void write_uint (unsigned long val, const char *format, ...)
+{
+    char    path[4096];
+    char    buf[32];
+    va_list ap;
+
+    va_start (ap, format);
+    vsnprintf (path, sizeof (path), format, ap);
+    va_end (ap);
+
+    snprintf (buf, sizeof (buf), "%lu", val);
+    write_attr (buf, "%s", path);
+}
+
+/*  Add one to the counter in file `path'.
+ */
+static void bump (const char *format, ...)
+{
+    char          path[4096];
+    char          buf[32];
+    unsigned long val = 0;
+    FILE *        fp;
+    va_list       ap;
+
+    va_start (ap, format);
+    vsnprintf (path, sizeof (path), format, ap);
+    va_end (ap);
+
+    if ((fp = fopen (path, "r"))) {
+        if (fgets (buf, sizeof (buf), fp))
+            val = strtoul (buf, NULL, 10);
+        fclose (fp);
+    }
+    write_uint (val + 1, "%s", path);
+}
+
+static void tree_create (struct tree *t)
+{
+    const char *r = t->root;
+    char        label[64];
+    int         mc_size = t->ncsrows * t->nchannels * 1024;
+    int         m, c, k;
+
+    make_dir ("%s", r);
+    make_dir ("%s/mc", r);
+    make_dir ("%s/pci", r);
+    write_uint (0, "%s/pci/pci_parity_count", r);
+
+    for (m = 0; m < t->nmcs; m++) {
+        make_dir ("%s/mc/mc%d", r, m);
+        write_attr ("Synthetic", "%s/mc/mc%d/mc_name", r, m);
+        write_uint (mc_size, "%s/mc/mc%d/size_mb", r, m);
+        write_uint (0, "%s/mc/mc%d/seconds_since_reset", r, m);
+
+        write_uint (0, "%s/mc/mc%d/ce_count", r, m);
+        write_uint (0, "%s/mc/mc%d/ue_count", r, m);
+        write_uint (0, "%s/mc/mc%d/ce_noinfo_count", r, m);
+        write_uint (0, "%s/mc/mc%d/ue_noinfo_count", r, m);
+
+        for (c = 0; c < t->ncsrows && (t->layout & LAYOUT_CSROW); c++) {
+            make_dir ("%s/mc/mc%d/csrow%d", r, m, c);
+            write_uint (t->nchannels * 1024, "%s/mc/mc%d/csrow%d/size_mb",
+                        r, m, c);
+            write_uint (0, "%s/mc/mc%d/csrow%d/ce_count", r, m, c);
+            write_uint (0, "%s/mc/mc%d/csrow%d/ue_count", r, m, c);
+
+            for (k = 0; k < t->nchannels; k++) {
+                snprintf (label, sizeof (label), "MC%d_CS%d_CH%d", m, c, k);
+                write_attr (label, "%s/mc/mc%d/csrow%d/ch%d_dimm_label",
+                            r, m, c, k);
+                write_uint (0, "%s/mc/mc%d/csrow%d/ch%d_ce_count",
+                            r, m, c, k);
+            }
+        }
+
+        if (!(t->layout & LAYOUT_DIMM))
+            continue;
+
+        snprintf (label, sizeof (label), "csrow %d channel %d ",
+                  t->ncsrows - 1, t->nchannels - 1);
+        write_attr (label, "%s/mc/mc%d/max_location", r, m);
+
+        for (c = 0; c < t->ncsrows * t->nchannels; c++) {
+            make_dir ("%s/mc/mc%d/dimm%d", r, m, c);
+            snprintf (label, sizeof (label), "csrow %d channel %d ",
+                      c / t->nchannels, c % t->nchannels);
+            write_attr (label, "%s/mc/mc%d/dimm%d/dimm_location", r, m, c);
+            snprintf (label, sizeof (label), "MC%d_CS%d_CH%d",
+                      m, c / t->nchannels, c % t->nchannels);
+            write_attr (label, "%s/mc/mc%d/dimm%d/dimm_label", r, m, c);
+            write_uint (1024, "%s/mc/mc%d/dimm%d/size", r, m, c);
+            write_uint (0, "%s/mc/mc%d/dimm%d/dimm_ce_count", r, m, c);
+            write_uint (0, "%s/mc/mc%d/dimm%d/dimm_ue_count", r, m, c);
+        }
+    }
+}
+
+/*  Append one SMBIOS structure of `type' with formatted area `area' of
+ *   `len' bytes (whose header is filled in here) and the strings in
+ *   `strings' to `fp'.
+ */
+static void smbios_write (FILE *fp, int type, unsigned char *area, int len,
+        const char **strings, int nstrings)
+{
+    static int handle = 0;
+    int        i;
+
+    area[0] = type;
+    area[1] = len;
+    area[2] = handle & 0xff;
+    area[3] = (handle++ >> 8) & 0xff;
+    fwrite (area, 1, len, fp);
+
+    for (i = 0; i < nstrings; i++)
+        fwrite (strings[i], 1, strlen (strings[i]) + 1, fp);
+    if (nstrings == 0)
+        fputc ('\0', fp);
+    fputc ('\0', fp);
+}
+
+/*  Write an SMBIOS table naming the mainboard "EDAC Synthetic" and with
+ *   a 1 GB memory device for each DIMM of the tree, in the order of
+ *   their locations, plus one empty socket per MC.
+ */
+static void smbios_create (struct tree *t, const char *path)
+{
+    unsigned char area[0x22];
+    char          locator[64];
+    char          bank[64];
+    const char *  strings[2];
+    FILE *        fp;
+    int           m, c, k;
+
+    if (!(fp = fopen (path, "w")))
+        fatal ("%s: %s\n", path, strerror (errno));
+
+    /*  System and baseboard: manufacturer and product name strings
+     */
+    strings[0] = "EDAC";
+    strings[1] = "Synthetic";
+    memset (area, 0, sizeof (area));
+    area[4] = 1;
+    area[5] = 2;
+    smbios_write (fp, 1, area, 8, strings, 2);
+    smbios_write (fp, 2, area, 8, strings, 2);
+
+    for (m = 0; m < t->nmcs; m++) {
+        for (c = 0; c <= t->ncsrows * t->nchannels; c++) {
+            int size = (c < t->ncsrows * t->nchannels) ? 1024 : 0;
+
+            k = c % t->nchannels;
+            if (size)
+                snprintf (locator, sizeof (locator), "CPU%d_DIMM_%c%d",
+                          m, 'A' + (k % 26), c / t->nchannels);
+            else
+                snprintf (locator, sizeof (locator), "CPU%d_DIMM_EMPTY", m);
+            snprintf (bank, sizeof (bank), "NODE %d", m);
+            strings[0] = locator;
+            strings[1] = bank;
+
+            /*  Memory device: 64-bit DDR4 DIMM of `size' MB
+             */
+            memset (area, 0, sizeof (area));
+            area[0x04] = 0xfe;                  /* no memory array handle */
+            area[0x05] = 0xff;
+            area[0x06] = 0xfe;                  /* no error info handle   */
+            area[0x07] = 0xff;
+            area[0x08] = 72;                    /* total width            */
+            area[0x0a] = 64;                    /* data width             */
+            area[0x0c] = size & 0xff;
+            area[0x0d] = (size >> 8) & 0xff;
+            area[0x0e] = 0x09;                  /* DIMM                   */
+            area[0x10] = 1;                     /* locator string         */
+            area[0x11] = 2;                     /* bank locator string    */
+            area[0x12] = 0x1a;                  /* DDR4                   */
+            smbios_write (fp, 17, area, sizeof (area), strings, 2);
+        }
+    }
+
+    memset (area, 0, sizeof (area));
+    smbios_write (fp, 127, area, 4, NULL, 0);
+
+    if (fclose (fp) != 0)
+        fatal ("%s: %s\n", path, strerror (errno));
+}
+
+/*
+ *  Trace pages are written as the kernel lays them out, with the page
+ *   header and mc_event record formats given in TRACE_HEADER_PAGE and
+ *   TRACE_MC_EVENT_FORMAT.
+ */
+#define TRACE_PAGE_SIZE     4096
+#define TRACE_DATA_OFFSET   16
+#define TRACE_NCPUS         2
+#define TRACE_MC_EVENT_ID   1500
+#define TRACE_MC_EVENT_LEN  60
+
+#define TRACE_HEADER_PAGE "\
+\tfield: u64 timestamp;\toffset:0;\tsize:8;\tsigned:0;\n\
+\tfield: local_t commit;\toffset:8;\tsize:8;\tsigned:1;\n\
+\tfield: int overwrite;\toffset:8;\tsize:1;\tsigned:1;\n\
+\tfield: char data;\toffset:16;\tsize:4080;\tsigned:1;\n"
+
+#define TRACE_MC_EVENT_FORMAT "\
+name: mc_event\n\
+ID: %d\n\
+format:\n\
+\tfield:unsigned short common_type;\toffset:0;\tsize:2;\tsigned:0;\n\
+\tfield:unsigned char common_flags;\toffset:2;\tsize:1;\tsigned:0;\n\
+\tfield:unsigned char common_preempt_count;\toffset:3;\tsize:1;\tsigned:0;\n\
+\tfield:int common_pid;\toffset:4;\tsize:4;\tsigned:1;\n\
+\n\
+\tfield:unsigned int error_type;\toffset:8;\tsize:4;\tsigned:0;\n\
+\tfield:__data_loc char[] msg;\toffset:12;\tsize:4;\tsigned:0;\n\
+\tfield:__data_loc char[] label;\toffset:16;\tsize:4;\tsigned:0;\n\
+\tfield:u16 error_count;\toffset:20;\tsize:2;\tsigned:0;\n\
+\tfield:u8 mc_index;\toffset:22;\tsize:1;\tsigned:0;\n\
+\tfield:s8 top_layer;\toffset:23;\tsize:1;\tsigned:1;\n\
+\tfield:s8 middle_layer;\toffset:24;\tsize:1;\tsigned:1;\n\
+\tfield:s8 lower_layer;\toffset:25;\tsize:1;\tsigned:1;\n\
+\tfield:long address;\toffset:32;\tsize:8;\tsigned:1;\n\
+\tfield:u8 grain_bits;\toffset:40;\tsize:1;\tsigned:0;\n\
+\tfield:long syndrome;\toffset:48;\tsize:8;\tsigned:1;\n\
+\tfield:__data_loc char[] driver_detail;\toffset:56;\tsize:4;\tsigned:0;\n\
+\n\
+print fmt: \"%%d %%s error%%s:%%s%%s on %%s (mc:%%d location:%%d:%%d:%%d\
+ address:0x%%08lx grain:%%d syndrome:0x%%08lx%%s%%s)\"\n"
+
+/*  Ring buffer page of one CPU being filled
+ */
+struct trace_page {
+    FILE *             fp;
+    unsigned char      data[TRACE_PAGE_SIZE];
+    size_t             len;                 /* Bytes of events in data    */
+    unsigned long long ts;                  /* Time of last event         */
+};
+
+static void put (unsigned char *p, uint64_t val, int size)
+{
+    uint8_t  u8 =  val;
+    uint16_t u16 = val;
+    uint32_t u32 = val;
+
+    switch (size) {
+        case 1:  memcpy (p, &u8, 1);  break;
+        case 2:  memcpy (p, &u16, 2); break;
+        case 4:  memcpy (p, &u32, 4); break;
+        default: memcpy (p, &val, 8); break;
+    }
+}
+
+static void trace_page_flush (struct trace_page *tp)
+{
+    if (tp->len == 0)
+        return;
+    put (tp->data + 8, tp->len, 8);
+    if (fwrite (tp->data, 1, sizeof (tp->data), tp->fp) != sizeof (tp->data))
+        fatal ("write: %s\n", strerror (errno));
+    memset (tp->data, 0, sizeof (tp->data));
+    tp->len = 0;
+}
+
+/*  Append event `rec' of `len' bytes (a multiple of 4) to `tp', 1000ns
+ *   after the last. With `extended', the length is given in a word
+ *   after the event header, as the kernel does for events over 112
+ *   bytes. Each page starts with a time extend event.
+ */
+static void trace_event (struct trace_page *tp, const unsigned char *rec,
+        size_t len, int extended)
+{
+    unsigned char *p;
+    size_t         need = 8 + (extended ? 8 : 4) + len;
+
+    if (TRACE_DATA_OFFSET + tp->len + need > TRACE_PAGE_SIZE)
+        trace_page_flush (tp);
+
+    if (tp->len == 0) {
+        put (tp->data, tp->ts, 8);
+        p = tp->data + TRACE_DATA_OFFSET;
+        put (p, 30, 4);
+        put (p + 4, 1, 4);
+        tp->ts += 1ULL << 27;
+        tp->len = 8;
+    }
+
+    p = tp->data + TRACE_DATA_OFFSET + tp->len;
+    if (extended) {
+        put (p, 1000 << 5, 4);
+        put (p + 4, len + 4, 4);
+        p += 8;
+    }
+    else {
+        put (p, (1000 << 5) | (len / 4), 4);
+        p += 4;
+    }
+    memcpy (p, rec, len);
+    tp->len = p + len - (tp->data + TRACE_DATA_OFFSET);
+    tp->ts += 1000;
+}
+
+/*  Append string `str' to mc_event record `rec' of `*len' bytes and
+ *   point its __data_loc field at `off' to it.
+ */
+static void trace_string (unsigned char *rec, size_t *len, int off,
+        const char *str)
+{
+    size_t n = strlen (str) + 1;
+
+    memcpy (rec + *len, str, n);
+    put (rec + off, (n << 16) | *len, 4);
+    *len += n;
+}
+
+/*  Write a tracefs directory under `dir' with a corrected error for
+ *   each DIMM of the tree, spread across TRACE_NCPUS CPUs. Each CPU
+ *   also logs an unrelated event, which readers must skip.
+ */
+static void trace_create (struct tree *t, const char *dir)
+{
+    struct trace_page tp[TRACE_NCPUS];
+    unsigned char     rec[256];
+    char              label[64];
+    char              buf[4096];
+    size_t            len;
+    int               m, c, i, n = 0;
+
+    make_dir ("%s", dir);
+    make_dir ("%s/events", dir);
+    make_dir ("%s/events/ras", dir);
+    make_dir ("%s/events/ras/mc_event", dir);
+    make_dir ("%s/per_cpu", dir);
+
+    snprintf (buf, sizeof (buf), TRACE_MC_EVENT_FORMAT, TRACE_MC_EVENT_ID);
+    write_attr (buf, "%s/events/ras/mc_event/format", dir);
+    write_attr (TRACE_HEADER_PAGE, "%s/events/header_page", dir);
+
+    for (i = 0; i < TRACE_NCPUS; i++) {
+        make_dir ("%s/per_cpu/cpu%d", dir, i);
+        snprintf (buf, sizeof (buf), "%s/per_cpu/cpu%d/trace_pipe_raw",
+                  dir, i);
+        memset (&tp[i], 0, sizeof (tp[i]));
+        if (!(tp[i].fp = fopen (buf, "w")))
+            fatal ("%s: %s\n", buf, strerror (errno));
+        tp[i].ts = 1000000000ULL * (i + 1);
+
+        memset (rec, 0, 16);
+        put (rec, TRACE_MC_EVENT_ID + 1, 2);
+        trace_event (&tp[i], rec, 16, 0);
+    }
+
+    for (m = 0; m < t->nmcs; m++) {
+        for (c = 0; c < t->ncsrows * t->nchannels; c++, n++) {
+            memset (rec, 0, sizeof (rec));
+            put (rec, TRACE_MC_EVENT_ID, 2);
+            put (rec + 4, 1, 4);                /* pid                    */
+            put (rec + 8, 0, 4);                /* corrected              */
+            put (rec + 20, 1, 2);
+            put (rec + 22, m, 1);
+            put (rec + 23, c / t->nchannels, 1);
+            put (rec + 24, c % t->nchannels, 1);
+            put (rec + 25, -1, 1);
+            put (rec + 32, ((uint64_t) m << 32) | ((uint64_t) c << 20), 8);
+            put (rec + 40, 6, 1);               /* 64 byte grain          */
+            put (rec + 48, 0x1234 + n, 8);
+
+            len = TRACE_MC_EVENT_LEN;
+            snprintf (label, sizeof (label), "MC%d_CS%d_CH%d",
+                      m, c / t->nchannels, c % t->nchannels);
+            trace_string (rec, &len, 12, "memory read error");
+            trace_string (rec, &len, 16, label);
+            trace_string (rec, &len, 56, "");
+            len = (len + 3) & ~3UL;
+
+            trace_event (&tp[n % TRACE_NCPUS], rec, len, n % 3 == 2);
+        }
+    }
+
+    for (i = 0; i < TRACE_NCPUS; i++) {
+        trace_page_flush (&tp[i]);
+        if (fclose (tp[i].fp) != 0)
+            fatal ("trace_pipe_raw: %s\n", strerror (errno));
+    }
+}
+
+/*  Record one corrected error on a random DIMM, updating every counter
+ *   which covers it so that totals stay consistent.
+ */
+static void tree_mutate_one (struct tree *t)
+{
+    const char *r = t->root;
+    int         m = rand () % t->nmcs;
+    int         c = rand () % t->ncsrows;
+    int         k = rand () % t->nchannels;
+
+    bump ("%s/mc/mc%d/ce_count", r, m);
+
+    if (t->layout & LAYOUT_CSROW) {
+        bump ("%s/mc/mc%d/csrow%d/ce_count", r, m, c);
+        bump ("%s/mc/mc%d/csrow%d/ch%d_ce_count", r, m, c, k);
+    }
+    if (t->layout & LAYOUT_DIMM)
+        bump ("%s/mc/mc%d/dimm%d/dimm_ce_count", r, m, c * t->nchannels + k);
+}
+
+static void tree_mutate (struct tree *t, double rate, double seconds)
+{
+    struct timespec ts;
+    double          interval = 1.0 / rate;
+    double          elapsed = 0.0;
+
+    ts.tv_sec =  (time_t) interval;
+    ts.tv_nsec = (long) ((interval - ts.tv_sec) * 1.0e9);
+
+    while ((seconds <= 0.0) || (elapsed < seconds)) {
+        tree_mutate_one (t);
+        nanosleep (&ts, NULL);
+        elapsed += interval;
+    }
+}
+
+static int parse_count (const char *arg, const char *name)
+{
+    char *end;
+    long  n = strtol (arg, &end, 10);
+
+    if ((*end != '\0') || (n <= 0) || (n > 1000000))
+        fatal ("Invalid %s \"%s\"\n", name, arg);
+
+    return ((int) n);
+}
+
+int main (int ac, char *av[])
+{
+    struct tree t;
+    double      rate = 0.0;
+    double      seconds = 0.0;
+    const char *dmi = NULL;
+    const char *events = NULL;
+    int         c;
+
+    prog = (prog = strrchr (av[0], '/')) ? prog + 1 : av[0];
+
+    t.nmcs =      2;
+    t.ncsrows =   4;
+    t.nchannels = 2;
+    t.layout =    LAYOUT_CSROW;
+
+    while ((c = getopt_long (ac, av, opt_string, opt_table, NULL)) != -1) {
+        switch (c) {
+            case 'h':
+                fprintf (stdout, USAGE, prog);
+                exit (0);
+            case 'm':
+                t.nmcs = parse_count (optarg, "MC count");
+                break;
+            case 'c':
+                t.ncsrows = parse_count (optarg, "csrow count");
+                break;
+            case 'k':
+                t.nchannels = parse_count (optarg, "channel count");
+                break;
+            case 'l':
+                if (strcmp (optarg, "csrow") == 0)
+                    t.layout = LAYOUT_CSROW;
+                else if (strcmp (optarg, "dimm") == 0)
+                    t.layout = LAYOUT_DIMM;
+                else if (strcmp (optarg, "both") == 0)
+                    t.layout = LAYOUT_CSROW | LAYOUT_DIMM;
+                else
+                    fatal ("Invalid layout \"%s\"\n", optarg);
+                break;
+            case 'r':
+                if ((rate = strtod (optarg, NULL)) <= 0.0)
+                    fatal ("Invalid rate \"%s\"\n", optarg);
+                break;
+            case 't':
+                seconds = strtod (optarg, NULL);
+                break;
+            case 's':
+                srand (strtoul (optarg, NULL, 10));
+                break;
+            case 'd':
+                dmi = optarg;
+                break;
+            case 'e':
+                events = optarg;
+                break;
+            default:
+                fprintf (stderr, USAGE, prog);
+                exit (1);
+        }
+    }
+
+    if (optind != ac - 1) {
+        fprintf (stderr, USAGE, prog);
+        exit (1);
+    }
+
+    t.root = av[optind];
+    tree_create (&t);
+
+    if (dmi)
+        smbios_create (&t, dmi);
+
+    if (events)
+        trace_create (&t, events);
+
+    if (rate > 0.0)
+        tree_mutate (&t, rate, seconds);
+
+    return (0);
+}
+
+/*
+ * vi: ts=4 sw=4 expandtab
+ */
@@ -25,6 +25,8 @@
 #ifndef _LIBEDAC_H
 #define _LIBEDAC_H
 
+#include <time.h>
+
 /*****************************************************************************
  *  C++ macros
  *****************************************************************************/
@@ -46,6 +48,39 @@
 #define EDAC_NAME_LEN      64
 #define EDAC_LABEL_LEN    256
 #define EDAC_MAX_CHANNELS   6
+#define EDAC_MAX_LAYERS     3
+#define EDAC_LAYER_NAME_LEN 16
+
+/*  Environment variable overriding the EDAC sysfs root directory
+ *   (default /sys/devices/system/edac). See edac_handle_set_root ().
+ */
+#define EDAC_SYSFS_ROOT_ENV "EDAC_SYSFS_ROOT"
+
+/*  Set this environment variable to "0" to read counters with pread(2)
+ *   instead of a batched io_uring read on edac_handle_refresh ().
+ */
+#define EDAC_IO_URING_ENV   "EDAC_IO_URING"
+
+/*  Environment variable giving the number of threads used to scan MCs
+ *   and sample counters. See edac_handle_set_threads ().
+ */
+#define EDAC_THREADS_ENV    "EDAC_THREADS"
+
+/*  Environment variable naming the shared-memory segment used by
+ *   edac_handle_attach_shm () and edac_handle_publish_shm () when they
+ *   are passed a NULL name (default EDAC_SHM_NAME).
+ */
+#define EDAC_SHM_ENV        "EDAC_SHM"
+#define EDAC_SHM_NAME       "/edac"
+
+/*  Environment variable overriding the tracefs directory read by
+ *   edac_events_open () when it is passed a NULL root.
+ */
+#define EDAC_TRACEFS_ROOT_ENV "EDAC_TRACEFS_ROOT"
+
+/*  Length of the message strings of struct edac_event
+ */
+#define EDAC_EVENT_MSG_LEN 128
 
 #define edac_for_each_mc_info(__h, __mc, __i) \
     for (edac_handle_reset (__h), __mc = edac_next_mc_info (__h, &__i); \
@@ -59,6 +94,12 @@
          __csrow = edac_next_csrow_info (__mc, &__i) \
         ) 
 
+#define edac_for_each_dimm_info(__mc, __dimm, __i) \
+    for (edac_mc_reset (__mc), __dimm = edac_next_dimm_info (__mc, &__i); \
+         __dimm != NULL; \
+         __dimm = edac_next_dimm_info (__mc, &__i) \
+        ) 
+
 /*****************************************************************************
  *  Data Types
  *****************************************************************************/
@@ -78,6 +119,34 @@ typedef struct edac_mc edac_mc;
  */
 typedef struct edac_csrow  edac_csrow;
 
+/*  EDAC DIMM (or rank) within an MC
+ */
+typedef struct edac_dimm   edac_dimm;
+
+/*  Saved copy of all error counters in an EDAC handle
+ */
+typedef struct edac_snapshot edac_snapshot;
+
+/*  Sliding-window error rates of the counters in an EDAC handle
+ */
+typedef struct edac_rate edac_rate;
+
+/*  On-disk history of EDAC counter samples
+ */
+typedef struct edac_history edac_history;
+
+/*  Grid of the DIMMs of all MCs by location
+ */
+typedef struct edac_layout edac_layout;
+
+/*  Compiled DIMM label database
+ */
+typedef struct edac_labeldb edac_labeldb;
+
+/*  Reader of ras:mc_event tracepoint records
+ */
+typedef struct edac_events edac_events;
+
 /*  EDAC memory controller info
  */
 struct edac_mc_info {
@@ -109,6 +178,25 @@ struct edac_csrow_info {
                                            /* Channel info for this csrow   */
 };
 
+/*  EDAC DIMM information, from the mcN/dimmN (or mcN/rankN) sysfs
+ *   layout. The DIMM location is given as a position within each
+ *   of the MC's layers, e.g. "channel 3 slot 1".
+ */
+struct edac_dimm_info {
+    char          id[EDAC_NAME_LEN];       /* DIMM Identity (e.g. dimm3)    */
+    char          mc_id[EDAC_NAME_LEN];    /* Id of memory controller (mcN) */
+    int           nlayers;                 /* Number of location layers     */
+    char          layer[EDAC_MAX_LAYERS][EDAC_LAYER_NAME_LEN];
+                                           /* Layer names (e.g. "channel")  */
+    int           location[EDAC_MAX_LAYERS];
+                                           /* Position in each layer        */
+    unsigned int  size_mb;                 /* DIMM size in MB               */
+    unsigned int  ce_count;                /* Corrected error count         */
+    unsigned int  ue_count;                /* Uncorrected error count       */
+    int           dimm_label_valid;        /* Is DIMM label valid?          */
+    char          dimm_label[EDAC_LABEL_LEN];
+                                           /* DIMM name                     */
+};
 
 /*  EDAC error totals
  */
@@ -118,6 +206,135 @@ struct edac_totals {
     unsigned int   pci_parity_total;        /* Total PCI Parity errors       */
 };
 
+/*  Kinds of EDAC error counter
+ */
+enum edac_counter_type {
+    EDAC_COUNTER_MC_CE          = 0,        /* mcN/ce_count                  */
+    EDAC_COUNTER_MC_UE          = 1,        /* mcN/ue_count                  */
+    EDAC_COUNTER_MC_CE_NOINFO   = 2,        /* mcN/ce_noinfo_count           */
+    EDAC_COUNTER_MC_UE_NOINFO   = 3,        /* mcN/ue_noinfo_count           */
+    EDAC_COUNTER_CSROW_CE       = 4,        /* mcN/csrowM/ce_count           */
+    EDAC_COUNTER_CSROW_UE       = 5,        /* mcN/csrowM/ue_count           */
+    EDAC_COUNTER_CHANNEL_CE     = 6,        /* mcN/csrowM/chK_ce_count       */
+    EDAC_COUNTER_DIMM_CE        = 7,        /* mcN/dimmM/dimm_ce_count       */
+    EDAC_COUNTER_DIMM_UE        = 8,        /* mcN/dimmM/dimm_ue_count       */
+    EDAC_COUNTER_PCI_PARITY     = 9         /* pci/pci_parity_count          */
+};
+
+/*  One counter which differs between two snapshots
+ */
+struct edac_delta {
+    unsigned int        counter;            /* Counter index in handle       */
+    unsigned long long  old_count;          /* Value in older snapshot       */
+    unsigned long long  new_count;          /* Value in newer snapshot       */
+};
+
+/*  Shape of a DIMM layout. Layer 0 is the MC (the N in mcN), and the
+ *   rest are the location layers of its DIMMs, outermost first.
+ */
+#define EDAC_LAYOUT_MAX_LAYERS (EDAC_MAX_LAYERS + 1)
+struct edac_layout_info {
+    int           nlayers;                 /* Number of layers              */
+    char          layer[EDAC_LAYOUT_MAX_LAYERS][EDAC_LAYER_NAME_LEN];
+                                           /* Layer names (e.g. "mc")       */
+    unsigned int  layer_size[EDAC_LAYOUT_MAX_LAYERS];
+                                           /* Positions in each layer       */
+    unsigned int  ncells;                  /* Product of layer sizes        */
+    unsigned int  ndimms;                  /* Cells holding a DIMM          */
+};
+
+/*  One position of a DIMM layout
+ */
+struct edac_layout_cell {
+    int           dimm;                    /* 1 if there is a DIMM here     */
+    unsigned int  size_mb;                 /* DIMM size in MB               */
+    unsigned int  ce_count;                /* Corrected error count         */
+    unsigned int  ue_count;                /* Uncorrected error count       */
+};
+
+/*  Errors counted by one counter over one rate window
+ */
+struct edac_rate_info {
+    unsigned int        window;             /* Window length in seconds      */
+    unsigned long long  count;              /* Errors within the window      */
+    double              seconds;            /* Time covered, <= window       */
+    double              rate;               /* Errors per second             */
+};
+
+/*  A counter which reached its threshold for a rate window
+ */
+struct edac_rate_alert {
+    unsigned int        counter;            /* Counter index in handle       */
+    unsigned int        window;             /* Index of window               */
+    unsigned long long  count;              /* Errors within the window      */
+    unsigned long long  threshold;          /* Threshold reached             */
+};
+
+/*  Records held by an EDAC history file. Records are numbered from 0
+ *   in the order written; only the most recent `nrecords' are kept.
+ */
+struct edac_history_info {
+    unsigned long long  first;              /* Oldest record still readable  */
+    unsigned long long  next;               /* Number of next record written */
+    unsigned int        nrecords;           /* Size of ring in records       */
+    unsigned int        nvalues;            /* Counters per record           */
+    time_t              created;            /* Time history was started      */
+};
+
+/*  DIMM label of one csrow channel from the label database
+ */
+struct edac_label {
+    unsigned int        mc;                 /* N in mcN                      */
+    unsigned int        row;                /* N in csrowN                   */
+    unsigned int        channel;            /* N in chN                      */
+    const char *        label;              /* Label, valid until close      */
+};
+
+/*  Kinds of memory error reported by the ras:mc_event tracepoint
+ */
+enum edac_event_type {
+    EDAC_EVENT_CORRECTED        = 0,        /* Corrected error               */
+    EDAC_EVENT_UNCORRECTED      = 1,        /* Uncorrected error             */
+    EDAC_EVENT_DEFERRED         = 2,        /* Deferred error                */
+    EDAC_EVENT_FATAL            = 3,        /* Fatal error                   */
+    EDAC_EVENT_INFO             = 4         /* Informational                 */
+};
+
+/*  One ras:mc_event tracepoint record
+ */
+struct edac_event {
+    unsigned long long  timestamp;          /* Trace clock time, usually ns  */
+    int                 cpu;                /* CPU which logged the event    */
+    enum edac_event_type type;              /* Kind of error                 */
+    unsigned int        count;              /* Number of errors              */
+    unsigned int        mc;                 /* N in mcN                      */
+    int                 layer[EDAC_MAX_LAYERS];
+                                            /* Position in each layer or -1  */
+    unsigned long long  address;            /* Physical address              */
+    unsigned long long  grain;              /* Address resolution in bytes   */
+    unsigned long long  syndrome;           /* Error syndrome                */
+    char                label[EDAC_LABEL_LEN];
+                                            /* DIMM label(s)                 */
+    char                msg[EDAC_EVENT_MSG_LEN];
+                                            /* Error message                 */
+    char                detail[EDAC_EVENT_MSG_LEN];
+                                            /* Driver specific detail        */
+};
+
+/*  Callback given batches of events by edac_events_dispatch ()
+ */
+typedef void (*edac_events_f) (const struct edac_event *events, int n,
+        void *arg);
+
+/*  Location of an EDAC error counter
+ */
+struct edac_location {
+    enum edac_counter_type type;            /* Kind of counter               */
+    char          mc_id[EDAC_NAME_LEN];     /* Id of MC, or "" for PCI       */
+    char          id[EDAC_NAME_LEN];        /* csrow or DIMM id, or ""       */
+    int           channel;                  /* Channel number, or -1         */
+};
+
 /*****************************************************************************
  *  Functions
  *****************************************************************************/
@@ -132,15 +349,69 @@ BEGIN_C_DECLS
  */
 edac_handle * edac_handle_create (void);
 
+/*
+ *  Read EDAC data from `path' instead of /sys/devices/system/edac.
+ *   `path' must contain mc/ (and optionally pci/) subdirectories laid
+ *   out as in sysfs. If not set, the EDAC_SYSFS_ROOT environment
+ *   variable is used if present. A NULL `path' restores the default.
+ *   Must be called before edac_handle_init (). Returns <0 on error.
+ */
+int edac_handle_set_root (edac_handle *edac, const char *path);
+
+/*
+ *  Scan memory controllers and sample counters on `nthreads' threads,
+ *   including the caller. MCs are split across the threads and merged
+ *   in mcN order, so results are the same as with one thread. 0 uses
+ *   the EDAC_THREADS environment variable if set, and 1 (the default)
+ *   does everything in the calling thread. Takes effect on the next
+ *   init, refresh or csrow/DIMM load. Returns <0 on error.
+ */
+int edac_handle_set_threads (edac_handle *edac, int nthreads);
+
+/*
+ *  Read topology and counters from shared-memory segment `name' (NULL
+ *   for the default) written by another process with
+ *   edac_handle_publish_shm (), instead of from sysfs. If no live
+ *   publisher for the same EDAC root is found, edac_handle_init ()
+ *   silently reads sysfs as usual. While attached, a refresh copies
+ *   the latest published counters without any system calls, and
+ *   fails with <0 once the publisher exits or reloads; calling
+ *   edac_handle_init () again then attaches anew or falls back to
+ *   sysfs. Must be called before edac_handle_init ().
+ *   Returns <0 on error.
+ */
+int edac_handle_attach_shm (edac_handle *edac, const char *name);
+
+/*
+ *  Refresh counters from sysfs and publish the handle's topology and
+ *   counters in shared-memory segment `name' (NULL for the default)
+ *   for readers using edac_handle_attach_shm (). Call periodically to
+ *   publish new samples. Fails if another live process is publishing
+ *   to `name'. The segment is removed by edac_handle_destroy ().
+ *   Returns <0 on error.
+ */
+int edac_handle_publish_shm (edac_handle *edac, const char *name);
+
 /*
  *  Load system EDAC data from /sys (and possibly elsewhere) into
  *   the EDAC handle. Must be called at least once. More than one
  *   call to this function will reload EDAC values into the handle
- *   and reset MC counters.
+ *   and reset MC counters. Only memory controllers are read here;
+ *   csrows and DIMMs are loaded on first use.
  *  
  */   
 int edac_handle_init (edac_handle *edac);
 
+/*
+ *  Reread only the error counters (ce_count, ue_count, chN_ce_count
+ *   and *_noinfo_count) for all MCs and csrows already loaded into
+ *   the EDAC handle. The MC/csrow topology found by edac_handle_init ()
+ *   is kept, and no memory is allocated. If the handle has not yet
+ *   been initialized, this is equivalent to edac_handle_init ().
+ *  Returns <0 on error.
+ */
+int edac_handle_refresh (edac_handle *edac);
+
 /*
  *  Returns the number of EDAC memory controllers found in /sys
  *   0 if none found (e.g. edac_mc loaded, but no chipset specific driver)
@@ -164,6 +435,9 @@ int edac_handle_reset (edac_handle *edac);
 
 /*
  *  Return error count totals for all memory controller in totals.
+ *   Totals are computed each time counters are read by
+ *   edac_handle_init () or edac_handle_refresh (), so this is a
+ *   constant time copy which always matches the last sample.
  *   Return <0 on error.
  */
 int edac_error_totals (edac_handle * edac, struct edac_totals *totals);
@@ -201,11 +475,380 @@ int edac_csrow_get_info (edac_csrow *, struct edac_csrow_info *info);
 edac_csrow * edac_next_csrow_info (edac_mc *mc, struct edac_csrow_info *info);
 
 /*
- *  Reset internal iterator in memory controller for looping through
- *   csrow information.
+ *  Reset internal iterators in memory controller for looping through
+ *   csrow and DIMM information.
  */
 int edac_mc_reset (struct edac_mc *mc);
 
+/*
+ *  Returns the number of DIMMs (dimmN or rankN entries) found for
+ *   memory controller `mc'. Returns 0 for kernels that only export
+ *   the legacy csrow layout.
+ */
+unsigned int edac_mc_dimm_count (edac_mc *mc);
+
+/*
+ *  Returns next DIMM in EDAC memory controller, or NULL
+ *   if no more DIMMs.
+ */
+edac_dimm * edac_next_dimm (edac_mc *mc);
+
+/*
+ *  Get EDAC DIMM info
+ */
+int edac_dimm_get_info (edac_dimm *dimm, struct edac_dimm_info *info);
+
+/*
+ *  Combined edac_next_dimm () and edac_dimm_get_info ().
+ */
+edac_dimm * edac_next_dimm_info (edac_mc *mc, struct edac_dimm_info *info);
+
+/*
+ *  Look up the DIMM at `location' (`nlayers' positions, outermost
+ *   layer first) on memory controller number `mc' (the N in mcN).
+ *   Returns NULL if there is no such DIMM.
+ */
+edac_dimm * edac_find_dimm (edac_handle *edac, unsigned int mc, 
+        const int *location, int nlayers);
+
+/*
+ *  Lay out the DIMMs of all MCs of `edac' in one dense array of cells,
+ *   indexed by location with the MC number outermost and the last
+ *   layer innermost, so cell ((mc * size1 + pos1) * size2 + pos2) holds
+ *   the DIMM at position pos1, pos2 of mcN. Layers are sized to fit the
+ *   largest MC. The layout is empty if there are no DIMMs, and fails
+ *   if MCs have different numbers of layers. Returns NULL on error.
+ */
+edac_layout * edac_layout_create (edac_handle *edac);
+
+/*
+ *  Free layout `l'.
+ */
+void edac_layout_destroy (edac_layout *l);
+
+/*
+ *  Fill in `info' for layout `l'.
+ */
+int edac_layout_get_info (edac_layout *l, struct edac_layout_info *info);
+
+/*
+ *  Copy up to `len' cells of `l', in index order, into `cells', with
+ *   the counters as read by the last edac_handle_refresh (). Returns
+ *   the number of cells, or <0 if edac_handle_init () reloaded the
+ *   handle since `l' was created.
+ */
+int edac_layout_cells (edac_layout *l, struct edac_layout_cell *cells,
+        unsigned int len);
+
+/*
+ *  Return the DIMM in cell `cell' of `l', or NULL if there is none or
+ *   the handle was reloaded.
+ */
+edac_dimm * edac_layout_dimm (edac_layout *l, unsigned int cell);
+
+/*
+ *  Field accessors. These return values straight from the handle's
+ *   storage without filling in an info structure, and are the cheapest
+ *   way to walk a large topology. Returned strings point into the
+ *   handle and remain valid until the next edac_handle_init () or
+ *   edac_handle_destroy ().
+ */
+const char * edac_mc_id (const edac_mc *mc);
+const char * edac_mc_name (const edac_mc *mc);
+unsigned int edac_mc_size_mb (const edac_mc *mc);
+unsigned int edac_mc_ce_count (const edac_mc *mc);
+unsigned int edac_mc_ue_count (const edac_mc *mc);
+unsigned int edac_mc_ce_noinfo_count (const edac_mc *mc);
+unsigned int edac_mc_ue_noinfo_count (const edac_mc *mc);
+unsigned int edac_mc_csrow_count (const edac_mc *mc);
+
+const char * edac_csrow_id (const edac_csrow *csrow);
+unsigned int edac_csrow_size_mb (const edac_csrow *csrow);
+unsigned int edac_csrow_ce_count (const edac_csrow *csrow);
+unsigned int edac_csrow_ue_count (const edac_csrow *csrow);
+
+/*
+ *  Channel accessors for channel `ch' of `csrow'. edac_channel_label ()
+ *   returns NULL if the channel has no DIMM label.
+ */
+int          edac_channel_valid (const edac_csrow *csrow, int ch);
+unsigned int edac_channel_ce_count (const edac_csrow *csrow, int ch);
+const char * edac_channel_label (const edac_csrow *csrow, int ch);
+
+/*
+ *  DIMM accessors. edac_dimm_label () returns NULL if the DIMM has no
+ *   label. edac_dimm_location () returns the DIMM's position in each
+ *   layer and stores the number of layers in `nlayers'.
+ */
+const char * edac_dimm_id (const edac_dimm *dimm);
+const char * edac_dimm_label (const edac_dimm *dimm);
+unsigned int edac_dimm_size_mb (const edac_dimm *dimm);
+unsigned int edac_dimm_ce_count (const edac_dimm *dimm);
+unsigned int edac_dimm_ue_count (const edac_dimm *dimm);
+const int *  edac_dimm_location (const edac_dimm *dimm, int *nlayers);
+
+/*
+ *  Save a copy of the current error counters in `edac'. Call
+ *   edac_handle_refresh () first to sample fresh values. The snapshot
+ *   must be freed with edac_snapshot_destroy (). Returns NULL on
+ *   error.
+ */
+edac_snapshot * edac_snapshot_take (edac_handle *edac);
+
+/*
+ *  Drop a reference to snapshot `snap', freeing it with the last
+ *   reference. edac_snapshot_destroy () is the same as
+ *   edac_snapshot_release ().
+ */
+void edac_snapshot_release (edac_snapshot *snap);
+void edac_snapshot_destroy (edac_snapshot *snap);
+
+/*
+ *  Refresh counters in `edac', take a snapshot and publish it for
+ *   edac_snapshot_acquire () with an atomic pointer swap. The
+ *   previously published snapshot is released once no reader can
+ *   still be picking it up. Like all other handle functions this
+ *   must only be called from one thread at a time.
+ *  Returns <0 on error.
+ */
+int edac_handle_publish (edac_handle *edac);
+
+/*
+ *  Return a reference to the last snapshot published on `edac', or
+ *   NULL if none has been published. Safe to call from any thread
+ *   concurrently with edac_handle_publish () and edac_handle_init ()
+ *   and takes no lock. Drop the reference with edac_snapshot_release ().
+ */
+edac_snapshot * edac_snapshot_acquire (edac_handle *edac);
+
+/*
+ *  Read-only queries on a snapshot. These touch only the snapshot and
+ *   may be called from any thread holding a reference. MCs, csrows
+ *   and DIMMs are addressed by index, so each reader iterates with
+ *   its own loop variables. Functions returning int return <0 if an
+ *   index is out of range.
+ */
+unsigned int edac_snapshot_mc_count (const edac_snapshot *snap);
+int edac_snapshot_mc_info (const edac_snapshot *snap, unsigned int mc,
+        struct edac_mc_info *info);
+unsigned int edac_snapshot_csrow_count (const edac_snapshot *snap,
+        unsigned int mc);
+int edac_snapshot_csrow_info (const edac_snapshot *snap, unsigned int mc,
+        unsigned int csrow, struct edac_csrow_info *info);
+unsigned int edac_snapshot_dimm_count (const edac_snapshot *snap,
+        unsigned int mc);
+int edac_snapshot_dimm_info (const edac_snapshot *snap, unsigned int mc,
+        unsigned int dimm, struct edac_dimm_info *info);
+int edac_snapshot_totals (const edac_snapshot *snap, 
+        struct edac_totals *totals);
+
+/*
+ *  Compare snapshots `prev' and `cur' of the same handle and store
+ *   up to `len' changed counters in `deltas'. Returns the total number
+ *   of changed counters (which may be more than `len'), or <0 if the
+ *   snapshots are not comparable, e.g. edac_handle_init () reloaded
+ *   the topology in between.
+ */
+int edac_snapshot_diff (edac_snapshot *prev, edac_snapshot *cur,
+        struct edac_delta *deltas, int len);
+
+/*
+ *  Describe counter index `counter' (as found in struct edac_delta)
+ *   in `loc'. Returns <0 if `counter' is out of range.
+ */
+int edac_counter_location (edac_handle *edac, unsigned int counter,
+        struct edac_location *loc);
+
+/*
+ *  Track error rates of every counter in `edac' over `nwindows'
+ *   windows, given as lengths in seconds in `windows'. If `windows' is
+ *   NULL, windows of 1 minute, 1 hour and 24 hours are used. Memory
+ *   is allocated here only. Returns NULL on error.
+ */
+edac_rate * edac_rate_create (edac_handle *edac, 
+        const unsigned int *windows, unsigned int nwindows);
+
+/*
+ *  Free rate tracker `rate'.
+ */
+void edac_rate_destroy (edac_rate *rate);
+
+/*
+ *  Add the handle's current counters, as sampled by the last
+ *   edac_handle_refresh (), to `rate' at the current time. The first
+ *   update only takes a baseline. Each update costs O(1) per counter
+ *   and window, threshold checks included. Returns the number of new
+ *   alerts (see edac_rate_alerts ()), or <0 if edac_handle_init ()
+ *   reloaded the handle since `rate' was created.
+ */
+int edac_rate_update (edac_rate *rate);
+
+/*
+ *  Raise an alert when `counter' sees `threshold' or more errors
+ *   within window `window' (an index into the windows given at
+ *   create). If `counter' is EDAC_RATE_ALL, set it for every counter.
+ *   A threshold of 0 disables the check. Returns <0 on error.
+ */
+#define EDAC_RATE_ALL ((unsigned int) -1)
+int edac_rate_set_threshold (edac_rate *rate, unsigned int counter,
+        unsigned int window, unsigned long long threshold);
+
+/*
+ *  Store the errors seen by `counter' within window `window' in `info'.
+ *   Returns <0 if either is out of range.
+ */
+int edac_rate_get (edac_rate *rate, unsigned int counter, 
+        unsigned int window, struct edac_rate_info *info);
+
+/*
+ *  Store up to `len' alerts raised by the last edac_rate_update () in
+ *   `alerts'. An alert is raised when a counter reaches its threshold,
+ *   and again only after it has dropped below it. Returns the number
+ *   of alerts, which may be more than `len'.
+ */
+int edac_rate_alerts (edac_rate *rate, struct edac_rate_alert *alerts, 
+        int len);
+
+/*
+ *  Open history file `path' to record the counters of `edac', creating
+ *   it with room for `nrecords' samples (a week of one per minute if
+ *   0). An existing file with the same counters and size is appended
+ *   to, otherwise it is started over. Only one process may record to a
+ *   file at a time. Returns NULL with errno set on error.
+ */
+edac_history * edac_history_create (edac_handle *edac, const char *path,
+        unsigned int nrecords);
+
+/*
+ *  Open history file `path' read-only. Returns NULL with errno set on
+ *   error.
+ */
+edac_history * edac_history_open (const char *path);
+
+/*
+ *  Close history file `h'.
+ */
+void edac_history_close (edac_history *h);
+
+/*
+ *  Append the counters of the history's handle, as last read by 
+ *   edac_handle_refresh (), to `h' with the current time. The sample is
+ *   copied into the mapped file with no system call; the oldest record
+ *   is overwritten once the file is full. If edac_handle_init () 
+ *   changed the counters, the history is started over. Returns <0 on
+ *   error.
+ */
+int edac_history_append (edac_history *h);
+
+/*
+ *  Fill in `info' for history file `h'.
+ */
+int edac_history_info (edac_history *h, struct edac_history_info *info);
+
+/*
+ *  Return the number of the first record of `h' taken at or after time
+ *   `t', or info.next if there is none, by binary search.
+ */
+unsigned long long edac_history_find (edac_history *h, time_t t);
+
+/*
+ *  Read record number `rec' of `h': its time into `t' and up to `len'
+ *   counter values, indexed as by edac_counter_location (), into
+ *   `values'. Returns the number of counters in the record, or <0 if
+ *   the record is no longer (or not yet) in the file.
+ */
+int edac_history_read (edac_history *h, unsigned long long rec, time_t *t,
+        unsigned long long *values, unsigned int len);
+
+/*
+ *  Describe counter `counter' of history `h' in `loc', and copy the
+ *   label of its DIMM when recorded, or "" into `label'.
+ *   Returns <0 if `counter' is out of range.
+ */
+int edac_history_location (edac_history *h, unsigned int counter,
+        struct edac_location *loc, char *label, int len);
+
+/*
+ *  Open the DIMM label database compiled from label file `db' and the
+ *   files in directory `dir' (by default labels.db and labels.d in
+ *   the edac configuration directory). The compiled database `cache'
+ *   is mapped if it is up to date, and otherwise compiled again and
+ *   rewritten. With a NULL `cache', a default file is used for the
+ *   default sources and the database is compiled in memory for
+ *   others. Returns NULL with errno set on error.
+ */
+edac_labeldb * edac_labeldb_open (const char *db, const char *dir, 
+        const char *cache);
+
+/*
+ *  Compile label database `db' and directory `dir' into `cache', as
+ *   edac_labeldb_open () would if it was out of date. Returns <0 with
+ *   errno set on error.
+ */
+int edac_labeldb_compile (const char *db, const char *dir, 
+        const char *cache);
+
+/*
+ *  Close label database `ldb'.
+ */
+void edac_labeldb_close (edac_labeldb *ldb);
+
+/*
+ *  Store up to `len' DIMM labels of mainboard `vendor' `model' in
+ *   `labels', ordered by location. Vendor and model are compared
+ *   without case. Returns the number of labels of the mainboard, which
+ *   may be more than `len', or <0 with errno ENOENT if it is not in
+ *   the database.
+ */
+int edac_labeldb_lookup (edac_labeldb *ldb, const char *vendor,
+        const char *model, struct edac_label *labels, int len);
+
+/*
+ *  Read ras:mc_event tracepoint records from the per-CPU raw ring
+ *   buffer pages under tracefs directory `root' (if NULL, the
+ *   EDAC_TRACEFS_ROOT environment variable or the mounted tracefs).
+ *   With EDAC_EVENTS_ENABLE, records are read from a tracefs instance
+ *   named "edac", which is created and has the tracepoint enabled if
+ *   needed. A directory holding copies of events/header_page,
+ *   events/ras/mc_event/format and per_cpu/cpuN/trace_pipe_raw is read
+ *   as recorded. Returns NULL with errno set on error.
+ */
+#define EDAC_EVENTS_ENABLE  0x1
+edac_events * edac_events_open (const char *root, int flags);
+
+/*
+ *  Close event reader `ev'. The tracepoint is left enabled so no
+ *   error is missed until the next open.
+ */
+void edac_events_close (edac_events *ev);
+
+/*
+ *  Decode up to `len' pending events into `events' without blocking.
+ *   Events of each CPU are in time order. Returns the number of
+ *   events, 0 if none are pending, or <0 with errno set on error.
+ */
+int edac_events_read (edac_events *ev, struct edac_event *events, int len);
+
+/*
+ *  Pass all pending events to `f' in batches, without blocking.
+ *   Returns the number of events, or <0 with errno set on error.
+ */
+int edac_events_dispatch (edac_events *ev, edac_events_f f, void *arg);
+
+/*
+ *  Wait up to `timeout' milliseconds (forever if <0) for events.
+ *   Returns >0 if events may be pending, 0 on timeout, or <0 with
+ *   errno set: EINTR if interrupted by a signal, ENODATA once recorded
+ *   pages are exhausted.
+ */
+int edac_events_wait (edac_events *ev, int timeout);
+
+/*
+ *  Return the number of events the kernel dropped because the ring
+ *   buffer was full, as far as it reported them.
+ */
+unsigned long long edac_events_lost (edac_events *ev);
+
 
 END_C_DECLS
 
@@ -0,0 +1,815 @@
+/*****************************************************************************
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2005-2007 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  Written by Mark Grondona <mgrondona@llnl.gov>
+ *  UCRL-CODE-230739.
+ *
+ *  This file is part of edac-utils.
+ *
+ *  This is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *****************************************************************************/
+
+/*
+ *  ras:mc_event tracepoint reader.
+ *
+ *  Each CPU's ring buffer is read a page at a time from tracefs
+ *   per_cpu/cpuN/trace_pipe_raw, and records are decoded straight from
+ *   the binary page. A page is a header holding the time of its first
+ *   event and the length of its data, followed by events, each with a
+ *   32-bit header of a 5-bit type/length and a 27-bit time delta.
+ *   The layout of the page header and of the mc_event record (offsets
+ *   and sizes of each field) are read from the tracefs format files,
+ *   so they follow the running kernel.
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "edac.h"
+
+#define TRACEFS_ROOT        "/sys/kernel/tracing"
+#define TRACEFS_DEBUG_ROOT  "/sys/kernel/debug/tracing"
+#define EVENTS_INSTANCE     "edac"
+
+/*  Event types in the 5-bit type_len of an event header. Data events
+ *   have type_len 1-28 (the length in 4-byte words) or 0 (length in
+ *   the following word).
+ */
+#define RB_TYPE_PADDING     29
+#define RB_TYPE_TIME_EXTEND 30
+#define RB_TYPE_TIME_STAMP  31
+#define RB_TS_SHIFT         27
+
+/*  Flags in the high bits of the page commit field
+ */
+#define RB_MISSED_EVENTS    (1UL << 31)
+#define RB_MISSED_STORED    (1UL << 30)
+#define RB_COMMIT_MASK      ((1UL << 30) - 1)
+
+/*  Events decoded per callback by edac_events_dispatch ()
+ */
+#define EVENTS_BATCH        64
+
+/*****************************************************************************
+ *  Data Types
+ *****************************************************************************/
+
+/*  mc_event fields used, as named in the tracepoint format
+ */
+enum event_field_id {
+    F_ERROR_TYPE,
+    F_ERROR_COUNT,
+    F_MC_INDEX,
+    F_TOP_LAYER,
+    F_MIDDLE_LAYER,
+    F_LOWER_LAYER,
+    F_ADDRESS,
+    F_GRAIN_BITS,
+    F_SYNDROME,
+    F_LABEL,
+    F_MSG,
+    F_DRIVER_DETAIL,
+    F_NFIELDS
+};
+
+static const char * const field_names[F_NFIELDS] = {
+    "error_type", "error_count", "mc_index", "top_layer", "middle_layer",
+    "lower_layer", "address", "grain_bits", "syndrome", "label", "msg",
+    "driver_detail"
+};
+
+struct event_field {
+    int                    present;         /* Field is in the format        */
+    unsigned int           offset;          /* Offset in record              */
+    unsigned int           size;            /* Size in bytes                 */
+    int                    is_signed;       /* Sign-extend value             */
+    int                    loc;             /* 0, or 1 for __data_loc and 2  */
+                                            /*  for __rel_loc strings        */
+};
+
+/*  Ring buffer of one CPU and the page being decoded
+ */
+struct events_cpu {
+    int                    cpu;             /* N in cpuN                     */
+    int                    fd;              /* trace_pipe_raw                */
+    int                    eof;             /* All recorded pages read       */
+    unsigned char *        page;            /* [page_size] current page      */
+    size_t                 off;             /* Next event in page            */
+    size_t                 end;             /* End of page data              */
+    unsigned long long     ts;              /* Time of last event            */
+};
+
+struct edac_events {
+    unsigned int           id;              /* mc_event common_type          */
+    struct event_field     field[F_NFIELDS];
+    size_t                 page_size;       /* Bytes per ring buffer page    */
+    size_t                 commit_size;     /* Size of page commit field     */
+    size_t                 data_offset;     /* Offset of events in page      */
+    struct events_cpu *    cpus;
+    unsigned int           ncpus;
+    unsigned int           next_cpu;        /* CPU read first by next read   */
+    struct pollfd *        pfds;            /* [ncpus] for edac_events_wait  */
+    unsigned long long     lost;            /* Events dropped by the kernel  */
+};
+
+/*****************************************************************************
+ *  Prototypes
+ *****************************************************************************/
+
+static int events_format_load (edac_events *ev, const char *dir);
+
+static void events_header_load (edac_events *ev, const char *dir);
+
+static int events_cpus_open (edac_events *ev, const char *dir);
+
+static int events_enable (const char *root, char *dir, size_t len);
+
+static int events_page_read (edac_events *ev, struct events_cpu *c);
+
+static int events_next (edac_events *ev, struct events_cpu *c,
+        struct edac_event *e);
+
+/*****************************************************************************
+ *  Functions
+ *****************************************************************************/
+
+edac_events * edac_events_open (const char *root, int flags)
+{
+    edac_events *ev;
+    char         dir[4096];
+    struct stat  st;
+    int          saved;
+
+    if (!root && !(root = getenv (EDAC_TRACEFS_ROOT_ENV))) {
+        root = (stat (TRACEFS_ROOT "/events", &st) == 0) ? TRACEFS_ROOT
+                                                          : TRACEFS_DEBUG_ROOT;
+    }
+
+    if (strlen (root) >= sizeof (dir)) {
+        errno = ENAMETOOLONG;
+        return (NULL);
+    }
+    strcpy (dir, root);
+    if (  (flags & EDAC_EVENTS_ENABLE)
+       && (events_enable (root, dir, sizeof (dir)) < 0))
+        return (NULL);
+
+    if (!(ev = calloc (1, sizeof (*ev))))
+        return (NULL);
+
+    if (events_format_load (ev, dir) < 0)
+        goto fail;
+
+    events_header_load (ev, dir);
+
+    if (events_cpus_open (ev, dir) < 0)
+        goto fail;
+
+    return (ev);
+
+  fail:
+    saved = errno;
+    edac_events_close (ev);
+    errno = saved;
+    return (NULL);
+}
+
+void edac_events_close (edac_events *ev)
+{
+    unsigned int i;
+
+    if (ev == NULL)
+        return;
+
+    for (i = 0; i < ev->ncpus; i++) {
+        if (ev->cpus[i].fd >= 0)
+            close (ev->cpus[i].fd);
+        free (ev->cpus[i].page);
+    }
+    free (ev->cpus);
+    free (ev->pfds);
+    free (ev);
+}
+
+int edac_events_read (edac_events *ev, struct edac_event *events, int len)
+{
+    unsigned int i;
+    int          n = 0;
+
+    if ((ev == NULL) || (events == NULL) || (len < 0)) {
+        errno = EINVAL;
+        return (-1);
+    }
+
+    /*  Drain each CPU in turn, starting where the last call stopped so
+     *   no CPU is starved when callers read in small batches
+     */
+    for (i = 0; (i < ev->ncpus) && (n < len); i++) {
+        struct events_cpu *c = &ev->cpus[ev->next_cpu];
+        int                rc;
+
+        while (n < len) {
+            if (events_next (ev, c, &events[n])) {
+                n++;
+                continue;
+            }
+            if ((rc = events_page_read (ev, c)) < 0)
+                return (n ? n : -1);
+            if (rc == 0)
+                break;
+        }
+        if (n < len)
+            ev->next_cpu = (ev->next_cpu + 1) % ev->ncpus;
+    }
+
+    return (n);
+}
+
+int edac_events_dispatch (edac_events *ev, edac_events_f f, void *arg)
+{
+    struct edac_event *batch;
+    int                total = 0;
+    int                n;
+
+    if ((ev == NULL) || (f == NULL)) {
+        errno = EINVAL;
+        return (-1);
+    }
+
+    if (!(batch = malloc (EVENTS_BATCH * sizeof (*batch))))
+        return (-1);
+
+    while ((n = edac_events_read (ev, batch, EVENTS_BATCH)) > 0) {
+        f (batch, n, arg);
+        total += n;
+    }
+
+    free (batch);
+
+    return ((n < 0) ? -1 : total);
+}
+
+int edac_events_wait (edac_events *ev, int timeout)
+{
+    unsigned int i;
+    int          n = 0;
+
+    if (ev == NULL) {
+        errno = EINVAL;
+        return (-1);
+    }
+
+    for (i = 0; i < ev->ncpus; i++) {
+        struct events_cpu *c = &ev->cpus[i];
+
+        /*  Events left in a page are pending now
+         */
+        if (c->off < c->end)
+            return (1);
+        if (c->eof)
+            continue;
+        ev->pfds[n].fd = c->fd;
+        ev->pfds[n].events = POLLIN;
+        ev->pfds[n++].revents = 0;
+    }
+
+    if (n == 0) {
+        errno = ENODATA;
+        return (-1);
+    }
+
+    return (poll (ev->pfds, n, timeout));
+}
+
+unsigned long long edac_events_lost (edac_events *ev)
+{
+    return (ev ? ev->lost : 0);
+}
+
+/*****************************************************************************
+ *  Private Functions
+ *****************************************************************************/
+
+/*  Join `dir' and `name' into `buf' of `len' bytes. Returns <0 with
+ *   errno ENAMETOOLONG if the result does not fit.
+ */
+static int
+path_join (char *buf, size_t len, const char *dir, const char *name)
+{
+    int n = snprintf (buf, len, "%s/%s", dir, name);
+
+    if ((n < 0) || ((size_t) n >= len)) {
+        errno = ENAMETOOLONG;
+        return (-1);
+    }
+    return (0);
+}
+
+/*  Read an unsigned integer of `size' bytes at `p', sign-extending it
+ *   if `is_signed'.
+ */
+static unsigned long long
+read_uint (const unsigned char *p, unsigned int size, int is_signed)
+{
+    uint8_t  u8;
+    uint16_t u16;
+    uint32_t u32;
+    uint64_t u64;
+
+    switch (size) {
+        case 1:
+            memcpy (&u8, p, 1);
+            return (is_signed ? (unsigned long long) (int8_t) u8 : u8);
+        case 2:
+            memcpy (&u16, p, 2);
+            return (is_signed ? (unsigned long long) (int16_t) u16 : u16);
+        case 4:
+            memcpy (&u32, p, 4);
+            return (is_signed ? (unsigned long long) (int32_t) u32 : u32);
+        case 8:
+            memcpy (&u64, p, 8);
+            return (u64);
+    }
+    return (0);
+}
+
+/*  Return the value of field `id' of record `rec' of `len' bytes, or
+ *   `dflt' if the field is missing.
+ */
+static unsigned long long
+field_uint (edac_events *ev, enum event_field_id id,
+        const unsigned char *rec, size_t len, unsigned long long dflt)
+{
+    const struct event_field *f = &ev->field[id];
+
+    if (!f->present || f->loc || (f->offset + f->size > len))
+        return (dflt);
+
+    return (read_uint (rec + f->offset, f->size, f->is_signed));
+}
+
+/*  Copy string field `id' of record `rec' into `buf'
+ */
+static void
+field_string (edac_events *ev, enum event_field_id id,
+        const unsigned char *rec, size_t len, char *buf, size_t buflen)
+{
+    const struct event_field *f = &ev->field[id];
+    uint32_t                  loc;
+    size_t                    off;
+    size_t                    n;
+
+    buf[0] = '\0';
+
+    if (!f->present || !f->loc || (f->size != 4) || (f->offset + 4 > len))
+        return;
+
+    /*  The low 16 bits give the string's offset, from the record start
+     *   for __data_loc or from the end of the field for __rel_loc, and
+     *   the high 16 bits its length including the NUL
+     */
+    memcpy (&loc, rec + f->offset, 4);
+    off = loc & 0xffff;
+    n =   loc >> 16;
+    if (f->loc == 2)
+        off += f->offset + f->size;
+
+    if ((off >= len) || (n == 0))
+        return;
+    if (n > len - off)
+        n = len - off;
+    if (n > buflen - 1)
+        n = buflen - 1;
+
+    memcpy (buf, rec + off, n);
+    buf[n] = '\0';
+}
+
+/*  Parse one "field:TYPE NAME;\toffset:N;\tsize:N;\tsigned:N;" line of
+ *   a tracefs format file into `f' and the field's `name'. Returns <0
+ *   if the line is not a field.
+ */
+static int
+format_field (const char *line, char *name, size_t len,
+        struct event_field *f)
+{
+    const char *decl;
+    const char *end;
+    const char *p;
+    unsigned    offset, size;
+    int         is_signed = 0;
+
+    while (isspace ((unsigned char) *line))
+        line++;
+    if (strncmp (line, "field:", 6) != 0)
+        return (-1);
+    decl = line + 6;
+    if (!(end = strchr (decl, ';')))
+        return (-1);
+
+    if (  !(p = strstr (end, "offset:"))
+       || (sscanf (p, "offset:%u;", &offset) != 1)
+       || !(p = strstr (end, "size:"))
+       || (sscanf (p, "size:%u;", &size) != 1))
+        return (-1);
+    if ((p = strstr (end, "signed:")))
+        sscanf (p, "signed:%d;", &is_signed);
+
+    /*  The name is the last word of the declaration, less any [N]
+     */
+    p = end;
+    while (p > decl) {
+        if (isspace ((unsigned char) p[-1]))
+            p--;
+        else if (p[-1] == ']') {
+            while ((p > decl) && (*--p != '['))
+                ;
+        }
+        else
+            break;
+    }
+    end = p;
+    while ((p > decl) && (isalnum ((unsigned char) p[-1]) || p[-1] == '_'))
+        p--;
+    if ((size_t) (end - p) >= len)
+        return (-1);
+    memcpy (name, p, end - p);
+    name[end - p] = '\0';
+
+    memset (f, 0, sizeof (*f));
+    f->present =   1;
+    f->offset =    offset;
+    f->size =      size;
+    f->is_signed = is_signed;
+    if (strstr (decl, "__data_loc") && (strstr (decl, "__data_loc") < end))
+        f->loc = 1;
+    else if (strstr (decl, "__rel_loc") && (strstr (decl, "__rel_loc") < end))
+        f->loc = 2;
+
+    return (0);
+}
+
+/*  Read the record id and field layout of ras:mc_event from `dir'
+ */
+static int
+events_format_load (edac_events *ev, const char *dir)
+{
+    char  path[4096];
+    char  line[1024];
+    char  name[64];
+    FILE *fp;
+    int   have_id = 0;
+    int   i;
+
+    if (path_join (path, sizeof (path), dir, "events/ras/mc_event/format") < 0)
+        return (-1);
+    if (!(fp = fopen (path, "r")))
+        return (-1);
+
+    while (fgets (line, sizeof (line), fp)) {
+        struct event_field f;
+
+        if (sscanf (line, "ID: %u", &ev->id) == 1) {
+            have_id = 1;
+            continue;
+        }
+        if (format_field (line, name, sizeof (name), &f) < 0)
+            continue;
+        for (i = 0; i < F_NFIELDS; i++) {
+            if (strcmp (name, field_names[i]) == 0)
+                ev->field[i] = f;
+        }
+    }
+    fclose (fp);
+
+    if (  !have_id || !ev->field[F_ERROR_TYPE].present
+       || !ev->field[F_MC_INDEX].present) {
+        errno = EINVAL;
+        return (-1);
+    }
+
+    return (0);
+}
+
+/*  Read the page header layout from `dir', assuming the layout of the
+ *   running kernel if it is missing
+ */
+static void
+events_header_load (edac_events *ev, const char *dir)
+{
+    char  path[4096];
+    char  line[1024];
+    char  name[64];
+    FILE *fp;
+
+    ev->commit_size = sizeof (long);
+    ev->data_offset = 8 + sizeof (long);
+    ev->page_size =   sysconf (_SC_PAGESIZE);
+
+    if (  (path_join (path, sizeof (path), dir, "events/header_page") < 0)
+       || !(fp = fopen (path, "r")))
+        return;
+
+    while (fgets (line, sizeof (line), fp)) {
+        struct event_field f;
+
+        if (format_field (line, name, sizeof (name), &f) < 0)
+            continue;
+        if (strcmp (name, "commit") == 0)
+            ev->commit_size = f.size;
+        else if (strcmp (name, "data") == 0) {
+            ev->data_offset = f.offset;
+            ev->page_size =   f.offset + f.size;
+        }
+    }
+    fclose (fp);
+}
+
+static int
+cpu_cmp (const void *a, const void *b)
+{
+    return (((const struct events_cpu *) a)->cpu
+          - ((const struct events_cpu *) b)->cpu);
+}
+
+/*  Open per_cpu/cpuN/trace_pipe_raw for every CPU under `dir'
+ */
+static int
+events_cpus_open (edac_events *ev, const char *dir)
+{
+    char           path[4096];
+    char           name[64];
+    struct dirent *d;
+    DIR *          dp;
+    int            cpu;
+
+    if (  (path_join (path, sizeof (path), dir, "per_cpu") < 0)
+       || !(dp = opendir (path)))
+        return (-1);
+
+    while ((d = readdir (dp))) {
+        struct events_cpu *c;
+        char               end;
+
+        if (sscanf (d->d_name, "cpu%d%c", &cpu, &end) != 1)
+            continue;
+
+        if (!(c = realloc (ev->cpus, (ev->ncpus + 1) * sizeof (*c))))
+            goto fail;
+        ev->cpus = c;
+        c = &ev->cpus[ev->ncpus];
+        memset (c, 0, sizeof (*c));
+        c->cpu = cpu;
+        c->fd = -1;
+        ev->ncpus++;
+
+        snprintf (name, sizeof (name), "per_cpu/cpu%d/trace_pipe_raw", cpu);
+        if (  (path_join (path, sizeof (path), dir, name) < 0)
+           || ((c->fd = open (path, O_RDONLY | O_NONBLOCK | O_CLOEXEC)) < 0)
+           || !(c->page = malloc (ev->page_size)))
+            goto fail;
+    }
+    closedir (dp);
+
+    if (ev->ncpus == 0) {
+        errno = ENOENT;
+        return (-1);
+    }
+    qsort (ev->cpus, ev->ncpus, sizeof (*ev->cpus), cpu_cmp);
+
+    if (!(ev->pfds = calloc (ev->ncpus, sizeof (*ev->pfds))))
+        return (-1);
+
+    return (0);
+
+  fail:
+    closedir (dp);
+    return (-1);
+}
+
+static int
+write_string (const char *path, const char *value)
+{
+    int fd;
+    int rc = 0;
+
+    if ((fd = open (path, O_WRONLY | O_CLOEXEC)) < 0)
+        return (-1);
+    if (write (fd, value, strlen (value)) < 0)
+        rc = -1;
+    if (close (fd) < 0)
+        rc = -1;
+
+    return (rc);
+}
+
+/*  Set up the tracefs instance under `root', if it has instances, and
+ *   enable ras:mc_event there. `dir' is set to the directory to read.
+ *   Only errors enabling the tracepoint are fatal.
+ */
+static int
+events_enable (const char *root, char *dir, size_t len)
+{
+    char        path[4096];
+    struct stat st;
+
+    if (path_join (path, sizeof (path), root, "instances") < 0)
+        return (-1);
+    if ((stat (path, &st) == 0) && S_ISDIR (st.st_mode)) {
+        if (path_join (dir, len, path, EVENTS_INSTANCE) < 0)
+            return (-1);
+        if ((mkdir (dir, 0755) < 0) && (errno != EEXIST))
+            return (-1);
+
+        /*  Wake readers on any data, not only once the buffer is half
+         *   full, which is the default
+         */
+        if (path_join (path, sizeof (path), dir, "buffer_percent") == 0)
+            write_string (path, "0");
+    }
+
+    if (path_join (path, sizeof (path), dir, "events/ras/mc_event/enable") < 0)
+        return (-1);
+    if ((access (path, F_OK) == 0) && (write_string (path, "1") < 0))
+        return (-1);
+
+    return (0);
+}
+
+/*  Read the next page of CPU `c'. Returns 1 if a page was read, 0 if
+ *   none is available, and <0 on error.
+ */
+static int
+events_page_read (edac_events *ev, struct events_cpu *c)
+{
+    unsigned long long commit;
+    ssize_t            n;
+
+    if (c->eof)
+        return (0);
+
+    do {
+        n = read (c->fd, c->page, ev->page_size);
+    } while ((n < 0) && (errno == EINTR));
+
+    if (n < 0)
+        return (((errno == EAGAIN) || (errno == EWOULDBLOCK)) ? 0 : -1);
+
+    /*  A live buffer fails with EAGAIN when empty, so end of file
+     *   means the end of recorded pages
+     */
+    if ((size_t) n < ev->data_offset) {
+        c->eof = 1;
+        return (0);
+    }
+
+    commit = read_uint (c->page + 8, ev->commit_size, 0);
+
+    /*  The kernel flags pages after which events were dropped, and may
+     *   store how many after the data
+     */
+    if (commit & RB_MISSED_EVENTS) {
+        size_t end = ev->data_offset + (commit & RB_COMMIT_MASK);
+        if (  (commit & RB_MISSED_STORED)
+           && (end + ev->commit_size <= (size_t) n))
+            ev->lost += read_uint (c->page + end, ev->commit_size, 0);
+        else
+            ev->lost++;
+    }
+
+    c->ts =  read_uint (c->page, 8, 0);
+    c->off = ev->data_offset;
+    c->end = ev->data_offset + (commit & RB_COMMIT_MASK);
+    if (c->end > (size_t) n)
+        c->end = n;
+
+    return (1);
+}
+
+/*  Decode the next mc_event record of the current page of `c' into
+ *   `e', skipping other events. Returns 0 at the end of the page.
+ */
+static int
+events_next (edac_events *ev, struct events_cpu *c, struct edac_event *e)
+{
+    while (c->off + 4 <= c->end) {
+        const unsigned char *rec;
+        uint32_t             hdr;
+        unsigned int         type_len;
+        unsigned int         delta;
+        size_t               p = c->off + 4;
+        size_t               len;
+
+        memcpy (&hdr, c->page + c->off, 4);
+        type_len = hdr & 0x1f;
+        delta =    hdr >> 5;
+
+        switch (type_len) {
+            case RB_TYPE_PADDING:
+                /*  Padding with no delta fills the rest of the page
+                 */
+                if ((delta == 0) || (p + 4 > c->end)) {
+                    c->off = c->end;
+                    return (0);
+                }
+                c->off = p + read_uint (c->page + p, 4, 0);
+                c->ts += delta;
+                continue;
+            case RB_TYPE_TIME_EXTEND:
+            case RB_TYPE_TIME_STAMP:
+                if (p + 4 > c->end) {
+                    c->off = c->end;
+                    return (0);
+                }
+                if (type_len == RB_TYPE_TIME_STAMP)
+                    c->ts = 0;
+                c->ts += (read_uint (c->page + p, 4, 0) << RB_TS_SHIFT)
+                       + delta;
+                c->off = p + 4;
+                continue;
+            case 0:
+                if (p + 4 > c->end) {
+                    c->off = c->end;
+                    return (0);
+                }
+                /*  The length word counts itself, so anything shorter
+                 *   is corrupt and would never move us along the page
+                 */
+                len = read_uint (c->page + p, 4, 0);
+                if (len < 4) {
+                    c->off = c->end;
+                    return (0);
+                }
+                len = (len - 4 + 3) & ~3UL;
+                p += 4;
+                break;
+            default:
+                len = type_len * 4;
+                break;
+        }
+
+        if ((p + len > c->end) || (p + len <= c->off)) {
+            c->off = c->end;
+            return (0);
+        }
+
+        c->ts += delta;
+        c->off = p + len;
+        rec = c->page + p;
+
+        if ((len < 2) || (read_uint (rec, 2, 0) != ev->id))
+            continue;
+
+        memset (e, 0, sizeof (*e));
+        e->timestamp = c->ts;
+        e->cpu =       c->cpu;
+        e->type =      field_uint (ev, F_ERROR_TYPE, rec, len, 0);
+        e->count =     field_uint (ev, F_ERROR_COUNT, rec, len, 1);
+        e->mc =        field_uint (ev, F_MC_INDEX, rec, len, 0);
+        e->layer[0] =  field_uint (ev, F_TOP_LAYER, rec, len, -1);
+        e->layer[1] =  field_uint (ev, F_MIDDLE_LAYER, rec, len, -1);
+        e->layer[2] =  field_uint (ev, F_LOWER_LAYER, rec, len, -1);
+        e->address =   field_uint (ev, F_ADDRESS, rec, len, 0);
+        e->syndrome =  field_uint (ev, F_SYNDROME, rec, len, 0);
+        e->grain =     1ULL << (field_uint (ev, F_GRAIN_BITS, rec, len, 0)
+                                & 63);
+        field_string (ev, F_LABEL, rec, len, e->label, sizeof (e->label));
+        field_string (ev, F_MSG, rec, len, e->msg, sizeof (e->msg));
+        field_string (ev, F_DRIVER_DETAIL, rec, len, e->detail,
+                      sizeof (e->detail));
+        return (1);
+    }
+
+    c->off = c->end;
+    return (0);
+}
+
+/* vi: ts=4 sw=4 expandtab
+ */
@@ -0,0 +1,453 @@
+/*****************************************************************************
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2005-2007 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  Written by Mark Grondona <mgrondona@llnl.gov>
+ *  UCRL-CODE-230739.
+ *
+ *  This file is part of edac-utils.
+ *
+ *  This is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *****************************************************************************/
+
+/*
+ *  On-disk counter history ring: a fixed-size file mapped with
+ *   mmap(2), appended to by one writer and read without locks.
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "edac_histfile.h"
+
+/*  Records kept when neither the caller nor an existing file says
+ *   otherwise: one week of samples at one per minute.
+ */
+#define EDAC_HISTFILE_RECORDS 10080
+
+/*****************************************************************************
+ *  Data Types
+ *****************************************************************************/
+
+struct edac_histfile {
+    int                    fd;              /* history file                  */
+    void *                 base;            /* mapping of whole file         */
+    size_t                 len;             /* length of mapping             */
+    struct edac_histfile_header *
+                           h;               /* header at base                */
+    struct edac_histfile_header
+                           hdr;             /* layout when opened            */
+};
+
+
+/*****************************************************************************
+ *  Private Functions
+ *****************************************************************************/
+
+static int
+histfile_map (edac_histfile *f, size_t len, int prot)
+{
+    void *p;
+
+    if ((p = mmap (NULL, len, prot, MAP_SHARED, f->fd, 0)) == MAP_FAILED)
+        return (-1);
+
+    if (f->base)
+        munmap (f->base, f->len);
+
+    f->base = p;
+    f->len =  len;
+    f->h =    p;
+
+    return (0);
+}
+
+static void
+histfile_free (edac_histfile *f)
+{
+    int saved_errno = errno;
+
+    if (f->base)
+        munmap (f->base, f->len);
+    if (f->fd >= 0)
+        close (f->fd);
+    free (f);
+
+    errno = saved_errno;
+}
+
+/*  Fill in the layout of a file with `nrecords' records of `nvalues'
+ *   counters in `h' and return its total size.
+ */
+static size_t
+histfile_layout (struct edac_histfile_header *h, uint32_t nrecords, 
+        uint32_t nvalues)
+{
+    long pagesize = sysconf (_SC_PAGESIZE);
+
+    memset (h, 0, sizeof (*h));
+    h->magic =         EDAC_HISTFILE_MAGIC;
+    h->version =       EDAC_HISTFILE_VERSION;
+    h->nrecords =      nrecords;
+    h->nvalues =       nvalues;
+    h->record_size =   sizeof (struct edac_histfile_record) 
+                     + nvalues * sizeof (uint64_t);
+    h->off_locations = (sizeof (*h) + 63) & ~63;
+    h->off_records =   h->off_locations 
+                     + nvalues * sizeof (struct edac_histfile_location);
+    h->off_records =   (h->off_records + pagesize - 1) / pagesize * pagesize;
+
+    return (h->off_records + (size_t) nrecords * h->record_size);
+}
+
+/*  Return 1 if the mapped file in `f' has the layout in `h' and its
+ *   counters are at `locs'. Labels are not compared.
+ */
+static int
+histfile_compatible (edac_histfile *f, const struct edac_histfile_header *h,
+        const struct edac_histfile_location *locs)
+{
+    const struct edac_histfile_location *l;
+    uint32_t                             i;
+
+    if (  (f->len < h->off_records)
+       || (f->h->magic != h->magic)
+       || (f->h->version != h->version)
+       || (f->h->nrecords != h->nrecords)
+       || (f->h->nvalues != h->nvalues)
+       || (f->h->record_size != h->record_size)
+       || (f->h->off_locations != h->off_locations)
+       || (f->h->off_records != h->off_records))
+        return (0);
+
+    l = (const void *) ((char *) f->base + h->off_locations);
+
+    for (i = 0; i < h->nvalues; i++) {
+        if (  (l[i].type != locs[i].type)
+           || (l[i].channel != locs[i].channel)
+           || strncmp (l[i].mc_id, locs[i].mc_id, EDAC_NAME_LEN)
+           || strncmp (l[i].id, locs[i].id, EDAC_NAME_LEN))
+            return (0);
+    }
+
+    return (1);
+}
+
+/*  Lay out a new file for `h', `size' bytes, and rename it over `path'
+ *   once complete. Readers of the old file keep their mapping of it,
+ *   which is never truncated under them, and stop finding new records
+ *   there. The new file is locked before it can be found by name.
+ */
+static int
+histfile_replace (edac_histfile *f, const char *path, 
+        struct edac_histfile_header *h, size_t size)
+{
+    char tmp[4096];
+    int  fd;
+    int  n;
+
+    n = snprintf (tmp, sizeof (tmp), "%s.XXXXXX", path);
+    if ((n < 0) || ((size_t) n >= sizeof (tmp))) {
+        errno = ENAMETOOLONG;
+        return (-1);
+    }
+
+    if ((fd = mkstemp (tmp)) < 0)
+        return (-1);
+
+    if (  (fcntl (fd, F_SETFD, FD_CLOEXEC) < 0)
+       || (fchmod (fd, 0644) < 0)
+       || (flock (fd, LOCK_EX | LOCK_NB) < 0)
+       || (ftruncate (fd, size) < 0))
+        goto fail;
+
+    if (f->fd >= 0)
+        close (f->fd);
+    f->fd = fd;
+
+    if (histfile_map (f, size, PROT_READ | PROT_WRITE) < 0) {
+        unlink (tmp);
+        return (-1);
+    }
+
+    h->created = time (NULL);
+    memcpy (f->h, h, sizeof (*h));
+
+    if (rename (tmp, path) < 0) {
+        unlink (tmp);
+        return (-1);
+    }
+
+    return (0);
+
+fail:
+    close (fd);
+    unlink (tmp);
+    return (-1);
+}
+
+/*  Return 1 if the file in `f' still has the layout it had when it was
+ *   opened. Only a writer replacing it in place could change that.
+ */
+static int
+histfile_same (edac_histfile *f)
+{
+    const struct edac_histfile_header *h = f->h;
+
+    return (  (h->magic == f->hdr.magic)
+           && (h->version == f->hdr.version)
+           && (h->nrecords == f->hdr.nrecords)
+           && (h->nvalues == f->hdr.nvalues)
+           && (h->record_size == f->hdr.record_size)
+           && (h->off_locations == f->hdr.off_locations)
+           && (h->off_records == f->hdr.off_records));
+}
+
+/*  Slots are located with the layout cached at open, which was checked
+ *   against the size of the mapping, so they are always inside it.
+ */
+static struct edac_histfile_record *
+histfile_slot (edac_histfile *f, uint64_t n)
+{
+    return ((void *) ((char *) f->base + f->hdr.off_records 
+                      + (n % f->hdr.nrecords) * f->hdr.record_size));
+}
+
+/*  Return 1 if record `n' read after `next' was seen to be `before' and
+ *   before it was `after' is complete and was not overwritten.
+ */
+static int
+histfile_valid (edac_histfile *f, uint64_t n, uint64_t before, 
+        uint64_t after)
+{
+    return ((n < before) && (n + f->hdr.nrecords > after));
+}
+
+
+/*****************************************************************************
+ *  Functions
+ *****************************************************************************/
+
+edac_histfile * edac_histfile_create (const char *path, uint32_t nrecords, 
+        uint32_t nvalues, const struct edac_histfile_location *locs)
+{
+    struct edac_histfile_header h;
+    struct edac_histfile_location *l;
+    struct stat                 st;
+    edac_histfile *             f;
+    size_t                      size;
+
+    if (!(f = calloc (1, sizeof (*f))))
+        return (NULL);
+
+    if ((f->fd = open (path, O_RDWR | O_CREAT | O_CLOEXEC, 0644)) < 0)
+        goto fail;
+
+    if (flock (f->fd, LOCK_EX | LOCK_NB) < 0) {
+        if (errno == EWOULDBLOCK)
+            errno = EBUSY;
+        goto fail;
+    }
+
+    if (fstat (f->fd, &st) < 0)
+        goto fail;
+
+    if (  (st.st_size >= (off_t) sizeof (h))
+       && (histfile_map (f, st.st_size, PROT_READ | PROT_WRITE) < 0))
+        goto fail;
+
+    /*  Keep the size of an existing file unless told otherwise
+     */
+    if ((nrecords == 0) && f->h && (f->h->magic == EDAC_HISTFILE_MAGIC))
+        nrecords = f->h->nrecords;
+    if (nrecords == 0)
+        nrecords = EDAC_HISTFILE_RECORDS;
+
+    size = histfile_layout (&h, nrecords, nvalues);
+
+    if (  !f->h || (st.st_size != (off_t) size)
+       || !histfile_compatible (f, &h, locs)) {
+        /*  Start over in a new file
+         */
+        if (histfile_replace (f, path, &h, size) < 0)
+            goto fail;
+    }
+
+    l = (void *) ((char *) f->base + f->h->off_locations);
+    memcpy (l, locs, nvalues * sizeof (*l));
+    f->hdr = *f->h;
+
+    return (f);
+
+fail:
+    histfile_free (f);
+    return (NULL);
+}
+
+edac_histfile * edac_histfile_open (const char *path)
+{
+    struct edac_histfile_header h;
+    struct stat                 st;
+    edac_histfile *             f;
+
+    if (!(f = calloc (1, sizeof (*f))))
+        return (NULL);
+
+    if (  ((f->fd = open (path, O_RDONLY | O_CLOEXEC)) < 0)
+       || (fstat (f->fd, &st) < 0))
+        goto fail;
+
+    if (  (st.st_size < (off_t) sizeof (h))
+       || (histfile_map (f, st.st_size, PROT_READ) < 0))
+        goto fail;
+
+    /*  Check the copy which will be used from now on
+     */
+    f->hdr = *f->h;
+    if (  (f->hdr.magic != EDAC_HISTFILE_MAGIC)
+       || (f->hdr.version != EDAC_HISTFILE_VERSION)
+       || (f->hdr.nrecords == 0)
+       || (histfile_layout (&h, f->hdr.nrecords, f->hdr.nvalues) != f->len)
+       || (h.record_size != f->hdr.record_size)
+       || (h.off_locations != f->hdr.off_locations)
+       || (h.off_records != f->hdr.off_records)) {
+        errno = EINVAL;
+        goto fail;
+    }
+
+    return (f);
+
+fail:
+    histfile_free (f);
+    return (NULL);
+}
+
+void edac_histfile_close (edac_histfile *f)
+{
+    if (f == NULL)
+        return;
+
+    histfile_free (f);
+}
+
+const struct edac_histfile_header * edac_histfile_header (edac_histfile *f)
+{
+    return (&f->hdr);
+}
+
+const struct edac_histfile_location * 
+edac_histfile_locations (edac_histfile *f)
+{
+    return ((const void *) ((char *) f->base + f->hdr.off_locations));
+}
+
+uint64_t edac_histfile_next (edac_histfile *f)
+{
+    return (f->h->next);
+}
+
+void edac_histfile_append (edac_histfile *f, int64_t time, 
+        const uint64_t *values)
+{
+    uint64_t                     n = f->h->next;
+    struct edac_histfile_record *r = histfile_slot (f, n);
+
+    r->time = time;
+    r->seq =  n;
+    memcpy (r->values, values, f->hdr.nvalues * sizeof (uint64_t));
+
+    /*  Readers only trust records below `next', so the record must be
+     *   complete before it is published.
+     */
+    __sync_synchronize ();
+    f->h->next = n + 1;
+}
+
+uint64_t edac_histfile_first (edac_histfile *f)
+{
+    uint64_t next = f->h->next;
+
+    /*  The slot of the oldest record is the next one written, so it
+     *   may be overwritten while being read. Skip it.
+     */
+    return ((next >= f->hdr.nrecords) ? next - f->hdr.nrecords + 1 : 0);
+}
+
+int edac_histfile_read (edac_histfile *f, uint64_t n, 
+        struct edac_histfile_record *rec)
+{
+    uint64_t before = f->h->next;
+    uint64_t after;
+
+    if (!histfile_same (f)) {
+        errno = EINVAL;
+        return (-1);
+    }
+
+    __sync_synchronize ();
+    memcpy (rec, histfile_slot (f, n), f->hdr.record_size);
+    __sync_synchronize ();
+    after = f->h->next;
+
+    if (!histfile_same (f)) {
+        errno = EINVAL;
+        return (-1);
+    }
+
+    if (!histfile_valid (f, n, before, after) || (rec->seq != n))
+        return (-1);
+
+    return (0);
+}
+
+int edac_histfile_time (edac_histfile *f, uint64_t n, int64_t *time)
+{
+    const struct edac_histfile_record *r = histfile_slot (f, n);
+    uint64_t                           before = f->h->next;
+    uint64_t                           after;
+    uint64_t                           seq;
+
+    __sync_synchronize ();
+    *time = r->time;
+    seq =   r->seq;
+    __sync_synchronize ();
+    after = f->h->next;
+
+    if (!histfile_same (f)) {
+        errno = EINVAL;
+        return (-1);
+    }
+
+    if (!histfile_valid (f, n, before, after) || (seq != n))
+        return (-1);
+
+    return (0);
+}
+
+/* vi: ts=4 sw=4 expandtab
+ */
@@ -0,0 +1,147 @@
+/*****************************************************************************
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2005-2007 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  Written by Mark Grondona <mgrondona@llnl.gov>
+ *  UCRL-CODE-230739.
+ *
+ *  This file is part of edac-utils.
+ *
+ *  This is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *****************************************************************************/
+
+/*
+ *  Private interface to the on-disk counter history ring.
+ *
+ *  The file has a fixed size: a header, a table describing the
+ *   location of each counter, and a ring of `nrecords' fixed-size
+ *   records, each a timestamp and one value per counter. A writer
+ *   copies a record into slot `next % nrecords' of the mapping and
+ *   then increments `next', so a reader knows which records are
+ *   complete and which may have been overwritten while it copied
+ *   them, without any lock. Only one writer may have the file open.
+ *
+ *  A file is never laid out again in place: a writer needing a new
+ *   layout writes a new file and renames it over the old one, so a
+ *   reader's mapping stays valid. Readers use the layout cached when
+ *   they opened the file, and fail with EINVAL should it change.
+ */
+
+#ifndef _EDAC_HISTFILE_H
+#define _EDAC_HISTFILE_H
+
+#include <stdint.h>
+
+#include "edac.h"
+
+#define EDAC_HISTFILE_MAGIC    0x45444848   /* "EDHH"                        */
+#define EDAC_HISTFILE_VERSION  1
+
+struct edac_histfile_header {
+    uint32_t               magic;           /* EDAC_HISTFILE_MAGIC           */
+    uint32_t               version;         /* EDAC_HISTFILE_VERSION         */
+    uint32_t               nrecords;        /* slots in ring                 */
+    uint32_t               nvalues;         /* counters per record           */
+    uint32_t               record_size;     /* bytes per record              */
+    uint32_t               pad;
+    volatile uint64_t      next;            /* records written since created */
+    int64_t                created;         /* time file was (re)created     */
+    uint64_t               off_locations;   /* offsets from file start       */
+    uint64_t               off_records;
+};
+
+struct edac_histfile_location {
+    uint32_t               type;            /* enum edac_counter_type        */
+    int32_t                channel;         /* channel number, or -1         */
+    char                   mc_id[EDAC_NAME_LEN];
+    char                   id[EDAC_NAME_LEN];
+    char                   label[EDAC_LABEL_LEN];
+                                            /* DIMM label or ""              */
+};
+
+struct edac_histfile_record {
+    int64_t                time;            /* time of sample                */
+    uint64_t               seq;             /* record number                 */
+    uint64_t               values[];        /* [nvalues]                     */
+};
+
+typedef struct edac_histfile edac_histfile;
+
+/*
+ *  Open history file `path' for writing, creating it if needed. An
+ *   existing file is kept if it has `nrecords' slots (or `nrecords' is
+ *   0) and its counters are at `locs', and is otherwise emptied and
+ *   laid out again. Labels in `locs' replace those in the file. Fails
+ *   with EBUSY if another process is writing to the file.
+ */
+edac_histfile * edac_histfile_create (const char *path, uint32_t nrecords, 
+        uint32_t nvalues, const struct edac_histfile_location *locs);
+
+/*
+ *  Map history file `path' read-only. Fails with EINVAL if it is not
+ *   a history file.
+ */
+edac_histfile * edac_histfile_open (const char *path);
+
+/*
+ *  Unmap history file `f'.
+ */
+void edac_histfile_close (edac_histfile *f);
+
+/*
+ *  Return the header, as it was when `f' was opened, and the location
+ *   table of history file `f'.
+ */
+const struct edac_histfile_header * edac_histfile_header (edac_histfile *f);
+const struct edac_histfile_location * 
+        edac_histfile_locations (edac_histfile *f);
+
+/*
+ *  Return the number of the next record to be written.
+ */
+uint64_t edac_histfile_next (edac_histfile *f);
+
+/*
+ *  Writer: append a record of `time' and the header's nvalues counters
+ *   in `values', overwriting the oldest record once the ring is full.
+ */
+void edac_histfile_append (edac_histfile *f, int64_t time, 
+        const uint64_t *values);
+
+/*
+ *  Return the number of the oldest record which can still be read.
+ */
+uint64_t edac_histfile_first (edac_histfile *f);
+
+/*
+ *  Copy record number `n' into `rec', which must have room for
+ *   record_size bytes. Returns <0 if the record has not been written
+ *   yet or was overwritten, or with errno EINVAL if the file was laid
+ *   out again since it was opened.
+ */
+int edac_histfile_read (edac_histfile *f, uint64_t n, 
+        struct edac_histfile_record *rec);
+
+/*
+ *  Read only the time of record number `n' into `time'. Returns <0 as
+ *   for edac_histfile_read ().
+ */
+int edac_histfile_time (edac_histfile *f, uint64_t n, int64_t *time);
+
+#endif /* !_EDAC_HISTFILE_H */
+
+/* vi: ts=4 sw=4 expandtab
+ */
@@ -0,0 +1,1029 @@
+/*****************************************************************************
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2005-2007 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  Written by Mark Grondona <mgrondona@llnl.gov>
+ *  UCRL-CODE-230739.
+ *
+ *  This file is part of edac-utils.
+ *
+ *  This is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *****************************************************************************/
+
+/*
+ *  Compiled DIMM label database.
+ *
+ *  The text label database (labels.db and the files in labels.d) is
+ *   compiled into a single file holding a hash table of mainboards,
+ *   keyed by lowercase vendor and model, each pointing to its run of
+ *   label entries. The compiled file is mapped read-only, so a lookup
+ *   is one hash probe however many boards the database describes. It
+ *   also records the size and mtime of every source it was compiled
+ *   from, and is rebuilt on open when any of them changed.
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "edac.h"
+
+#ifndef SYSCONFDIR
+#  define SYSCONFDIR "/etc"
+#endif
+#ifndef LOCALSTATEDIR
+#  define LOCALSTATEDIR "/var"
+#endif
+
+#define LABELDB_FILE      SYSCONFDIR "/edac/labels.db"
+#define LABELDB_DIR       SYSCONFDIR "/edac/labels.d"
+#define LABELDB_CACHE     LOCALSTATEDIR "/cache/edac/labels.cache"
+
+#define LABELDB_MAGIC     0x45444c42        /* "EDLB"                        */
+#define LABELDB_VERSION   1
+
+/*****************************************************************************
+ *  Data Types
+ *****************************************************************************/
+
+/*  Compiled database layout. All offsets are from the start of the
+ *   file, except string offsets which are from `off_strings'.
+ */
+struct labeldb_header {
+    uint32_t               magic;           /* LABELDB_MAGIC                 */
+    uint32_t               version;         /* LABELDB_VERSION               */
+    uint32_t               size;            /* total bytes                   */
+    uint32_t               nsources;
+    uint32_t               nbuckets;        /* power of 2                    */
+    uint32_t               nboards;
+    uint32_t               nentries;
+    uint32_t               nstrings;        /* bytes of strings              */
+    uint32_t               off_sources;
+    uint32_t               off_buckets;
+    uint32_t               off_boards;
+    uint32_t               off_entries;
+    uint32_t               off_strings;
+    uint32_t               pad;
+};
+
+/*  A file or directory the database was compiled from
+ */
+struct labeldb_source {
+    int64_t                mtime;           /* st_mtime, or -1 if absent     */
+    int64_t                mtime_nsec;
+    int64_t                size;
+    uint32_t               path;            /* string                        */
+    uint32_t               pad;
+};
+
+struct labeldb_bucket {
+    uint32_t               hash;            /* hash of vendor and model      */
+    uint32_t               board;           /* index + 1, or 0 if empty      */
+};
+
+struct labeldb_board {
+    uint32_t               vendor;          /* lowercase vendor string       */
+    uint32_t               model;           /* lowercase model string        */
+    uint32_t               first;           /* index of first entry          */
+    uint32_t               nentries;
+};
+
+struct labeldb_entry {
+    uint32_t               mc;
+    uint32_t               row;
+    uint32_t               channel;
+    uint32_t               label;           /* string                        */
+};
+
+struct edac_labeldb {
+    void *                 base;            /* compiled database             */
+    size_t                 len;
+    int                    mapped;          /* base is mmap()ed, not malloc  */
+};
+
+/*  Growable byte buffer used while compiling
+ */
+struct lbuf {
+    char *                 data;
+    size_t                 len;
+    size_t                 size;
+};
+
+/*  One "label: mc.row.chan" assignment for one board, in the order
+ *   read. Strings are offsets into the compiler's string buffer.
+ */
+struct assign {
+    uint32_t               vendor;
+    uint32_t               model;
+    uint32_t               mc;
+    uint32_t               row;
+    uint32_t               channel;
+    uint32_t               label;
+    uint32_t               seq;             /* later assignments win         */
+    const char *           v;               /* vendor and model strings,     */
+    const char *           m;               /*  set once parsing is done     */
+};
+
+struct compiler {
+    struct lbuf            strings;
+    struct assign *        assigns;
+    size_t                 nassigns;
+    size_t                 assigns_size;
+};
+
+
+/*****************************************************************************
+ *  Private Functions
+ *****************************************************************************/
+
+static int
+lbuf_reserve (struct lbuf *b, size_t n)
+{
+    char * p;
+    size_t size = b->size ? b->size : 4096;
+
+    if (b->len + n <= b->size)
+        return (0);
+
+    while (size < b->len + n)
+        size *= 2;
+
+    if (!(p = realloc (b->data, size)))
+        return (-1);
+
+    b->data = p;
+    b->size = size;
+
+    return (0);
+}
+
+/*  Append `n' bytes of `p' to `b' and return their offset, or -1
+ */
+static long
+lbuf_add (struct lbuf *b, const void *p, size_t n)
+{
+    long off = b->len;
+
+    if (lbuf_reserve (b, n) < 0)
+        return (-1);
+
+    memcpy (b->data + b->len, p, n);
+    b->len += n;
+
+    return (off);
+}
+
+/*  Append string `s' of length `n' (lowercased if `lower') with its NUL
+ */
+static long
+lbuf_add_string (struct lbuf *b, const char *s, size_t n, int lower)
+{
+    long   off = b->len;
+    size_t i;
+
+    if (lbuf_reserve (b, n + 1) < 0)
+        return (-1);
+
+    for (i = 0; i < n; i++)
+        b->data[b->len++] = lower ? tolower ((unsigned char) s[i]) : s[i];
+    b->data[b->len++] = '\0';
+
+    return (off);
+}
+
+/*  FNV-1a of the lowercase vendor and model
+ */
+static uint32_t
+labeldb_hash (const char *vendor, const char *model)
+{
+    uint32_t    h = 2166136261u;
+    const char *p;
+
+    for (p = vendor; *p; p++)
+        h = (h ^ (unsigned char) tolower ((unsigned char) *p)) * 16777619u;
+    h = (h ^ 0) * 16777619u;
+    for (p = model; *p; p++)
+        h = (h ^ (unsigned char) tolower ((unsigned char) *p)) * 16777619u;
+
+    return (h);
+}
+
+/*  Return `s' with leading whitespace skipped and set `*n' to its
+ *   length without trailing whitespace, up to `end'.
+ */
+static const char *
+trim (const char *s, const char *end, size_t *n)
+{
+    while ((s < end) && isspace ((unsigned char) *s))
+        s++;
+    while ((end > s) && isspace ((unsigned char) end[-1]))
+        end--;
+    *n = end - s;
+    return (s);
+}
+
+/*  If line `s' starts with keyword `key' and a colon, return what
+ *   follows the colon.
+ */
+static const char *
+keyword (const char *s, const char *key)
+{
+    size_t n = strlen (key);
+
+    if (strncasecmp (s, key, n) != 0)
+        return (NULL);
+    for (s += n; isspace ((unsigned char) *s); s++)
+        ;
+    return ((*s == ':') ? s + 1 : NULL);
+}
+
+static int
+compiler_assign (struct compiler *c, uint32_t vendor, uint32_t model,
+        uint32_t mc, uint32_t row, uint32_t channel, uint32_t label)
+{
+    struct assign *a;
+
+    if (c->nassigns == c->assigns_size) {
+        size_t size = c->assigns_size ? 2 * c->assigns_size : 256;
+        if (!(a = realloc (c->assigns, size * sizeof (*a))))
+            return (-1);
+        c->assigns =      a;
+        c->assigns_size = size;
+    }
+
+    a = &c->assigns[c->nassigns];
+    a->vendor =  vendor;
+    a->model =   model;
+    a->mc =      mc;
+    a->row =     row;
+    a->channel = channel;
+    a->label =   label;
+    a->seq =     c->nassigns++;
+
+    return (0);
+}
+
+/*  Parse one "label: mc.row.chan[, mc.row.chan...]" item for every
+ *   model in `models'. Items which do not parse are ignored.
+ */
+static int
+compiler_label (struct compiler *c, const char *s, const char *end,
+        uint32_t vendor, const uint32_t *models, size_t nmodels)
+{
+    const char *colon = NULL;
+    const char *p;
+    long        label;
+    size_t      n;
+
+    for (p = s; p < end; p++) {
+        if (*p == ':')
+            colon = p;
+    }
+    if (!colon || !nmodels)
+        return (0);
+
+    s = trim (s, colon, &n);
+    if (n == 0)
+        return (0);
+    if ((label = lbuf_add_string (&c->strings, s, n, 0)) < 0)
+        return (-1);
+
+    for (p = colon + 1; p < end; ) {
+        unsigned long v[3];
+        char *        q;
+        int           i;
+        size_t        k;
+
+        while ((p < end) && ((*p == ',') || isspace ((unsigned char) *p)))
+            p++;
+        if (p == end)
+            break;
+
+        for (i = 0; i < 3; i++) {
+            if (!isdigit ((unsigned char) *p))
+                break;
+            v[i] = strtoul (p, &q, 10);
+            p = q;
+            if ((i < 2) && (*p++ != '.'))
+                break;
+        }
+        if (  (i < 3) || (v[0] > UINT32_MAX) || (v[1] > UINT32_MAX) 
+           || (v[2] > UINT32_MAX)) {
+            /*  Skip a malformed target
+             */
+            while ((p < end) && (*p != ',') && !isspace ((unsigned char) *p))
+                p++;
+            continue;
+        }
+
+        for (k = 0; k < nmodels; k++) {
+            if (compiler_assign (c, vendor, models[k], v[0], v[1], v[2], 
+                                 label) < 0)
+                return (-1);
+        }
+    }
+
+    return (0);
+}
+
+/*  Read the label database `path' into `c'. The syntax is
+ *
+ *    Vendor: <vendor>
+ *      Model: <model>[, <model>...]
+ *        <label>: <mc>.<row>.<chan>[, ...][; <label>: ...]
+ *
+ *   with lines starting with '#' ignored.
+ */
+static int
+compiler_read (struct compiler *c, const char *path)
+{
+    FILE *     fp;
+    char *     line = NULL;
+    size_t     size = 0;
+    ssize_t    len;
+    long       vendor = -1;
+    uint32_t * models = NULL;
+    size_t     nmodels = 0;
+    int        rc = 0;
+
+    if (!(fp = fopen (path, "r")))
+        return (-1);
+
+    while ((rc == 0) && ((len = getline (&line, &size, fp)) >= 0)) {
+        const char *s;
+        const char *end = line + len;
+        const char *p;
+        size_t      n;
+
+        if (line[0] == '#')
+            continue;
+
+        s = trim (line, end, &n);
+        end = s + n;
+        if (n == 0)
+            continue;
+
+        if ((p = keyword (s, "vendor"))) {
+            p = trim (p, end, &n);
+            vendor = n ? lbuf_add_string (&c->strings, p, n, 1) : -1;
+            nmodels = 0;
+            if (n && (vendor < 0))
+                rc = -1;
+        }
+        else if ((p = keyword (s, "model")) || (p = keyword (s, "board"))) {
+            nmodels = 0;
+            while ((vendor >= 0) && (p < end)) {
+                const char *q = p;
+                const char *name;
+                uint32_t *  m;
+                long        model;
+
+                while ((q < end) && (*q != ',') && (*q != ';'))
+                    q++;
+                name = trim (p, q, &n);
+                p = q + 1;
+                if (n == 0)
+                    continue;
+
+                if (!(m = realloc (models, (nmodels + 1) * sizeof (*m)))) {
+                    rc = -1;
+                    break;
+                }
+                models = m;
+                if ((model = lbuf_add_string (&c->strings, name, n, 1)) < 0) {
+                    rc = -1;
+                    break;
+                }
+                models[nmodels++] = model;
+            }
+        }
+        else if (vendor >= 0) {
+            /*  Several labels may be given on one line, separated by ';'
+             */
+            for (p = s; (rc == 0) && (p < end); ) {
+                const char *q = p;
+                while ((q < end) && (*q != ';'))
+                    q++;
+                rc = compiler_label (c, p, q, vendor, models, nmodels);
+                p = q + 1;
+            }
+        }
+    }
+
+    free (line);
+    free (models);
+    fclose (fp);
+
+    return (rc);
+}
+
+static int
+assign_cmp (const void *x, const void *y)
+{
+    const struct assign *a = x;
+    const struct assign *b = y;
+    int                  rc;
+
+    if ((rc = strcmp (a->v, b->v)) || (rc = strcmp (a->m, b->m)))
+        return (rc);
+    if (a->mc != b->mc)
+        return ((a->mc < b->mc) ? -1 : 1);
+    if (a->row != b->row)
+        return ((a->row < b->row) ? -1 : 1);
+    if (a->channel != b->channel)
+        return ((a->channel < b->channel) ? -1 : 1);
+    return ((a->seq < b->seq) ? -1 : (a->seq > b->seq));
+}
+
+static int
+same_key (const struct assign *a, const struct assign *b)
+{
+    return (  (a->mc == b->mc) && (a->row == b->row) 
+           && (a->channel == b->channel)
+           && !strcmp (a->v, b->v) && !strcmp (a->m, b->m));
+}
+
+static int
+source_filter (const struct dirent *d)
+{
+    return (d->d_name[0] != '.');
+}
+
+/*  Return the sources of a database compiled from `db' and `dir': the
+ *   two of them, then the files in `dir' in name order.
+ */
+static char **
+sources_list (const char *db, const char *dir, unsigned int *np)
+{
+    struct dirent **names = NULL;
+    char **         paths;
+    int             n;
+    int             i;
+
+    if ((n = scandir (dir, &names, source_filter, alphasort)) < 0)
+        n = 0;
+
+    if (!(paths = calloc (n + 2, sizeof (*paths))))
+        goto out;
+
+    paths[0] = strdup (db);
+    paths[1] = strdup (dir);
+    for (i = 0; i < n; i++) {
+        paths[i + 2] = malloc (strlen (dir) + strlen (names[i]->d_name) + 2);
+        if (paths[i + 2])
+            sprintf (paths[i + 2], "%s/%s", dir, names[i]->d_name);
+    }
+
+    for (i = 0; (i < n + 2) && paths[i]; i++)
+        ;
+
+    /*  Out of memory: free (NULL) is harmless for the missing entries
+     */
+    if (i < n + 2) {
+        for (i = 0; i < n + 2; i++)
+            free (paths[i]);
+        free (paths);
+        paths = NULL;
+        goto out;
+    }
+
+    *np = n + 2;
+
+out:
+    for (i = 0; i < n; i++)
+        free (names[i]);
+    free (names);
+    return (paths);
+}
+
+static void
+sources_free (char **paths, unsigned int n)
+{
+    unsigned int i;
+
+    for (i = 0; i < n; i++)
+        free (paths[i]);
+    free (paths);
+}
+
+static void
+source_stat (const char *path, struct labeldb_source *src)
+{
+    struct stat st;
+
+    if (stat (path, &st) < 0) {
+        src->mtime =      -1;
+        src->mtime_nsec = 0;
+        src->size =       0;
+        return;
+    }
+
+    src->mtime =      st.st_mtim.tv_sec;
+    src->mtime_nsec = st.st_mtim.tv_nsec;
+    src->size =       st.st_size;
+}
+
+/*  Compile the label database in `db' and `dir' into `out'
+ */
+static int
+labeldb_build (const char *db, const char *dir, struct lbuf *out)
+{
+    struct compiler        c;
+    struct labeldb_header  h;
+    struct labeldb_source  src;
+    struct labeldb_bucket *buckets = NULL;
+    char **                paths;
+    unsigned int           npaths;
+    uint32_t               nboards = 0;
+    uint32_t               mask;
+    long                   off;
+    size_t                 i;
+    size_t                 j;
+    size_t                 n;
+    int                    rc = -1;
+
+    memset (&c, 0, sizeof (c));
+    memset (&h, 0, sizeof (h));
+
+    if (!(paths = sources_list (db, dir, &npaths)))
+        return (-1);
+
+    /*  Stat sources before reading them, so a file changed while it
+     *   is read makes the result stale rather than silently wrong.
+     */
+    if (lbuf_reserve (out, sizeof (h) + npaths * sizeof (src)) < 0)
+        goto out;
+    out->len = sizeof (h);
+    h.off_sources = out->len;
+    h.nsources = npaths;
+    for (i = 0; i < npaths; i++) {
+        memset (&src, 0, sizeof (src));
+        source_stat (paths[i], &src);
+        if ((off = lbuf_add_string (&c.strings, paths[i], strlen (paths[i]),
+                                    0)) < 0)
+            goto out;
+        src.path = off;
+        lbuf_add (out, &src, sizeof (src));
+    }
+
+    for (i = 0; i < npaths; i++) {
+        struct stat st;
+        if (  (i == 1) || (stat (paths[i], &st) < 0) 
+           || !S_ISREG (st.st_mode))
+            continue;
+        if (  (compiler_read (&c, paths[i]) < 0) 
+           && ((errno == ENOMEM) || (i == 0)))
+            goto out;
+    }
+
+    for (i = 0; i < c.nassigns; i++) {
+        c.assigns[i].v = c.strings.data + c.assigns[i].vendor;
+        c.assigns[i].m = c.strings.data + c.assigns[i].model;
+    }
+    qsort (c.assigns, c.nassigns, sizeof (*c.assigns), assign_cmp);
+
+    /*  Keep only the last assignment of each location
+     */
+    for (i = 0, n = 0; i < c.nassigns; i++) {
+        if ((i + 1 < c.nassigns) && same_key (&c.assigns[i], &c.assigns[i+1]))
+            continue;
+        c.assigns[n++] = c.assigns[i];
+    }
+    c.nassigns = n;
+
+    for (i = 0; i < n; i++) {
+        if ((i == 0) || strcmp (c.assigns[i].v, c.assigns[i-1].v)
+           || strcmp (c.assigns[i].m, c.assigns[i-1].m))
+            h.nboards++;
+    }
+
+    for (h.nbuckets = 8; h.nbuckets < 2 * h.nboards; h.nbuckets *= 2)
+        ;
+    if (!(buckets = calloc (h.nbuckets, sizeof (*buckets))))
+        goto out;
+    mask = h.nbuckets - 1;
+
+    h.off_boards = out->len;
+    for (i = 0, j = 0; i < n; i = j) {
+        struct labeldb_board b;
+        uint32_t             hash;
+        uint32_t             k;
+
+        for (j = i + 1; j < n; j++) {
+            if (  strcmp (c.assigns[j].v, c.assigns[i].v)
+               || strcmp (c.assigns[j].m, c.assigns[i].m))
+                break;
+        }
+
+        b.vendor =   c.assigns[i].vendor;
+        b.model =    c.assigns[i].model;
+        b.first =    i;
+        b.nentries = j - i;
+
+        /*  Linear probing. The table is at most half full.
+         */
+        hash = labeldb_hash (c.assigns[i].v, c.assigns[i].m);
+        for (k = hash & mask; buckets[k].board; k = (k + 1) & mask)
+            ;
+        buckets[k].hash =  hash;
+        buckets[k].board = ++nboards;
+
+        if (lbuf_add (out, &b, sizeof (b)) < 0)
+            goto out;
+    }
+
+    h.off_buckets = out->len;
+    if (lbuf_add (out, buckets, h.nbuckets * sizeof (*buckets)) < 0)
+        goto out;
+
+    h.off_entries = out->len;
+    h.nentries = n;
+    for (i = 0; i < n; i++) {
+        struct labeldb_entry e;
+        e.mc =      c.assigns[i].mc;
+        e.row =     c.assigns[i].row;
+        e.channel = c.assigns[i].channel;
+        e.label =   c.assigns[i].label;
+        if (lbuf_add (out, &e, sizeof (e)) < 0)
+            goto out;
+    }
+
+    h.off_strings = out->len;
+    h.nstrings = c.strings.len;
+    if (lbuf_add (out, c.strings.data, c.strings.len) < 0)
+        goto out;
+
+    if (out->len > UINT32_MAX) {
+        errno = EFBIG;
+        goto out;
+    }
+
+    h.magic =   LABELDB_MAGIC;
+    h.version = LABELDB_VERSION;
+    h.size =    out->len;
+    memcpy (out->data, &h, sizeof (h));
+
+    rc = 0;
+
+out:
+    free (buckets);
+    free (c.assigns);
+    free (c.strings.data);
+    sources_free (paths, npaths);
+    return (rc);
+}
+
+/*  Return 1 if the `len' bytes at `base' are a compiled database with
+ *   all of its tables inside them.
+ */
+static int
+labeldb_valid (const void *base, size_t len)
+{
+    const struct labeldb_header *h = base;
+
+    if (  (len < sizeof (*h))
+       || (h->magic != LABELDB_MAGIC)
+       || (h->version != LABELDB_VERSION)
+       || (h->size != len)
+       || (h->nbuckets == 0) 
+       || (h->nbuckets & (h->nbuckets - 1))
+       || (h->nboards >= h->nbuckets))
+        return (0);
+
+    if (  ((uint64_t) h->off_sources 
+           + (uint64_t) h->nsources * sizeof (struct labeldb_source) > len)
+       || ((uint64_t) h->off_buckets 
+           + (uint64_t) h->nbuckets * sizeof (struct labeldb_bucket) > len)
+       || ((uint64_t) h->off_boards 
+           + (uint64_t) h->nboards * sizeof (struct labeldb_board) > len)
+       || ((uint64_t) h->off_entries 
+           + (uint64_t) h->nentries * sizeof (struct labeldb_entry) > len)
+       || ((uint64_t) h->off_strings + h->nstrings != len)
+       || (h->nstrings == 0)
+       || (((const char *) base)[len - 1] != '\0'))
+        return (0);
+
+    return (1);
+}
+
+static const char *
+labeldb_string (const void *base, uint32_t off)
+{
+    const struct labeldb_header *h = base;
+
+    if (off >= h->nstrings)
+        return ("");
+
+    return ((const char *) base + h->off_strings + off);
+}
+
+/*  Return 1 if database `base' was not compiled from `db' and `dir' as
+ *   they are now.
+ */
+static int
+labeldb_stale (const void *base, const char *db, const char *dir)
+{
+    const struct labeldb_header *h = base;
+    const struct labeldb_source *src;
+    struct labeldb_source        now;
+    uint32_t                     i;
+
+    src = (const void *) ((const char *) base + h->off_sources);
+
+    if (  (h->nsources < 2)
+       || strcmp (labeldb_string (base, src[0].path), db)
+       || strcmp (labeldb_string (base, src[1].path), dir))
+        return (1);
+
+    /*  A file added to or removed from `dir' changes its mtime
+     */
+    for (i = 0; i < h->nsources; i++) {
+        source_stat (labeldb_string (base, src[i].path), &now);
+        if (  (now.mtime != src[i].mtime)
+           || (now.mtime_nsec != src[i].mtime_nsec)
+           || (now.size != src[i].size))
+            return (1);
+    }
+
+    return (0);
+}
+
+static int
+labeldb_map (struct edac_labeldb *ldb, const char *path)
+{
+    struct stat st;
+    void *      p;
+    int         fd;
+
+    if ((fd = open (path, O_RDONLY | O_CLOEXEC)) < 0)
+        return (-1);
+
+    if (  (fstat (fd, &st) < 0)
+       || (st.st_size < (off_t) sizeof (struct labeldb_header))
+       || ((p = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0))
+           == MAP_FAILED)) {
+        close (fd);
+        return (-1);
+    }
+    close (fd);
+
+    if (!labeldb_valid (p, st.st_size)) {
+        munmap (p, st.st_size);
+        return (-1);
+    }
+
+    ldb->base =   p;
+    ldb->len =    st.st_size;
+    ldb->mapped = 1;
+
+    return (0);
+}
+
+/*  Atomically replace `path' with the compiled database in `b',
+ *   creating its directory if needed.
+ */
+static int
+labeldb_write (const char *path, const struct lbuf *b)
+{
+    char *  tmp;
+    char *  p;
+    size_t  n;
+    ssize_t rc;
+    int     fd;
+
+    if (!(tmp = malloc (strlen (path) + 8)))
+        return (-1);
+
+    sprintf (tmp, "%s.XXXXXX", path);
+    if (((fd = mkstemp (tmp)) < 0) && (errno == ENOENT)) {
+        if ((p = strrchr (tmp, '/')) && (p != tmp)) {
+            *p = '\0';
+            mkdir (tmp, 0755);
+            *p = '/';
+        }
+        sprintf (tmp, "%s.XXXXXX", path);
+        fd = mkstemp (tmp);
+    }
+    if (fd < 0) {
+        free (tmp);
+        return (-1);
+    }
+
+    for (n = 0; n < b->len; n += rc) {
+        if ((rc = write (fd, b->data + n, b->len - n)) < 0) {
+            if (errno == EINTR) {
+                rc = 0;
+                continue;
+            }
+            break;
+        }
+    }
+
+    if (  (n < b->len) 
+       || (fchmod (fd, 0644) < 0)
+       || (close (fd) < 0)
+       || (rename (tmp, path) < 0)) {
+        int saved_errno = errno;
+        if (n < b->len)
+            close (fd);
+        unlink (tmp);
+        free (tmp);
+        errno = saved_errno;
+        return (-1);
+    }
+
+    free (tmp);
+    return (0);
+}
+
+/*  The compiled database used by default only caches the default
+ *   sources.
+ */
+static const char *
+labeldb_cache (const char *db, const char *dir, const char *cache)
+{
+    if (cache)
+        return (cache);
+    if (strcmp (db, LABELDB_FILE) || strcmp (dir, LABELDB_DIR))
+        return (NULL);
+    return (LABELDB_CACHE);
+}
+
+
+/*****************************************************************************
+ *  Functions
+ *****************************************************************************/
+
+edac_labeldb * edac_labeldb_open (const char *db, const char *dir, 
+        const char *cache)
+{
+    struct edac_labeldb *ldb;
+    struct lbuf          b;
+
+    db =    db ? db : LABELDB_FILE;
+    dir =   dir ? dir : LABELDB_DIR;
+    cache = labeldb_cache (db, dir, cache);
+
+    if (!(ldb = calloc (1, sizeof (*ldb))))
+        return (NULL);
+
+    if (cache && (labeldb_map (ldb, cache) == 0)) {
+        if (!labeldb_stale (ldb->base, db, dir))
+            return (ldb);
+        munmap (ldb->base, ldb->len);
+    }
+
+    memset (&b, 0, sizeof (b));
+    if (labeldb_build (db, dir, &b) < 0) {
+        free (b.data);
+        free (ldb);
+        return (NULL);
+    }
+
+    /*  Without a writable cache, use the database compiled in memory
+     */
+    if (cache)
+        labeldb_write (cache, &b);
+
+    ldb->base =   b.data;
+    ldb->len =    b.len;
+    ldb->mapped = 0;
+
+    return (ldb);
+}
+
+int edac_labeldb_compile (const char *db, const char *dir, const char *cache)
+{
+    struct lbuf b;
+    int         rc;
+
+    db =    db ? db : LABELDB_FILE;
+    dir =   dir ? dir : LABELDB_DIR;
+
+    if (!(cache = labeldb_cache (db, dir, cache))) {
+        errno = EINVAL;
+        return (-1);
+    }
+
+    memset (&b, 0, sizeof (b));
+    if ((rc = labeldb_build (db, dir, &b)) == 0)
+        rc = labeldb_write (cache, &b);
+    free (b.data);
+
+    return (rc);
+}
+
+void edac_labeldb_close (edac_labeldb *ldb)
+{
+    if (ldb == NULL)
+        return;
+
+    if (ldb->mapped)
+        munmap (ldb->base, ldb->len);
+    else
+        free (ldb->base);
+    free (ldb);
+}
+
+int edac_labeldb_lookup (edac_labeldb *ldb, const char *vendor, 
+        const char *model, struct edac_label *labels, int len)
+{
+    const struct labeldb_header *h;
+    const struct labeldb_bucket *buckets;
+    const struct labeldb_board * b;
+    const struct labeldb_entry * e;
+    char *                       v = NULL;
+    char *                       m = NULL;
+    const char *                 p;
+    uint32_t                     hash;
+    uint32_t                     k;
+    uint32_t                     i;
+    size_t                       n;
+    int                          rc = -1;
+
+    if (!ldb || !vendor || !model) {
+        errno = EINVAL;
+        return (-1);
+    }
+
+    h = ldb->base;
+    buckets = (const void *) ((const char *) ldb->base + h->off_buckets);
+
+    /*  Vendor and model are matched without case or surrounding space
+     */
+    p = trim (vendor, vendor + strlen (vendor), &n);
+    v = strndup (p, n);
+    p = trim (model, model + strlen (model), &n);
+    m = strndup (p, n);
+    if (!v || !m) 
+        goto out;
+
+    hash = labeldb_hash (v, m);
+    errno = ENOENT;
+
+    for (k = hash & (h->nbuckets - 1); buckets[k].board; 
+         k = (k + 1) & (h->nbuckets - 1)) {
+        if ((buckets[k].hash != hash) || (buckets[k].board > h->nboards))
+            continue;
+
+        b = (const void *) ((const char *) ldb->base + h->off_boards);
+        b += buckets[k].board - 1;
+
+        if (  strcasecmp (labeldb_string (ldb->base, b->vendor), v)
+           || strcasecmp (labeldb_string (ldb->base, b->model), m))
+            continue;
+
+        if ((uint64_t) b->first + b->nentries > h->nentries) {
+            errno = EINVAL;
+            break;
+        }
+
+        e = (const void *) ((const char *) ldb->base + h->off_entries);
+        e += b->first;
+
+        for (i = 0; labels && (i < b->nentries) && ((int) i < len); i++) {
+            labels[i].mc =      e[i].mc;
+            labels[i].row =     e[i].row;
+            labels[i].channel = e[i].channel;
+            labels[i].label =   labeldb_string (ldb->base, e[i].label);
+        }
+
+        rc = b->nentries;
+        break;
+    }
+
+out:
+    free (v);
+    free (m);
+    return (rc);
+}
+
+/* vi: ts=4 sw=4 expandtab
+ */
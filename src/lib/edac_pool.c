@@ -0,0 +1,203 @@
+/*****************************************************************************
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2005-2007 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  Written by Mark Grondona <mgrondona@llnl.gov>
+ *  UCRL-CODE-230739.
+ *
+ *  This file is part of edac-utils.
+ *
+ *  This is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *****************************************************************************/
+
+/*
+ *  Worker pool for parallel MC scanning and counter sampling.
+ *
+ *  Each edac_pool_run () is one round: the caller publishes the job
+ *   function and wakes all workers, then every thread (caller
+ *   included) claims job numbers from a shared counter until none
+ *   are left. The round ends when every worker has joined it and
+ *   finished, so a slow-to-wake worker can never run jobs of a later
+ *   round with stale arguments.
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "edac_pool.h"
+
+/*****************************************************************************
+ *  Data Types
+ *****************************************************************************/
+
+struct edac_pool {
+    pthread_mutex_t        lock;
+    pthread_cond_t         start;           /* signalled for a new round     */
+    pthread_cond_t         done;            /* signalled as workers finish   */
+    pthread_t *            threads;         /* [nthreads] workers            */
+    unsigned int           nthreads;        /* number of workers             */
+    unsigned int           round;           /* current round number          */
+    unsigned int           joined;          /* workers which joined round    */
+    unsigned int           active;          /* workers still running jobs    */
+    int                    shutdown;        /* set by edac_pool_destroy ()   */
+    edac_pool_f            f;               /* job function for this round   */
+    void *                 arg;             /* argument to f                 */
+    unsigned int           njobs;           /* number of jobs in round       */
+    unsigned int           next;            /* next unclaimed job            */
+};
+
+
+/*****************************************************************************
+ *  Private Functions
+ *****************************************************************************/
+
+static void
+pool_run_jobs (edac_pool *p)
+{
+    unsigned int job;
+
+    while ((job = __sync_fetch_and_add (&p->next, 1)) < p->njobs)
+        (*p->f) (p->arg, job);
+}
+
+static void *
+pool_worker (void *arg)
+{
+    edac_pool *  p = arg;
+    unsigned int seen = 0;
+
+    pthread_mutex_lock (&p->lock);
+    for (;;) {
+        while (!p->shutdown && (p->round == seen))
+            pthread_cond_wait (&p->start, &p->lock);
+        if (p->shutdown)
+            break;
+
+        seen = p->round;
+        p->joined++;
+        p->active++;
+        pthread_mutex_unlock (&p->lock);
+
+        pool_run_jobs (p);
+
+        pthread_mutex_lock (&p->lock);
+        p->active--;
+        pthread_cond_signal (&p->done);
+    }
+    pthread_mutex_unlock (&p->lock);
+
+    return (NULL);
+}
+
+
+/*****************************************************************************
+ *  Functions
+ *****************************************************************************/
+
+edac_pool * edac_pool_create (unsigned int nthreads)
+{
+    edac_pool *  p;
+    unsigned int i;
+
+    if (nthreads < 2)
+        return (NULL);
+
+    if (!(p = malloc (sizeof (*p))))
+        return (NULL);
+
+    memset (p, 0, sizeof (*p));
+
+    if (!(p->threads = malloc ((nthreads - 1) * sizeof (pthread_t)))) {
+        free (p);
+        return (NULL);
+    }
+
+    pthread_mutex_init (&p->lock, NULL);
+    pthread_cond_init (&p->start, NULL);
+    pthread_cond_init (&p->done, NULL);
+
+    for (i = 0; i < nthreads - 1; i++) {
+        if (pthread_create (&p->threads[i], NULL, pool_worker, p) != 0)
+            break;
+        p->nthreads++;
+    }
+
+    if (p->nthreads == 0) {
+        edac_pool_destroy (p);
+        return (NULL);
+    }
+
+    return (p);
+}
+
+void edac_pool_destroy (edac_pool *p)
+{
+    unsigned int i;
+
+    if (p == NULL)
+        return;
+
+    pthread_mutex_lock (&p->lock);
+    p->shutdown = 1;
+    pthread_cond_broadcast (&p->start);
+    pthread_mutex_unlock (&p->lock);
+
+    for (i = 0; i < p->nthreads; i++)
+        pthread_join (p->threads[i], NULL);
+
+    pthread_cond_destroy (&p->done);
+    pthread_cond_destroy (&p->start);
+    pthread_mutex_destroy (&p->lock);
+    free (p->threads);
+    free (p);
+}
+
+void edac_pool_run (edac_pool *p, edac_pool_f f, void *arg,
+        unsigned int njobs)
+{
+    unsigned int i;
+
+    if ((p == NULL) || (njobs < 2)) {
+        for (i = 0; i < njobs; i++)
+            (*f) (arg, i);
+        return;
+    }
+
+    pthread_mutex_lock (&p->lock);
+    p->f =      f;
+    p->arg =    arg;
+    p->njobs =  njobs;
+    p->next =   0;
+    p->joined = 0;
+    p->round++;
+    pthread_cond_broadcast (&p->start);
+    pthread_mutex_unlock (&p->lock);
+
+    pool_run_jobs (p);
+
+    pthread_mutex_lock (&p->lock);
+    while ((p->joined < p->nthreads) || (p->active > 0))
+        pthread_cond_wait (&p->done, &p->lock);
+    pthread_mutex_unlock (&p->lock);
+}
+
+/* vi: ts=4 sw=4 expandtab
+ */
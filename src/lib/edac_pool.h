@@ -0,0 +1,66 @@
+/*****************************************************************************
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2005-2007 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  Written by Mark Grondona <mgrondona@llnl.gov>
+ *  UCRL-CODE-230739.
+ *
+ *  This file is part of edac-utils.
+ *
+ *  This is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *****************************************************************************/
+
+/*
+ *  Private worker pool for libedac.
+ *
+ *  A pool runs numbered jobs 0..njobs-1 of one function across a few
+ *   persistent threads and the calling thread, and returns once all
+ *   jobs are done. Jobs must only write to their own slots of the
+ *   caller's data. A NULL pool runs all jobs in the calling thread.
+ */
+
+#ifndef _EDAC_POOL_H
+#define _EDAC_POOL_H
+
+typedef struct edac_pool edac_pool;
+
+/*  Job function, called once for each job number.
+ */
+typedef void (*edac_pool_f) (void *arg, unsigned int job);
+
+/*
+ *  Start a pool running jobs on `nthreads' threads in total, including
+ *   the caller. Returns NULL if `nthreads' is less than 2 or threads
+ *   could not be started.
+ */
+edac_pool * edac_pool_create (unsigned int nthreads);
+
+/*
+ *  Stop and free pool `p'.
+ */
+void edac_pool_destroy (edac_pool *p);
+
+/*
+ *  Run `f (arg, job)' for each job in 0..njobs-1 and wait for all of
+ *   them. Only one thread may call this on a given pool at a time.
+ */
+void edac_pool_run (edac_pool *p, edac_pool_f f, void *arg,
+        unsigned int njobs);
+
+#endif /* !_EDAC_POOL_H */
+
+/* vi: ts=4 sw=4 expandtab
+ */
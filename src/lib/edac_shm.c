@@ -0,0 +1,347 @@
+/*****************************************************************************
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2005-2007 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  Written by Mark Grondona <mgrondona@llnl.gov>
+ *  UCRL-CODE-230739.
+ *
+ *  This file is part of edac-utils.
+ *
+ *  This is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *****************************************************************************/
+
+/*
+ *  Shared-memory counter segment: POSIX shm_open(3) mapping and the
+ *   sequence lock protecting it.
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "edac_shm.h"
+
+/*****************************************************************************
+ *  Data Types
+ *****************************************************************************/
+
+struct edac_shm {
+    int                    fd;              /* shm_open () fd                */
+    void *                 base;            /* mapping of segment            */
+    size_t                 len;             /* length of mapping             */
+    int                    owner;           /* 1 for the publisher           */
+    char                   name[256];       /* segment name                  */
+};
+
+
+/*****************************************************************************
+ *  Private Functions
+ *****************************************************************************/
+
+static int
+shm_map (edac_shm *s, size_t len)
+{
+    int   prot = s->owner ? (PROT_READ | PROT_WRITE) : PROT_READ;
+    void *p;
+
+    if ((p = mmap (NULL, len, prot, MAP_SHARED, s->fd, 0)) == MAP_FAILED)
+        return (-1);
+
+    if (s->base)
+        munmap (s->base, s->len);
+
+    s->base = p;
+    s->len = len;
+
+    return (0);
+}
+
+/*  Return 1 if segment `fd' may be trusted: it was created by root or
+ *   by us, so no other user can feed us counters.
+ */
+static int
+shm_trusted (int fd, struct stat *st)
+{
+    if (fstat (fd, st) < 0)
+        return (0);
+
+    if ((st->st_uid != 0) && (st->st_uid != geteuid ())) {
+        errno = EPERM;
+        return (0);
+    }
+
+    return (1);
+}
+
+static edac_shm *
+shm_open_segment (const char *name, int flags)
+{
+    edac_shm *s;
+
+    if (strlen (name) >= sizeof (s->name)) {
+        errno = ENAMETOOLONG;
+        return (NULL);
+    }
+
+    if (!(s = malloc (sizeof (*s))))
+        return (NULL);
+
+    memset (s, 0, sizeof (*s));
+    strcpy (s->name, name);
+
+    if ((s->fd = shm_open (name, flags | O_CLOEXEC, 0644)) < 0) {
+        free (s);
+        return (NULL);
+    }
+
+    return (s);
+}
+
+/*  Return 1 if process `pid' exists.
+ */
+static int
+pid_alive (pid_t pid)
+{
+    return ((pid > 0) && ((kill (pid, 0) == 0) || (errno == EPERM)));
+}
+
+/*  Check for a live publisher on existing segment `name'. Returns <0
+ *   with errno EBUSY if there is one, or EPERM if the segment belongs to
+ *   another user. Otherwise sets `*generation' to the generation the
+ *   segment had, if any, and returns 0.
+ */
+static int
+shm_check_existing (const char *name, uint32_t *generation)
+{
+    struct edac_shm_header h;
+    struct stat            st;
+    int                    fd;
+    int                    rc = 0;
+
+    *generation = 0;
+
+    if ((fd = shm_open (name, O_RDONLY | O_CLOEXEC, 0)) < 0)
+        return ((errno == ENOENT) ? 0 : -1);
+
+    if (!shm_trusted (fd, &st))
+        rc = -1;
+    else if (  (st.st_size >= (off_t) sizeof (h))
+            && (pread (fd, &h, sizeof (h), 0) == (ssize_t) sizeof (h))
+            && (h.magic == EDAC_SHM_MAGIC)) {
+        if ((h.pid != getpid ()) && pid_alive (h.pid)) {
+            errno = EBUSY;
+            rc = -1;
+        }
+        *generation = h.generation;
+    }
+
+    close (fd);
+    return (rc);
+}
+
+
+/*****************************************************************************
+ *  Functions
+ *****************************************************************************/
+
+edac_shm * edac_shm_create (const char *name)
+{
+    struct edac_shm_header *h;
+    edac_shm *              s;
+    uint32_t                generation;
+
+    if (shm_check_existing (name, &generation) < 0)
+        return (NULL);
+
+    /*  Always start a new segment. An existing one was left by a
+     *   publisher which died, and readers still mapping it see that
+     *   and reload, so it is never reused. O_EXCL makes sure nobody
+     *   else created the name in between.
+     */
+    if ((shm_unlink (name) < 0) && (errno != ENOENT))
+        return (NULL);
+
+    if (!(s = shm_open_segment (name, O_RDWR | O_CREAT | O_EXCL)))
+        return (NULL);
+
+    s->owner = 1;
+
+    if (  (ftruncate (s->fd, sizeof (*h)) < 0)
+       || (shm_map (s, sizeof (*h)) < 0))
+        goto fail;
+
+    /*  Generations keep counting up from the last publisher's, so a
+     *   layout is never mistaken for one loaded from an older segment.
+     */
+    h = s->base;
+    h->magic =      EDAC_SHM_MAGIC;
+    h->version =    EDAC_SHM_VERSION;
+    h->generation = generation;
+    h->pid =        getpid ();
+    h->size =       sizeof (*h);
+
+    return (s);
+
+fail:
+    if (s->base)
+        munmap (s->base, s->len);
+    close (s->fd);
+    shm_unlink (name);
+    free (s);
+    return (NULL);
+}
+
+edac_shm * edac_shm_attach (const char *name)
+{
+    struct edac_shm_header *h;
+    struct stat             st;
+    edac_shm *              s;
+
+    if (!(s = shm_open_segment (name, O_RDONLY)))
+        return (NULL);
+
+    if (  !shm_trusted (s->fd, &st)
+       || (st.st_size < (off_t) sizeof (*h))
+       || (shm_map (s, st.st_size) < 0))
+        goto fail;
+
+    h = s->base;
+
+    if (  (h->magic != EDAC_SHM_MAGIC)
+       || (h->version != EDAC_SHM_VERSION)
+       || !pid_alive (h->pid))
+        goto fail;
+
+    return (s);
+
+fail:
+    if (s->base)
+        munmap (s->base, s->len);
+    close (s->fd);
+    free (s);
+    return (NULL);
+}
+
+void edac_shm_destroy (edac_shm *s)
+{
+    if (s == NULL)
+        return;
+
+    if (s->owner) {
+        struct edac_shm_header *h = s->base;
+        edac_shm_write_begin (h);
+        h->pid = 0;
+        edac_shm_write_end (h);
+        shm_unlink (s->name);
+    }
+
+    munmap (s->base, s->len);
+    close (s->fd);
+    free (s);
+}
+
+int edac_shm_publisher_alive (const struct edac_shm_header *h)
+{
+    time_t now = time (NULL);
+
+    if (h->pid == 0)
+        return (0);
+
+    /*  Only ask the kernel once the publisher has gone quiet, so a
+     *   reader of a live publisher makes no system calls.
+     */
+    if ((now >= h->updated) && (now - h->updated < EDAC_SHM_STALE_SECS))
+        return (1);
+
+    return (pid_alive (h->pid));
+}
+
+struct edac_shm_header * edac_shm_header (edac_shm *s)
+{
+    return (s->base);
+}
+
+size_t edac_shm_length (edac_shm *s)
+{
+    return (s->len);
+}
+
+int edac_shm_reserve (edac_shm *s, size_t size)
+{
+    long   pagesize = sysconf (_SC_PAGESIZE);
+    size_t len;
+
+    if (size <= s->len)
+        return (0);
+
+    len = (size + pagesize - 1) / pagesize * pagesize;
+
+    if (ftruncate (s->fd, len) < 0)
+        return (-1);
+
+    return (shm_map (s, len));
+}
+
+int edac_shm_remap (edac_shm *s)
+{
+    struct stat st;
+
+    if (fstat (s->fd, &st) < 0)
+        return (-1);
+
+    if ((size_t) st.st_size <= s->len)
+        return (0);
+
+    return (shm_map (s, st.st_size));
+}
+
+void edac_shm_write_begin (struct edac_shm_header *h)
+{
+    h->seq++;
+    __sync_synchronize ();
+}
+
+void edac_shm_write_end (struct edac_shm_header *h)
+{
+    __sync_synchronize ();
+    h->seq++;
+}
+
+uint32_t edac_shm_read_begin (const struct edac_shm_header *h)
+{
+    uint32_t seq = h->seq;
+    __sync_synchronize ();
+    return (seq);
+}
+
+int edac_shm_read_retry (const struct edac_shm_header *h, uint32_t seq)
+{
+    __sync_synchronize ();
+    return ((seq & 1) || (h->seq != seq));
+}
+
+/* vi: ts=4 sw=4 expandtab
+ */
@@ -0,0 +1,148 @@
+/*****************************************************************************
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2005-2007 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  Written by Mark Grondona <mgrondona@llnl.gov>
+ *  UCRL-CODE-230739.
+ *
+ *  This file is part of edac-utils.
+ *
+ *  This is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *****************************************************************************/
+
+/*
+ *  Private interface to the shared-memory counter segment.
+ *
+ *  One publisher maps the segment read-write and any number of readers
+ *   map it read-only. The segment starts with a header protected by a
+ *   sequence lock: the publisher makes `seq' odd while it writes and
+ *   even again when done, and a reader retries any copy during which
+ *   `seq' was odd or changed. Records following the header are laid
+ *   out by libedac and located through offsets in the header.
+ *
+ *  The segment only grows, so a reader's mapping always stays valid
+ *   for the layout it last loaded.
+ */
+
+#ifndef _EDAC_SHM_H
+#define _EDAC_SHM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "edac.h"
+
+#define EDAC_SHM_MAGIC    0x45444143        /* "EDAC"                        */
+#define EDAC_SHM_VERSION  1
+
+/*  Seconds without a new sample after which a reader checks that the
+ *   publisher is still running
+ */
+#define EDAC_SHM_STALE_SECS 2
+
+struct edac_shm_header {
+    uint32_t               magic;           /* EDAC_SHM_MAGIC                */
+    uint32_t               version;         /* EDAC_SHM_VERSION              */
+    volatile uint32_t      seq;             /* odd while being written       */
+    uint32_t               generation;      /* bumped on layout change       */
+    int32_t                pid;             /* publisher, 0 once it exits    */
+    uint32_t               pad;
+    uint64_t               size;            /* bytes in use, incl. header    */
+    int64_t                updated;         /* time of last sample           */
+    char                   root[1024];      /* EDAC sysfs root published     */
+    uint32_t               nmcs;
+    uint32_t               ncsrows;
+    uint32_t               nchannels;
+    uint32_t               ndimms;
+    uint32_t               nvalues;
+    uint32_t               pad2;
+    uint64_t               off_mcs;         /* offsets from segment start    */
+    uint64_t               off_csrows;
+    uint64_t               off_channels;
+    uint64_t               off_dimms;
+    uint64_t               off_values;
+    struct edac_totals     totals;          /* totals for values             */
+};
+
+typedef struct edac_shm edac_shm;
+
+/*
+ *  Create segment `name' for publishing, replacing any segment left
+ *   by a publisher which exited. Fails with EBUSY if another live
+ *   process is publishing to it, or EPERM if it belongs to another
+ *   user.
+ */
+edac_shm * edac_shm_create (const char *name);
+
+/*
+ *  Map existing segment `name' read-only. Returns NULL if there is no
+ *   segment, it is owned by a user other than root or us, or it was
+ *   not written by a compatible publisher.
+ */
+edac_shm * edac_shm_attach (const char *name);
+
+/*
+ *  Unmap segment `s'. If `s' was created with edac_shm_create (), mark
+ *   it unpublished and remove the name.
+ */
+void edac_shm_destroy (edac_shm *s);
+
+/*
+ *  Return 1 if the publisher of header `h' is still running. Checks
+ *   with kill(2) only when `updated' is more than EDAC_SHM_STALE_SECS
+ *   old.
+ */
+int edac_shm_publisher_alive (const struct edac_shm_header *h);
+
+/*
+ *  Return the header of segment `s'.
+ */
+struct edac_shm_header * edac_shm_header (edac_shm *s);
+
+/*
+ *  Return the number of bytes of `s' currently mapped.
+ */
+size_t edac_shm_length (edac_shm *s);
+
+/*
+ *  Publisher: grow segment `s' to at least `size' bytes. The header
+ *   pointer may change. Returns <0 on error.
+ */
+int edac_shm_reserve (edac_shm *s, size_t size);
+
+/*
+ *  Reader: extend the mapping of `s' to the current segment size.
+ *   Returns <0 on error.
+ */
+int edac_shm_remap (edac_shm *s);
+
+/*
+ *  Publisher side of the sequence lock.
+ */
+void edac_shm_write_begin (struct edac_shm_header *h);
+void edac_shm_write_end (struct edac_shm_header *h);
+
+/*
+ *  Reader side of the sequence lock. Copy data between read_begin ()
+ *   and read_retry (), and repeat the copy while read_retry () is true.
+ */
+uint32_t edac_shm_read_begin (const struct edac_shm_header *h);
+int edac_shm_read_retry (const struct edac_shm_header *h, uint32_t seq);
+
+#endif /* !_EDAC_SHM_H */
+
+/* vi: ts=4 sw=4 expandtab
+ */
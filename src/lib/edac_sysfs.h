@@ -0,0 +1,89 @@
+/*****************************************************************************
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2005-2007 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  Written by Mark Grondona <mgrondona@llnl.gov>
+ *  UCRL-CODE-230739.
+ *
+ *  This file is part of edac-utils.
+ *
+ *  This is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *****************************************************************************/
+
+/*
+ *  Private sysfs access interface for libedac.
+ *
+ *  Two implementations exist: a built-in scanner using openat(2) and
+ *   getdents64(2) (edac_sysfs_native.c), and a wrapper around libsysfs
+ *   (edac_sysfs_libsysfs.c). The backend is chosen at configure time
+ *   with --with-libsysfs.
+ */
+
+#ifndef _EDAC_SYSFS_H
+#define _EDAC_SYSFS_H
+
+/*  Opaque handle to a directory in sysfs.
+ */
+typedef struct edac_sysfs_dir edac_sysfs_dir;
+
+/*  Callback for edac_sysfs_dir_scan (). A negative return value
+ *   stops the scan, which then fails.
+ */
+typedef int (*edac_sysfs_dir_f) (edac_sysfs_dir *child, void *arg);
+
+/*
+ *  Open sysfs directory at `path'. Returns NULL on failure.
+ */
+edac_sysfs_dir * edac_sysfs_dir_open (const char *path);
+
+/*
+ *  Close directory `d' and all subdirectories found by
+ *   edac_sysfs_dir_scan () on it. Only directories returned by
+ *   edac_sysfs_dir_open () should be closed.
+ */
+void edac_sysfs_dir_close (edac_sysfs_dir *d);
+
+/*
+ *  Return the basename of directory `d' (e.g. "mc0" or "csrow3").
+ */
+const char * edac_sysfs_dir_name (edac_sysfs_dir *d);
+
+/*
+ *  Call `f' for each subdirectory of `d' whose name begins with
+ *   `prefix', in no particular order. Subdirectories remain valid until `d' is closed or
+ *   scanned again with the same prefix. Returns the number of
+ *   matching subdirectories, or <0 on error or if `f' failed.
+ */
+int edac_sysfs_dir_scan (edac_sysfs_dir *d, const char *prefix,
+        edac_sysfs_dir_f f, void *arg);
+
+/*
+ *  Read attribute `name' from `d' into `buf' of size `len'. The result
+ *   is always NUL terminated. Returns number of bytes read or <0 on error.
+ */
+int edac_sysfs_read_attr (edac_sysfs_dir *d, const char *name,
+        char *buf, int len);
+
+/*
+ *  Open attribute `name' of `d' read-only, for resampling with pread(2).
+ *   Returns a file descriptor or <0 on error.
+ */
+int edac_sysfs_open_attr (edac_sysfs_dir *d, const char *name);
+
+#endif /* !_EDAC_SYSFS_H */
+
+/* vi: ts=4 sw=4 expandtab
+ */
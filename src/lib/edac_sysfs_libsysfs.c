@@ -0,0 +1,217 @@
+/*****************************************************************************
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2005-2007 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  Written by Mark Grondona <mgrondona@llnl.gov>
+ *  UCRL-CODE-230739.
+ *
+ *  This file is part of edac-utils.
+ *
+ *  This is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *****************************************************************************/
+
+/*
+ *  libsysfs backend for libedac sysfs access (--with-libsysfs).
+ *
+ *  The whole device tree below the EDAC root is opened at once with
+ *   sysfs_open_device_tree(), and an edac_sysfs_dir is simply the
+ *   corresponding struct sysfs_device.
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sysfs/libsysfs.h>
+
+#include "edac_sysfs.h"
+
+#define sysfs_dev(__d) ((struct sysfs_device *) (__d))
+
+static struct sysfs_device * _sysfs_open_device_tree (const char *path);
+
+
+/*****************************************************************************
+ *  Functions
+ *****************************************************************************/
+
+edac_sysfs_dir * edac_sysfs_dir_open (const char *path)
+{
+    return ((edac_sysfs_dir *) _sysfs_open_device_tree (path));
+}
+
+void edac_sysfs_dir_close (edac_sysfs_dir *d)
+{
+    if (d != NULL)
+        sysfs_close_device_tree (sysfs_dev (d));
+}
+
+const char * edac_sysfs_dir_name (edac_sysfs_dir *d)
+{
+    return (sysfs_dev (d)->name);
+}
+
+int edac_sysfs_dir_scan (edac_sysfs_dir *d, const char *prefix,
+        edac_sysfs_dir_f f, void *arg)
+{
+    struct sysfs_device *dev = sysfs_dev (d);
+    struct sysfs_device *child;
+    size_t               plen = strlen (prefix);
+    int                  count = 0;
+
+    if (!dev->children)
+        return (0);
+
+    dlist_for_each_data (dev->children, child, struct sysfs_device) {
+        if (strncmp (child->name, prefix, plen) != 0)
+            continue;
+        count++;
+        if (f && ((*f) ((edac_sysfs_dir *) child, arg) < 0))
+            return (-1);
+    }
+
+    return (count);
+}
+
+int edac_sysfs_read_attr (edac_sysfs_dir *d, const char *name,
+        char *buf, int len)
+{
+    char                    path[SYSFS_PATH_MAX];
+    struct sysfs_attribute *attr;
+    int                     n;
+
+    n = snprintf (path, sizeof (path), "%s/%s", sysfs_dev (d)->path, name);
+    if ((n < 0) || (n >= sizeof (path)))
+        return (-1);
+
+    if (!(attr = sysfs_open_attribute (path)))
+        return (-1);
+
+    if (sysfs_read_attribute (attr) < 0) {
+        sysfs_close_attribute (attr);
+        return (-1);
+    }
+
+    memset (buf, '\0', len);
+    strncpy (buf, attr->value, len - 1);
+    n = strlen (buf);
+
+    sysfs_close_attribute (attr);
+
+    return (n);
+}
+
+int edac_sysfs_open_attr (edac_sysfs_dir *d, const char *name)
+{
+    char path[SYSFS_PATH_MAX];
+    int  fd;
+    int  n;
+
+    n = snprintf (path, sizeof (path), "%s/%s", sysfs_dev (d)->path, name);
+    if ((n < 0) || (n >= sizeof (path)))
+        return (-1);
+
+    if ((fd = open (path, O_RDONLY)) >= 0)
+        fcntl (fd, F_SETFD, FD_CLOEXEC);
+
+    return (fd);
+}
+
+
+/*****************************************************************************
+ *  Private Functions
+ *****************************************************************************/
+
+#if HAVE_SYSFS_OPEN_DEVICE_TREE
+
+static struct sysfs_device *
+_sysfs_open_device_tree (const char *path)
+{
+    return (sysfs_open_device_tree (path));
+}
+
+#else
+
+/*  libsysfs-2.0.0 did not implement sysfs_open_device_tree(). Replicate here.
+ */
+
+static void
+_null (void *x)
+{
+    return;
+}
+
+static void
+_dev_create_child_list (struct sysfs_device *dev)
+{
+    dev->children = dlist_new_with_delete (sizeof (struct sysfs_device), _null);
+}
+
+static struct sysfs_device * 
+_sysfs_open_device_tree (const char *path)
+{
+    struct sysfs_device * dev;
+    struct sysfs_device * child;
+    struct dlist *        dirs;
+    char *                subdir;
+
+    if (!(dev = sysfs_open_device_path (path)))
+        return (NULL);
+
+    if (!(dirs = sysfs_open_directory_list (path)))
+        return (dev);
+
+    dlist_for_each_data (dirs, subdir, char) {
+        int  n;
+        char fq_subdir [SYSFS_PATH_MAX + 1];
+
+        memset (fq_subdir, 0, sizeof (fq_subdir));
+
+        if (!sysfs_path_is_dir (subdir)) {
+            continue;
+        }
+
+        n = snprintf (fq_subdir, SYSFS_PATH_MAX, "%s/%s", path, subdir);
+
+        if ((n < 0) || (n > SYSFS_PATH_MAX)) {
+            continue;
+        }
+
+        if (!(child = _sysfs_open_device_tree (fq_subdir))) {
+            continue;
+        }
+
+        if (!dev->children) {
+            _dev_create_child_list (dev);
+        }
+
+        dlist_push (dev->children, child);
+    }
+
+    sysfs_close_list (dirs);
+
+    return (dev);
+}
+#endif /* HAVE_SYSFS_OPEN_DEVICE_TREE */
+
+
+/* vi: ts=4 sw=4 expandtab 
+ */
@@ -0,0 +1,266 @@
+/*****************************************************************************
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2005-2007 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  Written by Mark Grondona <mgrondona@llnl.gov>
+ *  UCRL-CODE-230739.
+ *
+ *  This file is part of edac-utils.
+ *
+ *  This is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *****************************************************************************/
+
+/*
+ *  Built-in sysfs scanner for libedac.
+ *
+ *  Each directory is held open as an O_DIRECTORY file descriptor, and
+ *   all lookups below it are relative (openat(2)). Subdirectories are
+ *   listed with getdents64(2) and only those matching the requested
+ *   prefix are opened, so unused parts of the EDAC tree (power/,
+ *   unrelated kobjects) are never visited.
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+
+#include "edac.h"
+#include "edac_sysfs.h"
+
+#ifndef O_DIRECTORY
+#  define O_DIRECTORY 0
+#endif
+#ifndef O_CLOEXEC
+#  define O_CLOEXEC   0
+#endif
+
+#ifndef DT_UNKNOWN
+#  define DT_UNKNOWN  0
+#  define DT_DIR      4
+#  define DT_LNK     10
+#endif
+
+/*****************************************************************************
+ *  Data Types
+ *****************************************************************************/
+
+/*  Kernel getdents64 record. Not all libcs export this, so define
+ *   it here and call the system call directly.
+ */
+struct edac_dirent64 {
+    uint64_t        d_ino;
+    int64_t         d_off;
+    unsigned short  d_reclen;
+    unsigned char   d_type;
+    char            d_name[];
+};
+
+struct edac_sysfs_dir {
+    int                     fd;             /* O_DIRECTORY fd for this dir   */
+    char                    name[EDAC_NAME_LEN];
+                                            /* Basename of directory         */
+    struct edac_sysfs_dir * children;       /* Subdirs opened by last scan   */
+    struct edac_sysfs_dir * next;           /* Next sibling                  */
+};
+
+
+/*****************************************************************************
+ *  Private Functions
+ *****************************************************************************/
+
+static struct edac_sysfs_dir *
+sysfs_dir_create (int fd, const char *name)
+{
+    struct edac_sysfs_dir *d;
+
+    if (!(d = malloc (sizeof (*d))))
+        return (NULL);
+
+    memset (d, 0, sizeof (*d));
+    d->fd = fd;
+    strncpy (d->name, name, sizeof (d->name) - 1);
+
+    return (d);
+}
+
+static void
+sysfs_dir_close_children (struct edac_sysfs_dir *d)
+{
+    struct edac_sysfs_dir *c = d->children;
+
+    while (c) {
+        struct edac_sysfs_dir *next = c->next;
+        edac_sysfs_dir_close (c);
+        c = next;
+    }
+    d->children = NULL;
+}
+
+/*  Close subdirectories of `d' left from an earlier scan for `prefix'.
+ */
+static void
+sysfs_dir_close_matching (struct edac_sysfs_dir *d, const char *prefix,
+        size_t plen)
+{
+    struct edac_sysfs_dir **cp = &d->children;
+
+    while (*cp) {
+        struct edac_sysfs_dir *c = *cp;
+        if (strncmp (c->name, prefix, plen) == 0) {
+            *cp = c->next;
+            edac_sysfs_dir_close (c);
+        }
+        else
+            cp = &c->next;
+    }
+}
+
+static inline int
+dirent_may_be_dir (struct edac_dirent64 *de)
+{
+    return ((de->d_type == DT_DIR)
+         || (de->d_type == DT_LNK)
+         || (de->d_type == DT_UNKNOWN));
+}
+
+
+/*****************************************************************************
+ *  Functions
+ *****************************************************************************/
+
+edac_sysfs_dir * edac_sysfs_dir_open (const char *path)
+{
+    struct edac_sysfs_dir *d;
+    const char *           name;
+    int                    fd;
+
+    if ((fd = open (path, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0)
+        return (NULL);
+
+    name = (name = strrchr (path, '/')) ? name + 1 : path;
+
+    if (!(d = sysfs_dir_create (fd, name))) {
+        close (fd);
+        return (NULL);
+    }
+
+    return (d);
+}
+
+void edac_sysfs_dir_close (edac_sysfs_dir *d)
+{
+    if (d == NULL)
+        return;
+    sysfs_dir_close_children (d);
+    close (d->fd);
+    free (d);
+}
+
+const char * edac_sysfs_dir_name (edac_sysfs_dir *d)
+{
+    return (d->name);
+}
+
+int edac_sysfs_dir_scan (edac_sysfs_dir *d, const char *prefix,
+        edac_sysfs_dir_f f, void *arg)
+{
+    char                    buf[8192];
+    struct edac_sysfs_dir **tailp;
+    size_t                  plen = strlen (prefix);
+    int                     count = 0;
+    long                    n;
+
+    sysfs_dir_close_matching (d, prefix, plen);
+    for (tailp = &d->children; *tailp; tailp = &(*tailp)->next)
+        ;
+
+    if (lseek (d->fd, 0, SEEK_SET) < 0)
+        return (-1);
+
+    while ((n = syscall (SYS_getdents64, d->fd, buf, sizeof (buf))) > 0) {
+        long off = 0;
+
+        while (off < n) {
+            struct edac_dirent64 *de = (struct edac_dirent64 *) (buf + off);
+            struct edac_sysfs_dir *c;
+            int                    fd;
+
+            off += de->d_reclen;
+
+            if (  (strncmp (de->d_name, prefix, plen) != 0)
+               || !dirent_may_be_dir (de))
+                continue;
+
+            fd = openat (d->fd, de->d_name,
+                         O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (fd < 0)
+                continue;
+
+            if (!(c = sysfs_dir_create (fd, de->d_name))) {
+                close (fd);
+                return (-1);
+            }
+
+            *tailp = c;
+            tailp = &c->next;
+            count++;
+
+            if (f && ((*f) (c, arg) < 0))
+                return (-1);
+        }
+    }
+
+    if (n < 0)
+        return (-1);
+
+    return (count);
+}
+
+int edac_sysfs_read_attr (edac_sysfs_dir *d, const char *name,
+        char *buf, int len)
+{
+    int     fd;
+    ssize_t n;
+
+    if ((fd = openat (d->fd, name, O_RDONLY | O_CLOEXEC)) < 0)
+        return (-1);
+
+    n = read (fd, buf, len - 1);
+    close (fd);
+
+    if (n < 0)
+        return (-1);
+
+    buf[n] = '\0';
+    return (n);
+}
+
+int edac_sysfs_open_attr (edac_sysfs_dir *d, const char *name)
+{
+    return (openat (d->fd, name, O_RDONLY | O_CLOEXEC));
+}
+
+/* vi: ts=4 sw=4 expandtab
+ */
@@ -0,0 +1,312 @@
+/*****************************************************************************
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2005-2007 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  Written by Mark Grondona <mgrondona@llnl.gov>
+ *  UCRL-CODE-230739.
+ *
+ *  This file is part of edac-utils.
+ *
+ *  This is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *****************************************************************************/
+
+/*
+ *  Batched counter reads with io_uring(7).
+ *
+ *  The ring is driven with raw system calls and <linux/io_uring.h>, so
+ *   no extra library is needed. One IORING_OP_READ is queued per
+ *   attribute, using its index in the registered file table, and the
+ *   whole batch is submitted and reaped with io_uring_enter(2).
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "edac_uring.h"
+
+#if HAVE_IO_URING
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+/*  Upper bound on ring size. Larger batches are submitted in chunks.
+ */
+#define EDAC_URING_MAX_ENTRIES 1024
+
+/*****************************************************************************
+ *  Data Types
+ *****************************************************************************/
+
+struct edac_uring {
+    int                    fd;              /* io_uring fd                   */
+    unsigned int           n;               /* Number of registered files    */
+    unsigned int           entries;         /* SQ entries                    */
+
+    void *                 sq_ptr;          /* mmapped SQ ring               */
+    size_t                 sq_len;
+    void *                 cq_ptr;          /* mmapped CQ ring               */
+    size_t                 cq_len;
+    struct io_uring_sqe *  sqes;            /* mmapped SQE array             */
+    size_t                 sqes_len;
+
+    unsigned int *         sq_tail;
+    unsigned int *         sq_mask;
+    unsigned int *         sq_array;
+    unsigned int *         cq_head;
+    unsigned int *         cq_tail;
+    unsigned int *         cq_mask;
+    struct io_uring_cqe *  cqes;
+};
+
+
+/*****************************************************************************
+ *  Private Functions
+ *****************************************************************************/
+
+static int
+uring_setup (unsigned int entries, struct io_uring_params *p)
+{
+    return (syscall (SYS_io_uring_setup, entries, p));
+}
+
+static int
+uring_enter (int fd, unsigned int submit, unsigned int complete)
+{
+    return (syscall (SYS_io_uring_enter, fd, submit, complete,
+                     IORING_ENTER_GETEVENTS, NULL, 0));
+}
+
+static void *
+uring_mmap (int fd, size_t len, off_t off)
+{
+    void *p = mmap (NULL, len, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, off);
+    return ((p == MAP_FAILED) ? NULL : p);
+}
+
+/*  Return 1 if the kernel supports IORING_OP_READ on ring `fd'. Kernels
+ *   5.1 to 5.5 have io_uring but neither the opcode nor the probe, and
+ *   would fail every read with EINVAL.
+ */
+static int
+uring_probe_read (int fd)
+{
+    struct io_uring_probe *probe;
+    size_t                 len;
+    int                    ok = 0;
+
+    len = sizeof (*probe) + IORING_OP_LAST * sizeof (probe->ops[0]);
+    if (!(probe = calloc (1, len)))
+        return (0);
+
+    if (  (syscall (SYS_io_uring_register, fd, IORING_REGISTER_PROBE,
+                    probe, IORING_OP_LAST) == 0)
+       && (probe->last_op >= IORING_OP_READ)
+       && (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED))
+        ok = 1;
+
+    free (probe);
+    return (ok);
+}
+
+/*  Reap all available completions, returning the number reaped.
+ */
+static unsigned int
+uring_reap (edac_uring *u, char *bufs, int *res)
+{
+    unsigned int head = *u->cq_head;
+    unsigned int count = 0;
+
+    __sync_synchronize ();
+
+    while (head != *u->cq_tail) {
+        struct io_uring_cqe *cqe = &u->cqes[head & *u->cq_mask];
+        unsigned int         i = (unsigned int) cqe->user_data;
+
+        if ((res[i] = cqe->res) >= 0)
+            bufs[i * EDAC_URING_BUFLEN + cqe->res] = '\0';
+
+        head++;
+        count++;
+    }
+
+    __sync_synchronize ();
+    *u->cq_head = head;
+
+    return (count);
+}
+
+
+/*****************************************************************************
+ *  Functions
+ *****************************************************************************/
+
+edac_uring * edac_uring_create (const int *fds, unsigned int n)
+{
+    struct io_uring_params p;
+    edac_uring *           u;
+
+    if (n == 0)
+        return (NULL);
+
+    if (!(u = malloc (sizeof (*u))))
+        return (NULL);
+
+    memset (u, 0, sizeof (*u));
+    memset (&p, 0, sizeof (p));
+
+    u->n = n;
+    u->entries = (n < EDAC_URING_MAX_ENTRIES) ? n : EDAC_URING_MAX_ENTRIES;
+
+    if ((u->fd = uring_setup (u->entries, &p)) < 0) {
+        free (u);
+        return (NULL);
+    }
+
+    if (!uring_probe_read (u->fd)) {
+        close (u->fd);
+        free (u);
+        return (NULL);
+    }
+
+    /*  Kernel rounds entries up to a power of two
+     */
+    u->entries = p.sq_entries;
+
+    u->sq_len = p.sq_off.array + p.sq_entries * sizeof (unsigned int);
+    u->cq_len = p.cq_off.cqes + p.cq_entries * sizeof (struct io_uring_cqe);
+    u->sqes_len = p.sq_entries * sizeof (struct io_uring_sqe);
+
+    if (  !(u->sq_ptr = uring_mmap (u->fd, u->sq_len, IORING_OFF_SQ_RING))
+       || !(u->cq_ptr = uring_mmap (u->fd, u->cq_len, IORING_OFF_CQ_RING))
+       || !(u->sqes = uring_mmap (u->fd, u->sqes_len, IORING_OFF_SQES))) {
+        edac_uring_destroy (u);
+        return (NULL);
+    }
+
+    u->sq_tail =  (unsigned int *) ((char *) u->sq_ptr + p.sq_off.tail);
+    u->sq_mask =  (unsigned int *) ((char *) u->sq_ptr + p.sq_off.ring_mask);
+    u->sq_array = (unsigned int *) ((char *) u->sq_ptr + p.sq_off.array);
+    u->cq_head =  (unsigned int *) ((char *) u->cq_ptr + p.cq_off.head);
+    u->cq_tail =  (unsigned int *) ((char *) u->cq_ptr + p.cq_off.tail);
+    u->cq_mask =  (unsigned int *) ((char *) u->cq_ptr + p.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe *) ((char *) u->cq_ptr + p.cq_off.cqes);
+
+    if (syscall (SYS_io_uring_register, u->fd, IORING_REGISTER_FILES,
+                 fds, n) < 0) {
+        edac_uring_destroy (u);
+        return (NULL);
+    }
+
+    return (u);
+}
+
+void edac_uring_destroy (edac_uring *u)
+{
+    if (u == NULL)
+        return;
+    if (u->sqes)
+        munmap (u->sqes, u->sqes_len);
+    if (u->cq_ptr)
+        munmap (u->cq_ptr, u->cq_len);
+    if (u->sq_ptr)
+        munmap (u->sq_ptr, u->sq_len);
+    close (u->fd);
+    free (u);
+}
+
+int edac_uring_read (edac_uring *u, char *bufs, int *res)
+{
+    unsigned int first;
+
+    for (first = 0; first < u->n; first += u->entries) {
+        unsigned int count = u->n - first;
+        unsigned int tail = *u->sq_tail;
+        unsigned int to_submit;
+        unsigned int reaped = 0;
+        unsigned int i;
+
+        if (count > u->entries)
+            count = u->entries;
+
+        for (i = first; i < first + count; i++) {
+            unsigned int         idx = tail & *u->sq_mask;
+            struct io_uring_sqe *sqe = &u->sqes[idx];
+
+            memset (sqe, 0, sizeof (*sqe));
+            sqe->opcode =    IORING_OP_READ;
+            sqe->flags =     IOSQE_FIXED_FILE;
+            sqe->fd =        i;
+            sqe->addr =      (unsigned long) (bufs + i * EDAC_URING_BUFLEN);
+            sqe->len =       EDAC_URING_BUFLEN - 1;
+            sqe->off =       0;
+            sqe->user_data = i;
+
+            u->sq_array[idx] = idx;
+            tail++;
+        }
+
+        __sync_synchronize ();
+        *u->sq_tail = tail;
+        __sync_synchronize ();
+
+        to_submit = count;
+        while (reaped < count) {
+            int n = uring_enter (u->fd, to_submit, count - reaped);
+
+            if (n < 0) {
+                if ((errno != EINTR) && (errno != EAGAIN) && (errno != EBUSY))
+                    return (-1);
+            }
+            else
+                to_submit -= n;
+
+            reaped += uring_reap (u, bufs, res);
+        }
+    }
+
+    return (0);
+}
+
+#else /* !HAVE_IO_URING */
+
+edac_uring * edac_uring_create (const int *fds, unsigned int n)
+{
+    return (NULL);
+}
+
+void edac_uring_destroy (edac_uring *u)
+{
+    return;
+}
+
+int edac_uring_read (edac_uring *u, char *bufs, int *res)
+{
+    errno = ENOSYS;
+    return (-1);
+}
+
+#endif /* HAVE_IO_URING */
+
+/* vi: ts=4 sw=4 expandtab
+ */
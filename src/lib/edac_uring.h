@@ -0,0 +1,70 @@
+/*****************************************************************************
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2005-2007 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  Written by Mark Grondona <mgrondona@llnl.gov>
+ *  UCRL-CODE-230739.
+ *
+ *  This file is part of edac-utils.
+ *
+ *  This is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *****************************************************************************/
+
+/*
+ *  Private interface for batched counter reads in libedac.
+ *
+ *  All counter attributes are registered once as io_uring fixed files,
+ *   and each sample submits one read per attribute as a single batch.
+ *   If libedac was built without io_uring support (--disable-io-uring)
+ *   or the kernel refuses io_uring_setup(2) or has no IORING_OP_READ
+ *   (before 5.6), edac_uring_create () returns NULL and callers use
+ *   pread(2) instead.
+ */
+
+#ifndef _EDAC_URING_H
+#define _EDAC_URING_H
+
+#include <sys/types.h>
+
+/*  Size of the read buffer for each counter
+ */
+#define EDAC_URING_BUFLEN 32
+
+typedef struct edac_uring edac_uring;
+
+/*
+ *  Set up a ring for reading the `n' open attributes in `fds'.
+ *   Returns NULL if io_uring or its read operation is not available.
+ */
+edac_uring * edac_uring_create (const int *fds, unsigned int n);
+
+/*
+ *  Free ring `u'.
+ */
+void edac_uring_destroy (edac_uring *u);
+
+/*
+ *  Read all attributes from offset 0. Attribute `i' is read into
+ *   `bufs + i * EDAC_URING_BUFLEN', NUL terminated, and `res[i]' is set
+ *   to the number of bytes read or -errno. Returns <0 if the batch
+ *   could not be submitted at all.
+ */
+int edac_uring_read (edac_uring *u, char *bufs, int *res);
+
+#endif /* !_EDAC_URING_H */
+
+/* vi: ts=4 sw=4 expandtab
+ */
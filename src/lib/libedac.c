@@ -29,20 +29,41 @@
 
 #include <errno.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
 
 #include <stdio.h>
 
-#include <sysfs/libsysfs.h>
 #include <edac.h>
+#include "edac_sysfs.h"
+#include "edac_uring.h"
+#include "edac_pool.h"
+#include "edac_shm.h"
+#include "edac_histfile.h"
 
 /*****************************************************************************
  *  Constants
  *****************************************************************************/
 
-static const char edac_sysfs_path[] =      "/sys/devices/system/edac/mc";
-static const char edac_pci_sysfs_path[] =  "/sys/devices/system/edac/pci";
+static const char edac_sysfs_root[] =      "/sys/devices/system/edac";
+
+/*  Counters sampled per job when refresh runs on a worker pool
+ */
+#define EDAC_SAMPLE_CHUNK 64
+
+/*  Attempts at a consistent copy of the shared-memory segment before
+ *   giving up on a publisher which died in the middle of a write.
+ */
+#define EDAC_SHM_RETRIES  1000
+
+/*  Buckets per rate window. Each window is a ring of this many equal
+ *   time slices, so counts cover between (n-1)/n and all of a window.
+ */
+#define EDAC_RATE_BUCKETS 12
 
 /*****************************************************************************
  *  Data Types
@@ -55,58 +76,270 @@ enum edac_error {
     EDAC_BAD_HANDLE        = 3,
     EDAC_OPEN_FAILED       = 4,
     EDAC_MC_OPEN_FAILED    = 5,
-    EDAC_CSROW_OPEN_FAILED = 6
+    EDAC_CSROW_OPEN_FAILED = 6,
+    EDAC_SHM_FAILED        = 7
+};
+
+/*  Flat counter store. All error counters for the handle live in one
+ *   contiguous array of uint64_t, split into per-type sections indexed
+ *   by MC, csrow or channel number. Names, labels and sizes are kept
+ *   separately in the edac_mc, edac_csrow and edac_chan_info arrays.
+ */
+struct edac_store {
+    uint64_t *             values;          /* All counters                  */
+    unsigned int           nvalues;         /* Number of counters in values  */
+    uint64_t *             mc_ce;           /* [nmcs] MC ce_count            */
+    uint64_t *             mc_ue;           /* [nmcs] MC ue_count            */
+    uint64_t *             mc_ce_noinfo;    /* [nmcs] MC ce_noinfo_count     */
+    uint64_t *             mc_ue_noinfo;    /* [nmcs] MC ue_noinfo_count     */
+    uint64_t *             csrow_ce;        /* [ncsrows] csrow ce_count      */
+    uint64_t *             csrow_ue;        /* [ncsrows] csrow ue_count      */
+    uint64_t *             chan_ce;         /* [nchannels] chN_ce_count      */
+    uint64_t *             dimm_ce;         /* [ndimms] dimm_ce_count        */
+    uint64_t *             dimm_ue;         /* [ndimms] dimm_ue_count        */
+    uint64_t *             pci_parity;      /* [1] pci_parity_count          */
+};
+
+/*  Sysfs attribute backing store value of the same index. The attribute
+ *   is opened once at init and resampled with pread() at offset 0 on
+ *   each refresh. If the attribute could not be opened (e.g. out of file
+ *   descriptors), fd is -1 and the attribute is reopened and read on
+ *   every sample instead. Slots with an empty name have no attribute.
+ */
+struct edac_counter {
+    int                    fd;              /* Open sysfs attribute or -1    */
+    edac_sysfs_dir *       dev;             /* sysfs directory for fallback  */
+    char                   name[32];        /* attribute name                */
+};
+
+/*  Counters with an open fd, read together through io_uring when
+ *   available. Slot i of the ring reads counters[counter[i]].
+ */
+struct edac_batch {
+    edac_uring *           ring;            /* NULL if not batching          */
+    unsigned int *         counter;         /* [n] index into counters       */
+    unsigned int           n;               /* number of ring slots          */
+    char *                 bufs;            /* [n * EDAC_URING_BUFLEN]       */
+    int *                  res;             /* [n] read results              */
+};
+
+/*  Per-channel information which does not change after init.
+ */
+struct edac_chan_info {
+    int                    valid;           /* Is this channel valid         */
+    int                    dimm_label_valid;/* Is DIMM label valid?          */
+    char                   dimm_label[EDAC_LABEL_LEN];
+                                            /* DIMM name                     */
+};
+
+/*  Owner of the topology arrays of a handle. Snapshots hold a
+ *   reference, so a reload by edac_handle_init () does not free names
+ *   and labels a reader is still using. The handle keeps its own
+ *   copies of these pointers for the live iterators.
+ */
+struct edac_topology {
+    int                    refs;            /* handle + snapshots            */
+    struct edac_mc *       mcs;
+    unsigned int           nmcs;
+    struct edac_csrow *    csrows;
+    unsigned int           ncsrows;
+    struct edac_chan_info *channels;
+    unsigned int           nchannels;
+    struct edac_dimm *     dimms;
+    unsigned int           ndimms;
+    int *                  mc_by_num;
+    unsigned int           mc_by_num_size;
 };
 
 struct edac_handle {
-    int                   initialized;      /* 1 if structure is valid       */
-    struct sysfs_device * dev;              /* sysfs device handle           */
-    struct sysfs_device *  pci;             /* sysfs edac/pci/ device handle */
-    struct dlist *         mc_list;         /* list of memory controllers    */
-    int                    ce_total;        /* Total corrected errors        */
-    int                    ue_total;        /* Total uncorrected errors      */
-    int                    pci_parity_count;/* Total PCI parity errors       */
-    int                    totals_valid;    /* 1=totals valid 0=not          */
+    int                    initialized;     /* 1 if structure is valid       */
+    edac_sysfs_dir *       dev;             /* sysfs edac/mc/ directory      */
+    edac_sysfs_dir *       pci;             /* sysfs edac/pci/ directory     */
+    struct edac_mc *       mcs;             /* array of memory controllers   */
+    unsigned int           nmcs;            /* number of MCs                 */
+    unsigned int           mc_iter;         /* index of next MC returned     */
+    struct edac_csrow *    csrows;          /* array of csrows for all MCs   */
+    unsigned int           ncsrows;         /* number of csrows              */
+    struct edac_chan_info *channels;        /* array of channels, all csrows */
+    unsigned int           nchannels;       /* number of channel slots       */
+    struct edac_dimm *     dimms;           /* array of DIMMs for all MCs    */
+    unsigned int           ndimms;          /* number of DIMMs               */
+    int *                  mc_by_num;       /* MC index by N in mcN, or -1   */
+    unsigned int           mc_by_num_size;  /* size of mc_by_num             */
+    struct edac_store      store;           /* error counters                */
+    struct edac_counter *  counters;        /* [store.nvalues] attributes    */
+    struct edac_batch      batch;           /* io_uring reads of counters    */
+    struct edac_topology * topo;            /* owner of topology arrays      */
+    int                    detail_loaded;   /* csrows/DIMMs have been read   */
+    edac_snapshot *        published;       /* last edac_handle_publish ()   */
+    int                    acquiring;       /* readers in acquire            */
+    struct edac_totals     totals;          /* Updated with every sample     */
     int                    error_num;       /* Last library error            */
     char *                 error_str;       /* Last error string             */
+    char *                 root;            /* edac_handle_set_root () path  */
+    int                    nthreads;        /* edac_handle_set_threads ()    */
+    edac_pool *            pool;            /* workers, NULL if serial       */
+    unsigned int           layout_gen;      /* bumped when store is rebuilt  */
+    char *                 shm_name;        /* edac_handle_attach_shm ()     */
+    edac_shm *             shm;             /* attached segment, or NULL     */
+    uint32_t               shm_gen;         /* segment generation loaded     */
+    uint64_t               shm_off_values;  /* offset of values in segment   */
+    edac_shm *             pub;             /* segment we publish to         */
+    unsigned int           pub_gen;         /* layout_gen last published     */
 };
 
 struct edac_mc {
     struct edac_handle *   edac;            /* Pointer back to EDAC handle   */
-    struct edac_mc_info    info;            /* EDAC MC error info            */
-    struct sysfs_device *  dev;             /* sysfs device handle           */
-    struct dlist *         csrow_list;      /* list of csrows for this mc    */
+    edac_sysfs_dir *       dev;             /* sysfs directory for this mc   */
+    char                   id[EDAC_NAME_LEN];
+                                            /* Id of memory controller (mcN) */
+    char                   mc_name[EDAC_NAME_LEN];
+                                            /* Name of MC (e.g. "E7525")     */
+    unsigned int           size_mb;         /* Amount of RAM in MB           */
+    unsigned int           csrow_first;     /* index of first csrow          */
+    unsigned int           ncsrows;         /* number of csrows for this mc  */
+    unsigned int           csrow_iter;      /* next csrow returned           */
+    unsigned int           num;             /* N in mcN                      */
+    unsigned int           dimm_first;      /* index of first DIMM           */
+    unsigned int           ndimms;          /* number of DIMMs for this mc   */
+    unsigned int           dimm_iter;       /* next DIMM returned            */
+    int                    nlayers;         /* number of DIMM location layers*/
+    char                   layer[EDAC_MAX_LAYERS][EDAC_LAYER_NAME_LEN];
+                                            /* layer names from sysfs        */
+    unsigned int           layer_size[EDAC_MAX_LAYERS];
+                                            /* positions in each layer       */
+    int *                  dimm_index;      /* DIMM index by location or -1  */
 };
 
 struct edac_csrow {
-    struct edac_mc *       mc;             /* Pointer back to MC             */
-    struct sysfs_device *  dev;            /* sysfs device handle            */
-    struct edac_csrow_info info;           /* EDAC csrow error info          */
+    struct edac_handle *   edac;           /* Pointer back to EDAC handle    */
+    edac_sysfs_dir *       dev;            /* sysfs directory for csrow      */
+    char                   id[EDAC_NAME_LEN];
+                                           /* CSROW Identity (e.g. csrow0)   */
+    unsigned int           size_mb;        /* CSROW size in MB               */
+    unsigned int           chan_first;     /* index of channel 0             */
+    unsigned int           nchannels;      /* channel slots for this csrow   */
+};
+
+struct edac_dimm {
+    struct edac_handle *   edac;           /* Pointer back to EDAC handle    */
+    edac_sysfs_dir *       dev;            /* sysfs directory for DIMM       */
+    char                   id[EDAC_NAME_LEN];
+                                           /* DIMM Identity (e.g. dimm0)     */
+    unsigned int           mc;             /* index of MC for this DIMM      */
+    int                    location[EDAC_MAX_LAYERS];
+                                           /* position in each MC layer      */
+    unsigned int           size_mb;        /* DIMM size in MB                */
+    int                    dimm_label_valid;
+                                           /* Is DIMM label valid?           */
+    char                   dimm_label[EDAC_LABEL_LEN];
+                                           /* DIMM name                      */
+};
+
+/*  Snapshots are immutable once taken and do not refer back to the
+ *   handle, so they may be read from any thread while held.
+ */
+struct edac_snapshot {
+    int                    refs;           /* Reference count                */
+    struct edac_topology * topo;           /* Topology the values belong to  */
+    struct edac_store      store;          /* Sections rebased onto values   */
+    struct edac_totals     totals;         /* Totals at time of snapshot     */
+};
+
+/*  One rate window: a ring of EDAC_RATE_BUCKETS time slices holding
+ *   the errors each counter saw in that slice, and their running sum.
+ *   Buckets are stored slice-major so a slice is cleared in one go.
+ */
+struct rate_window {
+    unsigned int           length;         /* Window length in seconds       */
+    double                 width;          /* Seconds per bucket             */
+    uint64_t               epoch;          /* Slices since first update      */
+    unsigned int           cur;            /* Bucket of current slice        */
+    uint32_t *             buckets;        /* [BUCKETS][nvalues] errors      */
+    uint64_t *             sum;            /* [nvalues] errors in window     */
+    uint64_t *             threshold;      /* [nvalues] alert level or 0     */
+    unsigned char *        over;           /* [nvalues] sum >= threshold     */
+};
+
+struct edac_rate {
+    edac_handle *          edac;           /* Handle sampled                 */
+    unsigned int           layout_gen;     /* Store layout at create         */
+    unsigned int           nvalues;        /* Counters tracked               */
+    unsigned int           nwindows;       /* Number of windows              */
+    struct rate_window *   w;              /* [nwindows] windows             */
+    uint64_t *             prev;           /* [nvalues] values at last update*/
+    int                    started;        /* Baseline has been taken        */
+    double                 start;          /* Time of first update           */
+    double                 now;            /* Time of last update            */
+    struct edac_rate_alert *alerts;        /* Alerts from last update        */
+    unsigned int           nalerts;
+    unsigned int           alerts_size;
+};
+
+struct edac_history {
+    edac_handle *          edac;           /* Handle recorded, or NULL       */
+    unsigned int           layout_gen;     /* Store layout file was opened at*/
+    char *                 path;           /* History file                   */
+    unsigned int           nrecords;       /* Records asked for at create    */
+    edac_histfile *        file;           /* Mapped history file            */
+    struct edac_histfile_record *
+                           rec;            /* Buffer for edac_history_read ()*/
 };
 
-typedef void (*del_f) (void *);
+struct edac_layout {
+    edac_handle *          edac;           /* Handle laid out                */
+    unsigned int           layout_gen;     /* Store layout at create         */
+    struct edac_layout_info info;
+    int *                  cell;           /* [ncells] DIMM index or -1      */
+};
 
 
 /*****************************************************************************
  *  Prototypes
  *****************************************************************************/
 
-static int edac_handle_reload (edac_handle *edac);
+static int edac_topology_create (edac_handle *edac);
+
+static void edac_topology_destroy (edac_handle *edac);
+
+static int edac_store_sample (edac_handle *edac);
+
+static int edac_shm_load (edac_handle *edac);
+
+static int edac_shm_publish (edac_handle *edac);
+
+static void rate_window_advance (struct edac_rate *r, struct rate_window *w,
+        double now);
+
+static int rate_alert_add (struct edac_rate *r, unsigned int counter,
+        unsigned int window);
 
-static inline void edac_dlist_reset (struct dlist *l);
+static inline int edac_detail_ready (struct edac_handle *edac);
 
-static struct dlist * mc_list_create (edac_handle *edac);
+static void counter_label (edac_handle *edac, unsigned int counter, 
+        char *buf, int len);
 
-static int edac_totals_refresh (edac_handle *edac);
+static int history_file_open (struct edac_history *h);
 
-static inline void * edac_dlist_next (struct dlist *l);
+static void topology_release (struct edac_topology *t);
 
-static struct sysfs_device * _sysfs_open_device_tree (const char *path);
+static void mc_info_fill (const struct edac_topology *t, 
+        const struct edac_store *s, unsigned int i, struct edac_mc_info *info);
 
-static int get_sysfs_string_attr (struct sysfs_device *dev, char *dest, 
+static void csrow_info_fill (const struct edac_topology *t, 
+        const struct edac_store *s, unsigned int i, 
+        struct edac_csrow_info *info);
+
+static void dimm_info_fill (const struct edac_topology *t, 
+        const struct edac_store *s, unsigned int i, 
+        struct edac_dimm_info *info);
+
+static int edac_counter_sample (struct edac_counter *c, uint64_t *valp);
+
+static int get_sysfs_string_attr (edac_sysfs_dir *dev, char *dest, 
         int len, const char *format, ...);
 
-static int get_sysfs_uint_attr (struct sysfs_device *dev, unsigned int *valp, 
+static int get_sysfs_uint_attr (edac_sysfs_dir *dev, unsigned int *valp, 
         const char *format, ...);
 
 
@@ -125,25 +358,67 @@ edac_handle * edac_handle_create (void)
 
     return (edac);
 }
+
+/*  Return the EDAC sysfs root directory for `edac'.
+ */
+static const char *
+edac_root (edac_handle *edac)
+{
+    const char *root = edac->root;
+
+    if (!root && !(root = getenv (EDAC_SYSFS_ROOT_ENV)))
+        root = edac_sysfs_root;
+
+    return (root);
+}
+
+/*  Return segment `name', or the default segment name if NULL.
+ */
+static const char *
+edac_shm_name (const char *name)
+{
+    if (!name && !(name = getenv (EDAC_SHM_ENV)))
+        name = EDAC_SHM_NAME;
+    return (name);
+}
+
 int edac_handle_init (struct edac_handle *edac)
 {
     if (edac == NULL)
         return (-1);
 
     if (edac->initialized) {
-        return (edac_handle_reload (edac));
+        /*
+         *  Reload: discard the current topology and counter store and
+         *   rebuild both from sysfs.
+         */
+        edac_topology_destroy (edac);
     }
 
-    if (!(edac->dev = _sysfs_open_device_tree (edac_sysfs_path))) {
-        edac->error_num = EDAC_OPEN_FAILED;
-        return (-1);
+    /*  Use a running publisher if asked to, else fall back to sysfs
+     */
+    if (edac->shm_name && (edac_shm_load (edac) == 0)) {
+        edac->initialized = 1;
+        return (0);
     }
 
-    edac->pci = sysfs_open_device_path (edac_pci_sysfs_path);
-    /* XXX: Ignore errors? */
+    if (edac->dev == NULL) {
+        const char *root = edac_root (edac);
+        char        path[4096];
 
-    if (!(edac->mc_list = mc_list_create (edac))) {
-        edac->error_num = EDAC_MC_OPEN_FAILED;
+        snprintf (path, sizeof (path), "%s/mc", root);
+        if (!(edac->dev = edac_sysfs_dir_open (path))) {
+            edac->error_num = EDAC_OPEN_FAILED;
+            return (-1);
+        }
+
+        snprintf (path, sizeof (path), "%s/pci", root);
+        edac->pci = edac_sysfs_dir_open (path);
+        /* XXX: Ignore errors? */
+    }
+
+    if (edac_topology_create (edac) < 0) {
+        edac_topology_destroy (edac);
         return (-1);
     }
 
@@ -152,26 +427,129 @@ int edac_handle_init (struct edac_handle *edac)
     return (0);
 }
 
+int edac_handle_set_root (edac_handle *edac, const char *path)
+{
+    char *root = NULL;
+
+    if ((edac == NULL) || edac->initialized)
+        return (-1);
+
+    if (path && !(root = strdup (path))) {
+        edac->error_num = EDAC_OUT_OF_MEMORY;
+        return (-1);
+    }
+
+    if (edac->root)
+        free (edac->root);
+    edac->root = root;
+
+    return (0);
+}
+
+int edac_handle_attach_shm (edac_handle *edac, const char *name)
+{
+    char *copy;
+
+    if ((edac == NULL) || edac->initialized)
+        return (-1);
+
+    if (!(copy = strdup (edac_shm_name (name)))) {
+        edac->error_num = EDAC_OUT_OF_MEMORY;
+        return (-1);
+    }
+
+    if (edac->shm_name)
+        free (edac->shm_name);
+    edac->shm_name = copy;
+
+    return (0);
+}
+
+int edac_handle_publish_shm (edac_handle *edac, const char *name)
+{
+    if (edac == NULL)
+        return (-1);
+
+    /*  A handle reading from a segment has nothing of its own to publish
+     */
+    if (edac->shm) {
+        edac->error_num = EDAC_SHM_FAILED;
+        return (-1);
+    }
+
+    if ((edac_handle_refresh (edac) < 0) || !edac_detail_ready (edac))
+        return (-1);
+
+    if (!edac->pub && !(edac->pub = edac_shm_create (edac_shm_name (name)))) {
+        edac->error_num = EDAC_SHM_FAILED;
+        return (-1);
+    }
+
+    if (edac_shm_publish (edac) < 0) {
+        edac->error_num = EDAC_SHM_FAILED;
+        return (-1);
+    }
+
+    return (0);
+}
+
+int edac_handle_set_threads (edac_handle *edac, int nthreads)
+{
+    if ((edac == NULL) || (nthreads < 0))
+        return (-1);
+
+    /*  The pool is started again with the new size on next use
+     */
+    edac_pool_destroy (edac->pool);
+    edac->pool = NULL;
+    edac->nthreads = nthreads;
+
+    return (0);
+}
+
+int edac_handle_refresh (edac_handle *edac)
+{
+    if (edac == NULL)
+        return (-1);
+
+    if (!edac->initialized)
+        return (edac_handle_init (edac));
+
+    /*  Only counters are reread here, through the table of attributes
+     *   resolved at init. The topology is reused as-is, so no memory
+     *   is allocated.
+     */
+    if (edac_store_sample (edac) < 0) {
+        edac->error_num = edac->shm ? EDAC_SHM_FAILED : EDAC_MC_OPEN_FAILED;
+        return (-1);
+    }
+
+    return (0);
+}
+
 unsigned int 
 edac_mc_count (edac_handle *edac)
 {
     if (!edac->initialized) {
         edac_handle_init (edac);
     }
-    if (edac->mc_list != NULL) {
-        return (edac->mc_list->count);
-    }
-    return (0);
+    return (edac->nmcs);
 }
 
 void edac_handle_destroy (edac_handle *edac)
 {
-    if (edac->mc_list)
-        dlist_destroy (edac->mc_list);
+    edac_snapshot_release (edac->published);
+    edac_topology_destroy (edac);
     if (edac->dev)
-        sysfs_close_device_tree (edac->dev); 
+        edac_sysfs_dir_close (edac->dev); 
     if (edac->pci)
-        sysfs_close_device (edac->pci);
+        edac_sysfs_dir_close (edac->pci);
+    if (edac->root)
+        free (edac->root);
+    if (edac->shm_name)
+        free (edac->shm_name);
+    edac_shm_destroy (edac->pub);
+    edac_pool_destroy (edac->pool);
     free (edac);
     return;
 }
@@ -193,6 +571,8 @@ const char * edac_strerror (edac_handle *edac)
             return ("Unable to open EDAC memory controller in sysfs");
         case EDAC_CSROW_OPEN_FAILED:
             return ("Unable to open csrow in sysfs");
+        case EDAC_SHM_FAILED:
+            return ("Shared memory EDAC counters unavailable or changed");
         default:
             break;
     }
@@ -202,8 +582,7 @@ const char * edac_strerror (edac_handle *edac)
 
 int edac_handle_reset (edac_handle *edac)
 {
-    if (edac->mc_list) 
-        edac_dlist_reset (edac->mc_list);
+    edac->mc_iter = 0;
     return (0);
 }
 
@@ -216,24 +595,27 @@ int edac_error_totals (edac_handle *edac, struct edac_totals *tot)
 
     memset (tot, 0, sizeof (*tot));
 
-    if (!edac->totals_valid)  {
-        if (edac_totals_refresh (edac) < 0) {
-            return (-1);
-        }
+    if (edac->nmcs == 0) {
+        edac->error_num = EDAC_MC_OPEN_FAILED;
+        return (-1);
     }
 
-    tot->ue_total = edac->ue_total;
-    tot->ce_total = edac->ce_total;
-    tot->pci_parity_total = edac->pci_parity_count;
+    *tot = edac->totals;
     
     return (0);
 }
 
+/*
+ *  The iterator and info functions below are a compatibility layer
+ *   over the flat counter store.
+ */
+
 edac_mc * edac_next_mc (edac_handle *edac)
 {
-    if ((edac == NULL) || (edac->mc_list == NULL))
+    if ((edac == NULL) || (edac->mc_iter >= edac->nmcs))
         return NULL;
-    return (edac_dlist_next (edac->mc_list));
+
+    return (&edac->mcs[edac->mc_iter++]);
 }
 
 edac_mc * edac_next_mc_info (edac_handle *edac, struct edac_mc_info *info)
@@ -251,7 +633,7 @@ int edac_mc_get_info (edac_mc *mc, struct edac_mc_info *info)
     if (info == NULL)
         return (-1);
 
-    *info = mc->info;
+    mc_info_fill (mc->edac->topo, &mc->edac->store, mc - mc->edac->mcs, info);
 
     return (0);
 
@@ -259,10 +641,11 @@ int edac_mc_get_info (edac_mc *mc, struct edac_mc_info *info)
 
 edac_csrow * edac_next_csrow (struct edac_mc *mc)
 {
-    if (mc == NULL)
+    if ((mc == NULL) || !edac_detail_ready (mc->edac)
+       || (mc->csrow_iter >= mc->ncsrows))
         return NULL;
 
-    return (edac_dlist_next (mc->csrow_list));
+    return (&mc->edac->csrows[mc->csrow_first + mc->csrow_iter++]);
 }
 
 edac_csrow * 
@@ -275,10 +658,13 @@ edac_next_csrow_info (struct edac_mc *mc, struct edac_csrow_info *info)
 
 int edac_csrow_get_info (edac_csrow *csrow, struct edac_csrow_info *info)
 {
+    struct edac_handle *edac;
+
     if (!csrow || !info)
         return (-1);
 
-    *info = csrow->info;
+    edac = csrow->edac;
+    csrow_info_fill (edac->topo, &edac->store, csrow - edac->csrows, info);
 
     return (0);
 }
@@ -288,409 +674,2864 @@ int edac_mc_reset (struct edac_mc *mc)
     if (mc == NULL)
         return (-1);
 
-    edac_dlist_reset (mc->csrow_list);
+    mc->csrow_iter = 0;
+    mc->dimm_iter = 0;
 
     return (0);
 }
 
-
-/*****************************************************************************
- *  Private Functions
- *****************************************************************************/
-
-/*  Like dlist_next(), but return current data, then advance marker.
- */
-static inline void * edac_dlist_next (struct dlist *l)
+unsigned int edac_mc_dimm_count (edac_mc *mc)
 {
-    void *data = l->marker->data;
-    dlist_next (l);
-    return (data);
+    if ((mc == NULL) || !edac_detail_ready (mc->edac))
+        return (0);
+    return (mc->ndimms);
 }
 
-static inline void edac_dlist_reset (struct dlist *l)
+edac_dimm * edac_next_dimm (edac_mc *mc)
 {
-    dlist_start (l);
-    dlist_next (l);
+    if ((mc == NULL) || !edac_detail_ready (mc->edac)
+       || (mc->dimm_iter >= mc->ndimms))
+        return NULL;
+
+    return (&mc->edac->dimms[mc->dimm_first + mc->dimm_iter++]);
 }
 
-static inline void remove_newline (char *str)
+edac_dimm * edac_next_dimm_info (edac_mc *mc, struct edac_dimm_info *info)
 {
-    int len = strlen (str);
-
-    if (len && str[len - 1] == '\n')
-        str[len - 1] = '\0';
+    edac_dimm * dimm = edac_next_dimm (mc);
+    edac_dimm_get_info (dimm, info);
+    return (dimm);
 }
 
-static int
-edac_channel_refresh (struct edac_csrow *csrow, int id)
+int edac_dimm_get_info (edac_dimm *dimm, struct edac_dimm_info *info)
 {
-    struct sysfs_device *dev =  csrow->dev;
-    struct edac_channel *chan = &csrow->info.channel[id];
-    int                  rc;
-
-    /* On some EDAC implementations ch1_* files may exist
-     *  even though nr_channels = 1. Returning an error here
-     *  should suffice to mark the channel invalid.
-     */
+    struct edac_handle *edac;
 
-    if (get_sysfs_uint_attr (dev, &chan->ce_count, "ch%d_ce_count", id) < 0) 
+    if (!dimm || !info)
         return (-1);
-    rc = get_sysfs_string_attr ( dev, chan->dimm_label, 
-                                 sizeof (chan->dimm_label),
-                                 "ch%d_dimm_label", id );
-
-    if (  (rc >= 0) 
-       && (chan->dimm_label[0] != '\0') 
-       && (chan->dimm_label[0] != '\n') ) {
-        chan->dimm_label_valid = 1;
-    }
 
-    remove_newline (chan->dimm_label);
+    edac = dimm->edac;
+    dimm_info_fill (edac->topo, &edac->store, dimm - edac->dimms, info);
 
-    chan->valid = 1;
     return (0);
 }
 
-static int 
-edac_csrow_refresh (struct edac_csrow *csrow)
+edac_dimm * edac_find_dimm (edac_handle *edac, unsigned int num, 
+        const int *location, int nlayers)
 {
-    struct sysfs_device *    dev =   csrow->dev;
-    struct edac_csrow_info * info = &csrow->info;
-    int                      i;
-
-    strncpy (info->id, dev->name, sizeof (info->id) - 1);
+    struct edac_mc *mc;
+    unsigned int    idx = 0;
+    int             i;
 
-    if (get_sysfs_uint_attr (dev, &info->size_mb, "size_mb") < 0)
-        return -1;
-    if (get_sysfs_uint_attr (dev, &info->ce_count, "ce_count") < 0)
-        return -1;
-    if (get_sysfs_uint_attr (dev, &info->ue_count, "ue_count") < 0)
-        return -1;
+    if (!edac || !location || (num >= edac->mc_by_num_size)) 
+        return (NULL);
 
-    for (i = 0; i < EDAC_MAX_CHANNELS; i++) {
-        edac_channel_refresh (csrow, i);
-    }
-    
-    return 0;
-}
+    if (!edac_detail_ready (edac))
+        return (NULL);
 
-static int 
-edac_mc_refresh (struct edac_mc *mc)
-{
-    struct sysfs_device *dev =  mc->dev;
-    struct edac_mc_info *i = &mc->info;
-    char *               p;
+    if (edac->mc_by_num[num] < 0)
+        return (NULL);
 
-    if (get_sysfs_uint_attr (dev, &i->size_mb, "size_mb") < 0) 
-        return (-1);
-    if (get_sysfs_uint_attr (dev, &i->ce_count, "ce_count") < 0) 
-        return (-1);
-    if (get_sysfs_uint_attr (dev, &i->ue_count, "ue_count") < 0)
-        return (-1);
-    if (get_sysfs_uint_attr (dev, &i->ce_noinfo_count, "ce_noinfo_count") < 0)
-        return (-1);
-    if (get_sysfs_uint_attr (dev, &i->ue_noinfo_count, "ue_noinfo_count") < 0)
-        return (-1);
+    mc = &edac->mcs[edac->mc_by_num[num]];
 
-    get_sysfs_string_attr (dev, i->mc_name, sizeof (i->mc_name), "mc_name");
+    if ((mc->dimm_index == NULL) || (nlayers != mc->nlayers))
+        return (NULL);
 
-    if (*(p = i->mc_name + strlen (i->mc_name) - 1) == '\n')
-        *p = '\0';
+    for (i = 0; i < nlayers; i++) {
+        if (  (location[i] < 0)
+           || ((unsigned int) location[i] >= mc->layer_size[i]))
+            return (NULL);
+        idx = idx * mc->layer_size[i] + location[i];
+    }
 
-    return (0);
-}
+    if (mc->dimm_index[idx] < 0)
+        return (NULL);
 
-static void edac_mc_destroy (struct edac_mc *mc)
-{
-    if (mc == NULL)
-        return;
-    if (mc->csrow_list)
-        dlist_destroy (mc->csrow_list);
-    free (mc);
-    return;
+    return (&edac->dimms[mc->dimm_index[idx]]);
 }
 
-static struct edac_csrow * 
-edac_csrow_create (edac_mc *mc, struct sysfs_device *dev)
+edac_layout * edac_layout_create (edac_handle *edac)
 {
-    struct edac_csrow *csrow = NULL;
-
-    if (strncmp ("csrow", dev->name, 5) != 0)
-        return NULL;
+    struct edac_layout_info *info;
+    struct edac_layout *     l;
+    struct edac_mc *         first = NULL;
+    unsigned int             i;
+    int                      j;
 
-    if ((csrow = malloc (sizeof (*csrow))) == NULL)
-        return NULL;
+    if (edac == NULL)
+        return (NULL);
 
-    memset (csrow, 0, sizeof (*csrow));
+    if (!edac->initialized && (edac_handle_init (edac) < 0))
+        return (NULL);
 
-    csrow->dev = dev;
-    csrow->mc  = mc;
+    if (!edac_detail_ready (edac))
+        return (NULL);
 
-    edac_csrow_refresh (csrow);
-    return (csrow);
-}
+    if (!(l = calloc (1, sizeof (*l)))) {
+        edac->error_num = EDAC_OUT_OF_MEMORY;
+        return (NULL);
+    }
 
-static void edac_csrow_destroy (struct edac_csrow *csrow)
-{
-    free (csrow);
-    return;
-}
+    l->edac =       edac;
+    l->layout_gen = edac->layout_gen;
+    info =          &l->info;
 
+    strncpy (info->layer[0], "mc", EDAC_LAYER_NAME_LEN - 1);
+    info->layer_size[0] = edac->mc_by_num_size;
+    info->nlayers = 1;
 
-static struct edac_mc *
-edac_mc_create (edac_handle *edac, struct sysfs_device *dev)
-{
-    struct edac_mc *mc;
+    /*  Take layer names from the first MC with DIMMs, and size each
+     *   layer for the largest MC
+     */
+    for (i = 0; i < edac->nmcs; i++) {
+        struct edac_mc *mc = &edac->mcs[i];
 
-    if (dev->name[0] != 'm' || dev->name[1] != 'c')
-        return NULL;
+        if (mc->ndimms == 0)
+            continue;
+        if (first == NULL) {
+            first = mc;
+            info->nlayers = mc->nlayers + 1;
+            for (j = 0; j < mc->nlayers; j++)
+                memcpy (info->layer[j + 1], mc->layer[j], 
+                        EDAC_LAYER_NAME_LEN);
+        }
+        else if (mc->nlayers != first->nlayers) {
+            edac->error_num = EDAC_ERROR;
+            edac_layout_destroy (l);
+            return (NULL);
+        }
+        for (j = 0; j < mc->nlayers; j++) {
+            if (mc->layer_size[j] > info->layer_size[j + 1])
+                info->layer_size[j + 1] = mc->layer_size[j];
+        }
+    }
 
-    if ((mc = malloc (sizeof (*mc))) == NULL)
-        return NULL;
+    if (first == NULL)
+        return (l);
 
-    memset (mc,  0, sizeof (*mc) );
+    info->ncells = 1;
+    for (j = 0; j < info->nlayers; j++)
+        info->ncells *= info->layer_size[j];
 
-    mc->dev = dev;
-    mc->edac = edac;
+    if (!(l->cell = malloc (info->ncells * sizeof (*l->cell)))) {
+        edac->error_num = EDAC_OUT_OF_MEMORY;
+        edac_layout_destroy (l);
+        return (NULL);
+    }
 
-    strncpy (mc->info.id, dev->name, sizeof (mc->info.id) - 1);
+    for (i = 0; i < info->ncells; i++)
+        l->cell[i] = -1;
 
-    if (edac_mc_refresh (mc) < 0)
-        goto error_out;
+    for (i = 0; i < edac->ndimms; i++) {
+        const struct edac_dimm *dimm = &edac->dimms[i];
+        unsigned int            idx = edac->mcs[dimm->mc].num;
 
-    mc->csrow_list = dlist_new_with_delete (sizeof (struct edac_csrow), 
-                                             (del_f) edac_csrow_destroy);
+        for (j = 1; j < info->nlayers; j++)
+            idx = idx * info->layer_size[j] + dimm->location[j - 1];
 
-    if (dev->children) {
-        struct sysfs_device *child = NULL;
-        dlist_for_each_data (dev->children, child, struct sysfs_device) {
-            struct edac_csrow *csrow;
-            if ((csrow = edac_csrow_create (mc, child))) {
-                dlist_push (mc->csrow_list, csrow);
-            }
-        }
+        l->cell[idx] = i;
+        info->ndimms++;
     }
 
-    edac_dlist_reset (mc->csrow_list);
-
-    return (mc);
-
-   error_out:
-    edac_mc_destroy (mc);
-    return NULL;
-
+    return (l);
 }
 
-static int 
-get_sysfs_uint_attr (struct sysfs_device *dev, unsigned int *valp, 
-        const char *format, ...)
+void edac_layout_destroy (edac_layout *l)
 {
-    char *                    p;
-    va_list                   ap;
-    char                      buf[1024];
-    struct sysfs_attribute *  attr;
-    int                       n;
-
-    memset (buf, '\0', sizeof (buf));
-
-    va_start (ap, format);
-    n = vsnprintf (buf, sizeof (buf) - 1, format, ap); 
-    va_end (ap);
+    if (l == NULL)
+        return;
+    free (l->cell);
+    free (l);
+}
 
-    if ((n < 0) || (n > sizeof (buf)))
-        return (-1);
- 
-    if (!(attr = sysfs_get_device_attr (dev, buf))) {
+int edac_layout_get_info (edac_layout *l, struct edac_layout_info *info)
+{
+    if ((l == NULL) || (info == NULL))
         return (-1);
-    }
 
-    *valp = strtoul (attr->value, &p, 10);
-    /*
-     * XXX: Check for valid number?
-     */
+    *info = l->info;
 
     return (0);
-
 }
 
-static int
-get_sysfs_string_attr (struct sysfs_device *dev, char *dest, int len,
-                      const char *format, ...)
+int edac_layout_cells (edac_layout *l, struct edac_layout_cell *cells,
+        unsigned int len)
 {
-    va_list                   ap;
-    char                      buf[1024];
-    char *                    nl;
-    struct sysfs_attribute *  attr;
-    int                       n;
-
-    memset (buf, '\0', sizeof (buf));
+    const struct edac_store *s;
+    unsigned int             i;
 
-    va_start (ap, format);
-    n = vsnprintf (buf, sizeof (buf) - 1, format, ap); 
-    va_end (ap);
-
-    if ((n < 0) || (n > sizeof (buf)))
+    if (l == NULL)
         return (-1);
 
-    if (!(attr = sysfs_get_device_attr (dev, buf))) {
+    if (l->layout_gen != l->edac->layout_gen) {
+        l->edac->error_num = EDAC_ERROR;
         return (-1);
     }
 
-    /*  Terminate any final newline 
-     */
-    if ((nl = strrchr (attr->value, '\n')))
-        len = (nl - attr->value) + 1;
+    s = &l->edac->store;
 
+    for (i = 0; (i < l->info.ncells) && (i < len); i++) {
+        int d = l->cell[i];
 
-    memset (dest, '\0', len);
-    strncpy (dest, attr->value, len - 1);
-    return (0);
+        if (d < 0) {
+            memset (&cells[i], 0, sizeof (cells[i]));
+            continue;
+        }
+        cells[i].dimm =     1;
+        cells[i].size_mb =  l->edac->dimms[d].size_mb;
+        cells[i].ce_count = s->dimm_ce[d];
+        cells[i].ue_count = s->dimm_ue[d];
+    }
+
+    return (l->info.ncells);
 }
 
-static struct dlist *
-mc_list_create (edac_handle *edac)
+edac_dimm * edac_layout_dimm (edac_layout *l, unsigned int cell)
 {
-    struct dlist *l;
-    struct sysfs_device *dev;
-    size_t size = sizeof (struct edac_mc);
+    if (  (l == NULL) || (cell >= l->info.ncells)
+       || (l->layout_gen != l->edac->layout_gen) || (l->cell[cell] < 0))
+        return (NULL);
 
-    if (!(l = dlist_new_with_delete (size, (del_f) edac_mc_destroy)))
-        return NULL;
+    return (&l->edac->dimms[l->cell[cell]]);
+}
+
+
+const char * edac_mc_id (const edac_mc *mc)
+{
+    return (mc->id);
+}
+
+const char * edac_mc_name (const edac_mc *mc)
+{
+    return (mc->mc_name);
+}
+
+unsigned int edac_mc_size_mb (const edac_mc *mc)
+{
+    return (mc->size_mb);
+}
+
+unsigned int edac_mc_ce_count (const edac_mc *mc)
+{
+    return (mc->edac->store.mc_ce[mc - mc->edac->mcs]);
+}
+
+unsigned int edac_mc_ue_count (const edac_mc *mc)
+{
+    return (mc->edac->store.mc_ue[mc - mc->edac->mcs]);
+}
+
+unsigned int edac_mc_ce_noinfo_count (const edac_mc *mc)
+{
+    return (mc->edac->store.mc_ce_noinfo[mc - mc->edac->mcs]);
+}
+
+unsigned int edac_mc_ue_noinfo_count (const edac_mc *mc)
+{
+    return (mc->edac->store.mc_ue_noinfo[mc - mc->edac->mcs]);
+}
+
+unsigned int edac_mc_csrow_count (const edac_mc *mc)
+{
+    if (!edac_detail_ready (mc->edac))
+        return (0);
+    return (mc->ncsrows);
+}
+
+const char * edac_csrow_id (const edac_csrow *csrow)
+{
+    return (csrow->id);
+}
+
+unsigned int edac_csrow_size_mb (const edac_csrow *csrow)
+{
+    return (csrow->size_mb);
+}
+
+unsigned int edac_csrow_ce_count (const edac_csrow *csrow)
+{
+    return (csrow->edac->store.csrow_ce[csrow - csrow->edac->csrows]);
+}
+
+unsigned int edac_csrow_ue_count (const edac_csrow *csrow)
+{
+    return (csrow->edac->store.csrow_ue[csrow - csrow->edac->csrows]);
+}
+
+static inline const struct edac_chan_info *
+csrow_channel (const edac_csrow *csrow, int ch)
+{
+    if ((ch < 0) || ((unsigned int) ch >= csrow->nchannels))
+        return (NULL);
+    return (&csrow->edac->channels[csrow->chan_first + ch]);
+}
+
+int edac_channel_valid (const edac_csrow *csrow, int ch)
+{
+    const struct edac_chan_info *c = csrow_channel (csrow, ch);
+    return (c ? c->valid : 0);
+}
+
+unsigned int edac_channel_ce_count (const edac_csrow *csrow, int ch)
+{
+    if (!csrow_channel (csrow, ch))
+        return (0);
+    return (csrow->edac->store.chan_ce[csrow->chan_first + ch]);
+}
+
+const char * edac_channel_label (const edac_csrow *csrow, int ch)
+{
+    const struct edac_chan_info *c = csrow_channel (csrow, ch);
+    if (!c || !c->valid || !c->dimm_label_valid)
+        return (NULL);
+    return (c->dimm_label);
+}
+
+const char * edac_dimm_id (const edac_dimm *dimm)
+{
+    return (dimm->id);
+}
+
+const char * edac_dimm_label (const edac_dimm *dimm)
+{
+    return (dimm->dimm_label_valid ? dimm->dimm_label : NULL);
+}
+
+unsigned int edac_dimm_size_mb (const edac_dimm *dimm)
+{
+    return (dimm->size_mb);
+}
+
+unsigned int edac_dimm_ce_count (const edac_dimm *dimm)
+{
+    return (dimm->edac->store.dimm_ce[dimm - dimm->edac->dimms]);
+}
+
+unsigned int edac_dimm_ue_count (const edac_dimm *dimm)
+{
+    return (dimm->edac->store.dimm_ue[dimm - dimm->edac->dimms]);
+}
+
+const int * edac_dimm_location (const edac_dimm *dimm, int *nlayers)
+{
+    if (nlayers)
+        *nlayers = dimm->edac->mcs[dimm->mc].nlayers;
+    return (dimm->location);
+}
+
+edac_snapshot * edac_snapshot_take (edac_handle *edac)
+{
+    struct edac_snapshot *snap;
+    struct edac_store *   s;
+    uint64_t *            v;
+    size_t                size;
+
+    if (edac == NULL)
+        return (NULL);
+
+    if (!edac->initialized && (edac_handle_init (edac) < 0))
+        return (NULL);
+
+    if (!edac_detail_ready (edac))
+        return (NULL);
+
+    s = &edac->store;
+    size = s->nvalues * sizeof (uint64_t);
+
+    if (!(snap = malloc (sizeof (*snap) + size))) {
+        edac->error_num = EDAC_OUT_OF_MEMORY;
+        return (NULL);
+    }
+
+    v = (uint64_t *) (snap + 1);
+    memcpy (v, s->values, size);
+
+    snap->refs = 1;
+    snap->totals = edac->totals;
+    snap->topo = edac->topo;
+    __sync_fetch_and_add (&snap->topo->refs, 1);
+
+    /*  Same section layout as the handle, but pointing into our copy
+     */
+    snap->store.values =       v;
+    snap->store.nvalues =      s->nvalues;
+    snap->store.mc_ce =        v + (s->mc_ce - s->values);
+    snap->store.mc_ue =        v + (s->mc_ue - s->values);
+    snap->store.mc_ce_noinfo = v + (s->mc_ce_noinfo - s->values);
+    snap->store.mc_ue_noinfo = v + (s->mc_ue_noinfo - s->values);
+    snap->store.csrow_ce =     v + (s->csrow_ce - s->values);
+    snap->store.csrow_ue =     v + (s->csrow_ue - s->values);
+    snap->store.chan_ce =      v + (s->chan_ce - s->values);
+    snap->store.dimm_ce =      v + (s->dimm_ce - s->values);
+    snap->store.dimm_ue =      v + (s->dimm_ue - s->values);
+    snap->store.pci_parity =   v + (s->pci_parity - s->values);
+
+    return (snap);
+}
+
+void edac_snapshot_release (edac_snapshot *snap)
+{
+    if (snap == NULL)
+        return;
+
+    if (__sync_sub_and_fetch (&snap->refs, 1) == 0) {
+        topology_release (snap->topo);
+        free (snap);
+    }
+}
+
+void edac_snapshot_destroy (edac_snapshot *snap)
+{
+    edac_snapshot_release (snap);
+}
+
+int edac_handle_publish (edac_handle *edac)
+{
+    edac_snapshot *snap;
+    edac_snapshot *old;
+
+    if (edac_handle_refresh (edac) < 0)
+        return (-1);
+
+    if (!(snap = edac_snapshot_take (edac)))
+        return (-1);
+
+    /*  __sync_lock_test_and_set () is only an acquire barrier, so
+     *   make sure the snapshot is complete before it can be seen.
+     */
+    __sync_synchronize ();
+    old = __sync_lock_test_and_set (&edac->published, snap);
+
+    /*  Grace period: a reader in edac_snapshot_acquire () may have
+     *   loaded the old pointer but not yet taken its reference. Once
+     *   no reader is inside acquire, every later reader sees `snap'.
+     */
+    while (__sync_fetch_and_add (&edac->acquiring, 0))
+        sched_yield ();
+
+    edac_snapshot_release (old);
+
+    return (0);
+}
+
+edac_snapshot * edac_snapshot_acquire (edac_handle *edac)
+{
+    edac_snapshot *snap;
+
+    if (edac == NULL)
+        return (NULL);
+
+    __sync_fetch_and_add (&edac->acquiring, 1);
+    snap = __sync_val_compare_and_swap (&edac->published, NULL, NULL);
+    if (snap)
+        __sync_fetch_and_add (&snap->refs, 1);
+    __sync_fetch_and_sub (&edac->acquiring, 1);
+
+    return (snap);
+}
+
+unsigned int edac_snapshot_mc_count (const edac_snapshot *snap)
+{
+    return (snap->topo->nmcs);
+}
+
+int edac_snapshot_mc_info (const edac_snapshot *snap, unsigned int mc,
+        struct edac_mc_info *info)
+{
+    if (!info || (mc >= snap->topo->nmcs))
+        return (-1);
+
+    mc_info_fill (snap->topo, &snap->store, mc, info);
+
+    return (0);
+}
+
+unsigned int edac_snapshot_csrow_count (const edac_snapshot *snap, 
+        unsigned int mc)
+{
+    if (mc >= snap->topo->nmcs)
+        return (0);
+    return (snap->topo->mcs[mc].ncsrows);
+}
+
+int edac_snapshot_csrow_info (const edac_snapshot *snap, unsigned int mc,
+        unsigned int csrow, struct edac_csrow_info *info)
+{
+    const struct edac_topology *t = snap->topo;
+
+    if (!info || (mc >= t->nmcs) || (csrow >= t->mcs[mc].ncsrows))
+        return (-1);
+
+    csrow_info_fill (t, &snap->store, t->mcs[mc].csrow_first + csrow, info);
+
+    return (0);
+}
+
+unsigned int edac_snapshot_dimm_count (const edac_snapshot *snap, 
+        unsigned int mc)
+{
+    if (mc >= snap->topo->nmcs)
+        return (0);
+    return (snap->topo->mcs[mc].ndimms);
+}
+
+int edac_snapshot_dimm_info (const edac_snapshot *snap, unsigned int mc,
+        unsigned int dimm, struct edac_dimm_info *info)
+{
+    const struct edac_topology *t = snap->topo;
+
+    if (!info || (mc >= t->nmcs) || (dimm >= t->mcs[mc].ndimms))
+        return (-1);
+
+    dimm_info_fill (t, &snap->store, t->mcs[mc].dimm_first + dimm, info);
+
+    return (0);
+}
+
+int edac_snapshot_totals (const edac_snapshot *snap, struct edac_totals *tot)
+{
+    if (!snap || !tot)
+        return (-1);
+
+    *tot = snap->totals;
+
+    return (0);
+}
+
+int edac_snapshot_diff (edac_snapshot *prev, edac_snapshot *cur,
+        struct edac_delta *deltas, int len)
+{
+    unsigned int i;
+    int          n = 0;
+
+    if (!prev || !cur || (prev->topo != cur->topo)
+       || (prev->store.nvalues != cur->store.nvalues))
+        return (-1);
+
+    for (i = 0; i < cur->store.nvalues; i++) {
+        uint64_t old = prev->store.values[i];
+        uint64_t new = cur->store.values[i];
+
+        if (old == new)
+            continue;
+        if (n < len) {
+            deltas[n].counter =   i;
+            deltas[n].old_count = old;
+            deltas[n].new_count = new;
+        }
+        n++;
+    }
+
+    return (n);
+}
+
+int edac_counter_location (edac_handle *edac, unsigned int counter,
+        struct edac_location *loc)
+{
+    struct edac_store *s;
+    uint64_t *         p;
+    unsigned int       i;
+    unsigned int       n;
+
+    if (!edac || !loc || !edac_detail_ready (edac)
+       || (counter >= edac->store.nvalues))
+        return (-1);
+
+    memset (loc, 0, sizeof (*loc));
+    loc->channel = -1;
+
+    s = &edac->store;
+    p = &s->values[counter];
+
+    if (p < s->csrow_ce) {
+        n = (p - s->mc_ce) % edac->nmcs;
+        loc->type = EDAC_COUNTER_MC_CE + (p - s->mc_ce) / edac->nmcs;
+        snprintf (loc->mc_id, sizeof (loc->mc_id), "%s", edac->mcs[n].id);
+    }
+    else if (p < s->chan_ce) {
+        n = (p - s->csrow_ce) % edac->ncsrows;
+        loc->type = EDAC_COUNTER_CSROW_CE + (p - s->csrow_ce) / edac->ncsrows;
+        snprintf (loc->id, sizeof (loc->id), "%s", edac->csrows[n].id);
+        for (i = 0; i < edac->nmcs; i++) {
+            struct edac_mc *mc = &edac->mcs[i];
+            if (n >= mc->csrow_first && n < mc->csrow_first + mc->ncsrows)
+                snprintf (loc->mc_id, sizeof (loc->mc_id), "%s", mc->id);
+        }
+    }
+    else if (p < s->dimm_ce) {
+        n = p - s->chan_ce;
+        loc->type = EDAC_COUNTER_CHANNEL_CE;
+        for (i = 0; i < edac->ncsrows; i++) {
+            struct edac_csrow *csrow = &edac->csrows[i];
+            if (n >= csrow->chan_first 
+               && n < csrow->chan_first + csrow->nchannels) {
+                /*  Fill in mc_id and id from the csrow counter first  */
+                edac_counter_location (edac, &s->csrow_ce[i] - s->values, loc);
+                loc->type = EDAC_COUNTER_CHANNEL_CE;
+                loc->channel = n - csrow->chan_first;
+                break;
+            }
+        }
+    }
+    else if (p < s->pci_parity) {
+        n = (p - s->dimm_ce) % edac->ndimms;
+        loc->type = EDAC_COUNTER_DIMM_CE + (p - s->dimm_ce) / edac->ndimms;
+        snprintf (loc->id, sizeof (loc->id), "%s", edac->dimms[n].id);
+        snprintf (loc->mc_id, sizeof (loc->mc_id), "%s",
+                  edac->mcs[edac->dimms[n].mc].id);
+    }
+    else
+        loc->type = EDAC_COUNTER_PCI_PARITY;
+
+    return (0);
+}
+
+edac_rate * edac_rate_create (edac_handle *edac, 
+        const unsigned int *windows, unsigned int nwindows)
+{
+    static const unsigned int defaults[] = { 60, 3600, 86400 };
+    struct edac_rate *        r;
+    unsigned int              n;
+    unsigned int              i;
+
+    if ((edac == NULL) || (windows && (nwindows == 0)))
+        return (NULL);
+
+    if (!edac->initialized && (edac_handle_init (edac) < 0))
+        return (NULL);
+
+    /*  Size the tracker for csrow, channel and DIMM counters too,
+     *   so that edac_rate_update () need not see the store grow.
+     */
+    if (!edac_detail_ready (edac))
+        return (NULL);
+
+    if (windows == NULL) {
+        windows =  defaults;
+        nwindows = sizeof (defaults) / sizeof (defaults[0]);
+    }
+
+    if (!(r = calloc (1, sizeof (*r))))
+        goto nomem;
+
+    r->edac =       edac;
+    r->layout_gen = edac->layout_gen;
+    r->nvalues =    n = edac->store.nvalues;
+    r->nwindows =   nwindows;
+
+    if (  !(r->w = calloc (nwindows, sizeof (*r->w)))
+       || !(r->prev = calloc (n, sizeof (*r->prev))))
+        goto nomem;
+
+    for (i = 0; i < nwindows; i++) {
+        struct rate_window *w = &r->w[i];
+
+        if (windows[i] == 0) {
+            edac_rate_destroy (r);
+            return (NULL);
+        }
+
+        w->length = windows[i];
+        w->width =  (double) windows[i] / EDAC_RATE_BUCKETS;
+
+        if (  !(w->buckets = calloc (EDAC_RATE_BUCKETS * n, 
+                                     sizeof (*w->buckets)))
+           || !(w->sum = calloc (n, sizeof (*w->sum)))
+           || !(w->threshold = calloc (n, sizeof (*w->threshold)))
+           || !(w->over = calloc (n, sizeof (*w->over))))
+            goto nomem;
+    }
+
+    return (r);
+
+nomem:
+    edac->error_num = EDAC_OUT_OF_MEMORY;
+    edac_rate_destroy (r);
+    return (NULL);
+}
+
+void edac_rate_destroy (edac_rate *r)
+{
+    unsigned int i;
+
+    if (r == NULL)
+        return;
+
+    for (i = 0; r->w && (i < r->nwindows); i++) {
+        free (r->w[i].buckets);
+        free (r->w[i].sum);
+        free (r->w[i].threshold);
+        free (r->w[i].over);
+    }
+    free (r->w);
+    free (r->prev);
+    free (r->alerts);
+    free (r);
+}
+
+int edac_rate_update (edac_rate *r)
+{
+    const uint64_t *values;
+    struct timespec ts;
+    double          now;
+    unsigned int    i;
+    unsigned int    j;
+
+    if (r == NULL)
+        return (-1);
+
+    if (  (r->layout_gen != r->edac->layout_gen)
+       || (r->nvalues != r->edac->store.nvalues)) {
+        r->edac->error_num = EDAC_ERROR;
+        return (-1);
+    }
+
+    values = r->edac->store.values;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    now = ts.tv_sec + ts.tv_nsec / 1e9;
+
+    r->nalerts = 0;
+
+    if (!r->started) {
+        memcpy (r->prev, values, r->nvalues * sizeof (*values));
+        r->start =   now;
+        r->now =     now;
+        r->started = 1;
+        return (0);
+    }
+
+    r->now = now;
+
+    for (j = 0; j < r->nwindows; j++)
+        rate_window_advance (r, &r->w[j], now);
+
+    for (i = 0; i < r->nvalues; i++) {
+        uint64_t v = values[i];
+        uint64_t d = (v >= r->prev[i]) ? v - r->prev[i] : v;
+
+        r->prev[i] = v;
+
+        for (j = 0; j < r->nwindows; j++) {
+            struct rate_window *w = &r->w[j];
+
+            if (d) {
+                w->buckets[w->cur * r->nvalues + i] += d;
+                w->sum[i] += d;
+            }
+
+            if (w->threshold[i] == 0)
+                continue;
+
+            if (w->sum[i] < w->threshold[i])
+                w->over[i] = 0;
+            else if (!w->over[i]) {
+                w->over[i] = 1;
+                if (rate_alert_add (r, i, j) < 0)
+                    return (-1);
+            }
+        }
+    }
+
+    return (r->nalerts);
+}
+
+int edac_rate_set_threshold (edac_rate *r, unsigned int counter,
+        unsigned int window, unsigned long long threshold)
+{
+    struct rate_window *w;
+    unsigned int        i;
+
+    if (  (r == NULL) || (window >= r->nwindows)
+       || ((counter != EDAC_RATE_ALL) && (counter >= r->nvalues)))
+        return (-1);
+
+    w = &r->w[window];
+
+    for (i = 0; i < r->nvalues; i++) {
+        if ((counter == EDAC_RATE_ALL) || (counter == i)) {
+            w->threshold[i] = threshold;
+            w->over[i] = threshold && (w->sum[i] >= threshold);
+        }
+    }
+
+    return (0);
+}
+
+int edac_rate_get (edac_rate *r, unsigned int counter, 
+        unsigned int window, struct edac_rate_info *info)
+{
+    struct rate_window *w;
+
+    if (  (r == NULL) || (info == NULL) 
+       || (window >= r->nwindows) || (counter >= r->nvalues))
+        return (-1);
+
+    w = &r->w[window];
+
+    info->window =  w->length;
+    info->count =   w->sum[counter];
+    info->seconds = r->now - r->start;
+    if (info->seconds > w->length)
+        info->seconds = w->length;
+    info->rate = (info->seconds > 0.0) ? info->count / info->seconds : 0.0;
+
+    return (0);
+}
+
+int edac_rate_alerts (edac_rate *r, struct edac_rate_alert *alerts, 
+        int len)
+{
+    if (r == NULL)
+        return (-1);
+
+    if (alerts && (len > 0))
+        memcpy (alerts, r->alerts, 
+                ((r->nalerts < (unsigned int) len) ? r->nalerts : 
+                 (unsigned int) len) * sizeof (*alerts));
+
+    return (r->nalerts);
+}
+
+edac_history * edac_history_create (edac_handle *edac, const char *path,
+        unsigned int nrecords)
+{
+    struct edac_history *h;
+
+    if ((edac == NULL) || (path == NULL)) {
+        errno = EINVAL;
+        return (NULL);
+    }
+
+    if (!edac->initialized && (edac_handle_init (edac) < 0)) {
+        errno = EIO;
+        return (NULL);
+    }
+
+    if (!(h = calloc (1, sizeof (*h))) || !(h->path = strdup (path))) {
+        free (h);
+        errno = ENOMEM;
+        return (NULL);
+    }
+
+    h->edac =     edac;
+    h->nrecords = nrecords;
+
+    if (history_file_open (h) < 0) {
+        edac_history_close (h);
+        return (NULL);
+    }
+
+    return (h);
+}
+
+edac_history * edac_history_open (const char *path)
+{
+    struct edac_history *h;
+
+    if (!(h = calloc (1, sizeof (*h)))) {
+        errno = ENOMEM;
+        return (NULL);
+    }
+
+    if (  !(h->file = edac_histfile_open (path))
+       || !(h->rec = malloc (edac_histfile_header (h->file)->record_size))) {
+        edac_history_close (h);
+        return (NULL);
+    }
+
+    return (h);
+}
+
+void edac_history_close (edac_history *h)
+{
+    if (h == NULL)
+        return;
+
+    edac_histfile_close (h->file);
+    free (h->rec);
+    free (h->path);
+    free (h);
+}
+
+int edac_history_append (edac_history *h)
+{
+    struct timespec ts;
+
+    if ((h == NULL) || (h->edac == NULL)) {
+        errno = EINVAL;
+        return (-1);
+    }
+
+    /*  The counters moved if the handle was reloaded, but a driver 
+     *   reload usually brings back the same ones, in which case 
+     *   history_file_open () keeps the existing records.
+     */
+    if ((h->layout_gen != h->edac->layout_gen) && (history_file_open (h) < 0))
+        return (-1);
+
+    clock_gettime (CLOCK_REALTIME, &ts);
+    edac_histfile_append (h->file, ts.tv_sec, h->edac->store.values);
+
+    return (0);
+}
+
+int edac_history_info (edac_history *h, struct edac_history_info *info)
+{
+    const struct edac_histfile_header *hdr;
+
+    if ((h == NULL) || (info == NULL))
+        return (-1);
+
+    hdr = edac_histfile_header (h->file);
+
+    info->next =     edac_histfile_next (h->file);
+    info->first =    edac_histfile_first (h->file);
+    info->nrecords = hdr->nrecords;
+    info->nvalues =  hdr->nvalues;
+    info->created =  hdr->created;
+
+    return (0);
+}
+
+unsigned long long edac_history_find (edac_history *h, time_t t)
+{
+    uint64_t lo;
+    uint64_t hi;
+    int64_t  rt;
+
+    if (h == NULL)
+        return (0);
+
+    hi = edac_histfile_next (h->file);
+    lo = edac_histfile_first (h->file);
+
+    /*  Records overwritten during the search read as too old
+     */
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if ((edac_histfile_time (h->file, mid, &rt) < 0) || (rt < t))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return (lo);
+}
+
+int edac_history_read (edac_history *h, unsigned long long rec, time_t *t,
+        unsigned long long *values, unsigned int len)
+{
+    unsigned int n;
+    unsigned int i;
+
+    if ((h == NULL) || (h->rec == NULL))
+        return (-1);
+
+    if (edac_histfile_read (h->file, rec, h->rec) < 0)
+        return (-1);
+
+    n = edac_histfile_header (h->file)->nvalues;
+
+    if (t)
+        *t = h->rec->time;
+
+    for (i = 0; values && (i < n) && (i < len); i++)
+        values[i] = h->rec->values[i];
+
+    return (n);
+}
+
+int edac_history_location (edac_history *h, unsigned int counter,
+        struct edac_location *loc, char *label, int len)
+{
+    const struct edac_histfile_location *l;
+
+    if (  (h == NULL) 
+       || (counter >= edac_histfile_header (h->file)->nvalues))
+        return (-1);
+
+    l = &edac_histfile_locations (h->file)[counter];
+
+    if (loc) {
+        memset (loc, 0, sizeof (*loc));
+        loc->type =    l->type;
+        loc->channel = l->channel;
+        snprintf (loc->mc_id, sizeof (loc->mc_id), "%s", l->mc_id);
+        snprintf (loc->id, sizeof (loc->id), "%s", l->id);
+    }
+
+    if (label && (len > 0))
+        snprintf (label, len, "%.*s", EDAC_LABEL_LEN, l->label);
+
+    return (0);
+}
+
+
+/*****************************************************************************
+ *  Private Functions
+ *****************************************************************************/
+
+/*  Copy the label of the channel or DIMM counted by `counter' of
+ *   `edac' into `buf', or "" if it has none.
+ */
+static void
+counter_label (edac_handle *edac, unsigned int counter, char *buf, int len)
+{
+    struct edac_store *s = &edac->store;
+    uint64_t *         p = &s->values[counter];
+
+    buf[0] = '\0';
+
+    if ((p >= s->chan_ce) && (p < s->dimm_ce)) {
+        struct edac_chan_info *ch = &edac->channels[p - s->chan_ce];
+        if (ch->dimm_label_valid)
+            snprintf (buf, len, "%s", ch->dimm_label);
+    }
+    else if ((p >= s->dimm_ce) && (p < s->pci_parity)) {
+        struct edac_dimm *d = &edac->dimms[(p - s->dimm_ce) % edac->ndimms];
+        if (d->dimm_label_valid)
+            snprintf (buf, len, "%s", d->dimm_label);
+    }
+}
+
+/*  (Re)open the history file of `h' for the current counters of its
+ *   handle.
+ */
+static int
+history_file_open (struct edac_history *h)
+{
+    struct edac_histfile_location *locs;
+    struct edac_histfile_record *  rec;
+    edac_histfile *                f;
+    edac_handle *                  edac = h->edac;
+    struct edac_location           loc;
+    unsigned int                   n;
+    unsigned int                   i;
+
+    if (!edac_detail_ready (edac)) {
+        errno = EIO;
+        return (-1);
+    }
+
+    n = edac->store.nvalues;
+
+    if (!(locs = calloc (n ? n : 1, sizeof (*locs)))) {
+        errno = ENOMEM;
+        return (-1);
+    }
+
+    for (i = 0; i < n; i++) {
+        edac_counter_location (edac, i, &loc);
+        locs[i].type =    loc.type;
+        locs[i].channel = loc.channel;
+        memcpy (locs[i].mc_id, loc.mc_id, sizeof (locs[i].mc_id));
+        memcpy (locs[i].id, loc.id, sizeof (locs[i].id));
+        counter_label (edac, i, locs[i].label, sizeof (locs[i].label));
+    }
+
+    /*  Release the old file first, as only one writer may hold it
+     */
+    edac_histfile_close (h->file);
+    h->file = NULL;
+
+    f = edac_histfile_create (h->path, h->nrecords, n, locs);
+    free (locs);
+
+    if (f == NULL)
+        return (-1);
+
+    if (!(rec = realloc (h->rec, edac_histfile_header (f)->record_size))) {
+        edac_histfile_close (f);
+        errno = ENOMEM;
+        return (-1);
+    }
+
+    h->rec =        rec;
+    h->file =       f;
+    h->layout_gen = edac->layout_gen;
+
+    return (0);
+}
+
+/*  Move window `w' of `r' forward to time `now', dropping the errors
+ *   of every bucket which falls out of the window. A bucket is reused
+ *   as soon as its slice of time has passed, so this costs one pass
+ *   over the counters per bucket boundary crossed, and at most one
+ *   clear of the whole window.
+ */
+static void
+rate_window_advance (struct edac_rate *r, struct rate_window *w, double now)
+{
+    uint64_t     epoch = (uint64_t) ((now - r->start) / w->width);
+    unsigned int n = r->nvalues;
+    unsigned int i;
+
+    if (epoch <= w->epoch)
+        return;
+
+    if (epoch - w->epoch >= EDAC_RATE_BUCKETS) {
+        memset (w->buckets, 0, EDAC_RATE_BUCKETS * n * sizeof (*w->buckets));
+        memset (w->sum, 0, n * sizeof (*w->sum));
+    }
+    else {
+        while (w->epoch < epoch) {
+            uint32_t *b = &w->buckets[((w->epoch + 1) % EDAC_RATE_BUCKETS) * n];
+            for (i = 0; i < n; i++)
+                w->sum[i] -= b[i];
+            memset (b, 0, n * sizeof (*b));
+            w->epoch++;
+        }
+    }
+
+    w->epoch = epoch;
+    w->cur =   epoch % EDAC_RATE_BUCKETS;
+}
+
+/*  Record an alert for `counter' in window `window' of `r'
+ */
+static int
+rate_alert_add (struct edac_rate *r, unsigned int counter, 
+        unsigned int window)
+{
+    struct edac_rate_alert *a;
+
+    if (r->nalerts == r->alerts_size) {
+        unsigned int size = r->alerts_size ? 2 * r->alerts_size : 16;
+        if (!(a = realloc (r->alerts, size * sizeof (*a)))) {
+            r->edac->error_num = EDAC_OUT_OF_MEMORY;
+            return (-1);
+        }
+        r->alerts =      a;
+        r->alerts_size = size;
+    }
+
+    a = &r->alerts[r->nalerts++];
+    a->counter =   counter;
+    a->window =    window;
+    a->count =     r->w[window].sum[counter];
+    a->threshold = r->w[window].threshold[counter];
+
+    return (0);
+}
+
+static void
+mc_info_fill (const struct edac_topology *t, const struct edac_store *s,
+        unsigned int i, struct edac_mc_info *info)
+{
+    const struct edac_mc *mc = &t->mcs[i];
+
+    memcpy (info->id, mc->id, sizeof (info->id));
+    memcpy (info->mc_name, mc->mc_name, sizeof (info->mc_name));
+    info->size_mb =         mc->size_mb;
+    info->ce_count =        s->mc_ce[i];
+    info->ce_noinfo_count = s->mc_ce_noinfo[i];
+    info->ue_count =        s->mc_ue[i];
+    info->ue_noinfo_count = s->mc_ue_noinfo[i];
+}
+
+static void
+csrow_info_fill (const struct edac_topology *t, const struct edac_store *s,
+        unsigned int i, struct edac_csrow_info *info)
+{
+    const struct edac_csrow *csrow = &t->csrows[i];
+    unsigned int             n;
+
+    memset (info, 0, sizeof (*info));
+    memcpy (info->id, csrow->id, sizeof (info->id));
+    info->size_mb =  csrow->size_mb;
+    info->ce_count = s->csrow_ce[i];
+    info->ue_count = s->csrow_ue[i];
+
+    n = csrow->nchannels;
+    if (n > EDAC_MAX_CHANNELS)
+        n = EDAC_MAX_CHANNELS;
+
+    for (i = 0; i < n; i++) {
+        const struct edac_chan_info *c = &t->channels[csrow->chan_first + i];
+        struct edac_channel *        ch = &info->channel[i];
+
+        if (!c->valid)
+            continue;
+
+        ch->valid = 1;
+        ch->ce_count = s->chan_ce[csrow->chan_first + i];
+        ch->dimm_label_valid = c->dimm_label_valid;
+        memcpy (ch->dimm_label, c->dimm_label, sizeof (ch->dimm_label));
+    }
+}
+
+static void
+dimm_info_fill (const struct edac_topology *t, const struct edac_store *s,
+        unsigned int i, struct edac_dimm_info *info)
+{
+    const struct edac_dimm *dimm = &t->dimms[i];
+    const struct edac_mc *  mc = &t->mcs[dimm->mc];
+
+    memset (info, 0, sizeof (*info));
+    memcpy (info->id, dimm->id, sizeof (info->id));
+    memcpy (info->mc_id, mc->id, sizeof (info->mc_id));
+    memcpy (info->layer, mc->layer, sizeof (info->layer));
+    memcpy (info->location, dimm->location, sizeof (info->location));
+    info->nlayers =  mc->nlayers;
+    info->size_mb =  dimm->size_mb;
+    info->ce_count = s->dimm_ce[i];
+    info->ue_count = s->dimm_ue[i];
+    info->dimm_label_valid = dimm->dimm_label_valid;
+    memcpy (info->dimm_label, dimm->dimm_label, sizeof (info->dimm_label));
+}
+
+static void
+topology_capture (edac_handle *edac, struct edac_topology *t)
+{
+    t->mcs =            edac->mcs;
+    t->nmcs =           edac->nmcs;
+    t->csrows =         edac->csrows;
+    t->ncsrows =        edac->ncsrows;
+    t->channels =       edac->channels;
+    t->nchannels =      edac->nchannels;
+    t->dimms =          edac->dimms;
+    t->ndimms =         edac->ndimms;
+    t->mc_by_num =      edac->mc_by_num;
+    t->mc_by_num_size = edac->mc_by_num_size;
+}
+
+static void
+topology_free_arrays (struct edac_topology *t)
+{
+    unsigned int i;
+
+    for (i = 0; i < t->nmcs; i++) {
+        if (t->mcs[i].dimm_index)
+            free (t->mcs[i].dimm_index);
+    }
+    if (t->mcs)
+        free (t->mcs);
+    if (t->csrows)
+        free (t->csrows);
+    if (t->channels)
+        free (t->channels);
+    if (t->dimms)
+        free (t->dimms);
+    if (t->mc_by_num)
+        free (t->mc_by_num);
+}
+
+static void
+topology_release (struct edac_topology *t)
+{
+    if (t && (__sync_sub_and_fetch (&t->refs, 1) == 0)) {
+        topology_free_arrays (t);
+        free (t);
+    }
+}
+
+static inline void remove_newline (char *str)
+{
+    int len = strlen (str);
+
+    if (len && str[len - 1] == '\n')
+        str[len - 1] = '\0';
+}
+
+/*  Ensure array `*ptr' of `size' elements of `elsize' bytes has room
+ *   for `n' elements, growing by doubling.
+ */
+static int 
+array_reserve (void **ptr, unsigned int *size, unsigned int n, size_t elsize)
+{
+    unsigned int newsize;
+    void *       p;
+
+    if (n <= *size)
+        return (0);
+
+    newsize = *size ? *size : 8;
+    while (newsize < n)
+        newsize *= 2;
+
+    if (!(p = realloc (*ptr, newsize * elsize)))
+        return (-1);
+
+    *ptr = p;
+    *size = newsize;
+
+    return (0);
+}
+
+/*  Return the handle's worker pool, starting it on first use, or NULL
+ *   to scan and sample serially. The thread count comes from
+ *   edac_handle_set_threads (), else from EDAC_THREADS_ENV.
+ */
+static edac_pool *
+edac_handle_pool (edac_handle *edac)
+{
+    const char *env;
+
+    if (edac->pool)
+        return (edac->pool);
+
+    if ((edac->nthreads == 0) && (env = getenv (EDAC_THREADS_ENV)))
+        edac->nthreads = strtol (env, NULL, 10);
+
+    if (edac->nthreads > 1)
+        edac->pool = edac_pool_create (edac->nthreads);
+
+    /*  Don't retry a pool which could not be started
+     */
+    if (edac->pool == NULL)
+        edac->nthreads = 1;
+
+    return (edac->pool);
+}
+
+/*  MC directories found at init, and which of them could be read.
+ *   Each MC is read into edac->mcs at the index of its directory.
+ */
+struct mc_scan {
+    struct edac_handle *   edac;           /* handle being loaded            */
+    edac_sysfs_dir **      devs;           /* [ndevs] mcN directories        */
+    unsigned int           ndevs;          /* number of mcN directories      */
+    unsigned int           devs_size;      /* allocated size of devs         */
+    int *                  ok;             /* [ndevs] mcs[i] is valid        */
+};
+
+/*  State passed through edac_sysfs_dir_scan () while reading the
+ *   csrows, channels and DIMMs of one MC. Each MC is read into arrays
+ *   of its own, with indices local to those arrays, so that MCs can be
+ *   scanned in parallel. The arrays are merged into the handle in MC
+ *   order once all MCs are read.
+ */
+struct topology_builder {
+    struct edac_handle *   edac;           /* handle being loaded            */
+    struct edac_mc *       mc;             /* MC whose csrows/DIMMs are read */
+    struct edac_csrow *    csrows;         /* csrows of this MC              */
+    unsigned int           ncsrows;
+    unsigned int           csrows_size;    /* allocated size of csrows       */
+    struct edac_chan_info *channels;       /* channels of csrows above       */
+    unsigned int           nchannels;
+    unsigned int           channels_size;  /* allocated size of channels     */
+    struct edac_dimm *     dimms;          /* DIMMs of this MC               */
+    unsigned int           ndimms;
+    unsigned int           dimms_size;     /* allocated size of dimms        */
+    int                    rc;             /* result of mc_detail_scan ()    */
+};
+
+static int
+channel_probe (struct edac_chan_info *c, edac_sysfs_dir *dev, int id)
+{
+    unsigned int ce_count;
+    int          rc;
+
+    /* On some EDAC implementations ch1_* files may exist
+     *  even though nr_channels = 1. Returning an error here
+     *  should suffice to mark the channel invalid.
+     */
+
+    if (get_sysfs_uint_attr (dev, &ce_count, "ch%d_ce_count", id) < 0) 
+        return (-1);
+    rc = get_sysfs_string_attr ( dev, c->dimm_label, 
+                                 sizeof (c->dimm_label),
+                                 "ch%d_dimm_label", id );
+
+    if (  (rc >= 0) 
+       && (c->dimm_label[0] != '\0') 
+       && (c->dimm_label[0] != '\n') ) {
+        c->dimm_label_valid = 1;
+    }
+
+    remove_newline (c->dimm_label);
+
+    c->valid = 1;
+    return (0);
+}
+
+static int
+csrow_scan_one (edac_sysfs_dir *dev, void *arg)
+{
+    struct topology_builder *b = arg;
+    struct edac_csrow *      csrow;
+    struct edac_chan_info    chans[EDAC_MAX_CHANNELS];
+    unsigned int             nchans = 0;
+    unsigned int             i;
+
+    if (array_reserve ((void **) &b->csrows, &b->csrows_size,
+                       b->ncsrows + 1, sizeof (*csrow)) < 0)
+        return (-1);
+
+    csrow = &b->csrows[b->ncsrows];
+    memset (csrow, 0, sizeof (*csrow));
+
+    csrow->edac = b->edac;
+    csrow->dev =  dev;
+    strncpy (csrow->id, edac_sysfs_dir_name (dev), sizeof (csrow->id) - 1);
+    get_sysfs_uint_attr (dev, &csrow->size_mb, "size_mb");
+
+    /*  Only allocate channel slots up to the highest valid channel.
+     */
+    memset (chans, 0, sizeof (chans));
+    for (i = 0; i < EDAC_MAX_CHANNELS; i++) {
+        if (channel_probe (&chans[i], dev, i) == 0)
+            nchans = i + 1;
+    }
+
+    if (array_reserve ((void **) &b->channels, &b->channels_size,
+                       b->nchannels + nchans, sizeof (chans[0])) < 0)
+        return (-1);
+
+    memcpy (&b->channels[b->nchannels], chans, nchans * sizeof (chans[0]));
+
+    csrow->chan_first = b->nchannels;
+    csrow->nchannels =  nchans;
+
+    b->nchannels += nchans;
+    b->ncsrows++;
+
+    return (0);
+}
+
+/*  Parse an EDAC location string of the form "channel 3 slot 1 " into
+ *   layer names and positions. Returns the number of layers found.
+ */
+static int
+parse_location (const char *str, char name[][EDAC_LAYER_NAME_LEN], int *pos)
+{
+    char         buf[256];
+    char *       tok;
+    char *       save;
+    int          n = 0;
+
+    strncpy (buf, str, sizeof (buf) - 1);
+    buf[sizeof (buf) - 1] = '\0';
+
+    tok = strtok_r (buf, " \t\n", &save);
+    while (tok && (n < EDAC_MAX_LAYERS)) {
+        char *num;
+        char *end;
+
+        if (!(num = strtok_r (NULL, " \t\n", &save)))
+            break;
+
+        pos[n] = strtol (num, &end, 10);
+        if ((*end != '\0') || (pos[n] < 0))
+            break;
+
+        if (name) {
+            memset (name[n], 0, EDAC_LAYER_NAME_LEN);
+            strncpy (name[n], tok, EDAC_LAYER_NAME_LEN - 1);
+        }
+
+        n++;
+        tok = strtok_r (NULL, " \t\n", &save);
+    }
+
+    return (n);
+}
+
+static int
+dimm_scan_one (edac_sysfs_dir *dev, void *arg)
+{
+    struct topology_builder *b = arg;
+    struct edac_handle *     edac = b->edac;
+    struct edac_mc *         mc = b->mc;
+    struct edac_dimm *       dimm;
+    char                     loc[256];
+    char                     names[EDAC_MAX_LAYERS][EDAC_LAYER_NAME_LEN];
+    int                      pos[EDAC_MAX_LAYERS];
+    int                      n;
+
+    if (get_sysfs_string_attr (dev, loc, sizeof (loc), "dimm_location") < 0)
+        return (0);
+
+    if ((n = parse_location (loc, names, pos)) == 0)
+        return (0);
+
+    if (mc->nlayers == 0) {
+        mc->nlayers = n;
+        memcpy (mc->layer, names, sizeof (names));
+    }
+    else if (n != mc->nlayers)
+        return (0);
+
+    if (array_reserve ((void **) &b->dimms, &b->dimms_size,
+                       b->ndimms + 1, sizeof (*dimm)) < 0)
+        return (-1);
+
+    dimm = &b->dimms[b->ndimms];
+    memset (dimm, 0, sizeof (*dimm));
+
+    dimm->edac = edac;
+    dimm->dev =  dev;
+    dimm->mc =   mc - edac->mcs;
+    memcpy (dimm->location, pos, sizeof (pos));
+    strncpy (dimm->id, edac_sysfs_dir_name (dev), sizeof (dimm->id) - 1);
+
+    if (get_sysfs_uint_attr (dev, &dimm->size_mb, "size") < 0)
+        get_sysfs_uint_attr (dev, &dimm->size_mb, "dimm_size");
+
+    if (  (get_sysfs_string_attr (dev, dimm->dimm_label, 
+                                  sizeof (dimm->dimm_label), 
+                                  "dimm_label") >= 0)
+       && (dimm->dimm_label[0] != '\0'))
+        dimm->dimm_label_valid = 1;
+
+    b->ndimms++;
+
+    return (0);
+}
+
+/*  Build the dense location -> DIMM index of `mc' from its layer
+ *   sizes. DIMM i of the `n' in `dimms' is stored as `base' + i.
+ *   Returns <0 if a DIMM lies outside the layers.
+ */
+static int
+mc_dimm_index_build (struct edac_mc *mc, const struct edac_dimm *dimms,
+        unsigned int n, unsigned int base)
+{
+    unsigned int size = 1;
+    unsigned int i;
+    int          l;
+
+    for (l = 0; l < mc->nlayers; l++)
+        size *= mc->layer_size[l];
+
+    if ((size == 0) || !(mc->dimm_index = malloc (size * sizeof (int))))
+        return (-1);
+
+    for (i = 0; i < size; i++)
+        mc->dimm_index[i] = -1;
+
+    for (i = 0; i < n; i++) {
+        unsigned int idx = 0;
+        for (l = 0; l < mc->nlayers; l++) {
+            if (  (dimms[i].location[l] < 0)
+               || ((unsigned int) dimms[i].location[l] >= mc->layer_size[l]))
+                return (-1);
+            idx = idx * mc->layer_size[l] + dimms[i].location[l];
+        }
+        mc->dimm_index[idx] = base + i;
+    }
+
+    return (0);
+}
+
+/*  Size MC layers from max_location (or from the DIMMs found if it is
+ *   missing), and build the dense location -> DIMM index for the MC
+ *   being read by `b'. Index entries are local to b->dimms until the
+ *   builder is merged.
+ */
+static int
+mc_dimm_index_create (struct topology_builder *b)
+{
+    struct edac_mc *mc = b->mc;
+    char            loc[256];
+    int             pos[EDAC_MAX_LAYERS];
+    unsigned int    i;
+    int             l;
+
+    if (b->ndimms == 0)
+        return (0);
+
+    memset (mc->layer_size, 0, sizeof (mc->layer_size));
+
+    if (  (get_sysfs_string_attr (mc->dev, loc, sizeof (loc), 
+                                  "max_location") >= 0)
+       && (parse_location (loc, NULL, pos) == mc->nlayers)) {
+        for (l = 0; l < mc->nlayers; l++)
+            mc->layer_size[l] = pos[l] + 1;
+    }
+
+    for (i = 0; i < b->ndimms; i++) {
+        for (l = 0; l < mc->nlayers; l++) {
+            int where = b->dimms[i].location[l];
+            if ((where >= 0) && ((unsigned int) where >= mc->layer_size[l]))
+                mc->layer_size[l] = where + 1;
+        }
+    }
+
+    return (mc_dimm_index_build (mc, b->dimms, b->ndimms, 0));
+}
+
+static int
+mc_collect_one (edac_sysfs_dir *dev, void *arg)
+{
+    struct mc_scan *m = arg;
+
+    if (array_reserve ((void **) &m->devs, &m->devs_size,
+                       m->ndevs + 1, sizeof (*m->devs)) < 0)
+        return (-1);
+
+    m->devs[m->ndevs++] = dev;
+
+    return (0);
+}
+
+/*  Read MC directory `i' into edac->mcs[i]. Pool job.
+ */
+static void
+mc_read_one (void *arg, unsigned int i)
+{
+    struct mc_scan *    m = arg;
+    struct edac_handle *edac = m->edac;
+    edac_sysfs_dir *    dev = m->devs[i];
+    struct edac_mc *    mc = &edac->mcs[i];
+    unsigned int        ce_count;
+
+    memset (mc, 0, sizeof (*mc));
+
+    /*  Skip memory controllers which cannot be read.
+     */
+    if (get_sysfs_uint_attr (dev, &ce_count, "ce_count") < 0)
+        return;
+
+    mc->edac = edac;
+    mc->dev =  dev;
+    strncpy (mc->id, edac_sysfs_dir_name (dev), sizeof (mc->id) - 1);
+    mc->num = strtoul (mc->id + 2, NULL, 10);
+
+    if (get_sysfs_uint_attr (dev, &mc->size_mb, "size_mb") < 0) 
+        return;
+
+    get_sysfs_string_attr (dev, mc->mc_name, sizeof (mc->mc_name), "mc_name");
+
+    m->ok[i] = 1;
+}
+
+static int
+mc_cmp (const void *a, const void *b)
+{
+    const struct edac_mc *x = a;
+    const struct edac_mc *y = b;
+
+    return ((x->num > y->num) - (x->num < y->num));
+}
+
+/*  Find and read all mcN directories, possibly on the worker pool.
+ *   MCs are kept in mcN order whichever order they are listed or
+ *   read in, so results do not depend on the number of threads.
+ */
+static int
+mc_list_create (edac_handle *edac)
+{
+    struct mc_scan m;
+    unsigned int   i;
+    int            rc = -1;
+
+    memset (&m, 0, sizeof (m));
+    m.edac = edac;
+
+    if (edac_sysfs_dir_scan (edac->dev, "mc", mc_collect_one, &m) < 0) {
+        edac->error_num = EDAC_MC_OPEN_FAILED;
+        goto out;
+    }
+
+    if (m.ndevs == 0) {
+        rc = 0;
+        goto out;
+    }
+
+    if (  !(edac->mcs = malloc (m.ndevs * sizeof (*edac->mcs)))
+       || !(m.ok = calloc (m.ndevs, sizeof (*m.ok)))) {
+        edac->error_num = EDAC_OUT_OF_MEMORY;
+        goto out;
+    }
+
+    edac_pool_run (edac_handle_pool (edac), mc_read_one, &m, m.ndevs);
+
+    for (i = 0; i < m.ndevs; i++) {
+        if (m.ok[i])
+            edac->mcs[edac->nmcs++] = edac->mcs[i];
+    }
+
+    qsort (edac->mcs, edac->nmcs, sizeof (*edac->mcs), mc_cmp);
+    rc = 0;
+
+out:
+    free (m.devs);
+    free (m.ok);
+    return (rc);
+}
+
+/*  Order ids such as "csrow10" or "dimm3" by their numeric suffix
+ */
+static int
+id_cmp (const char *x, const char *y)
+{
+    unsigned long nx = strtoul (x + strcspn (x, "0123456789"), NULL, 10);
+    unsigned long ny = strtoul (y + strcspn (y, "0123456789"), NULL, 10);
+
+    if (nx != ny)
+        return ((nx > ny) - (nx < ny));
+    return (strcmp (x, y));
+}
+
+static int
+csrow_cmp (const void *a, const void *b)
+{
+    return (id_cmp (((const struct edac_csrow *) a)->id,
+                    ((const struct edac_csrow *) b)->id));
+}
+
+static int
+dimm_cmp (const void *a, const void *b)
+{
+    return (id_cmp (((const struct edac_dimm *) a)->id,
+                    ((const struct edac_dimm *) b)->id));
+}
+
+/*  Sort the csrows of `b' by number, and lay their channel slots out
+ *   again in the same order so that counters follow csrow order.
+ */
+static int
+builder_csrows_sort (struct topology_builder *b)
+{
+    struct edac_chan_info *channels;
+    unsigned int           n = 0;
+    unsigned int           i;
+
+    qsort (b->csrows, b->ncsrows, sizeof (*b->csrows), csrow_cmp);
+
+    if (b->nchannels == 0)
+        return (0);
+
+    if (!(channels = malloc (b->nchannels * sizeof (*channels))))
+        return (-1);
+
+    for (i = 0; i < b->ncsrows; i++) {
+        struct edac_csrow *csrow = &b->csrows[i];
+        memcpy (&channels[n], &b->channels[csrow->chan_first],
+                csrow->nchannels * sizeof (*channels));
+        csrow->chan_first = n;
+        n += csrow->nchannels;
+    }
+
+    free (b->channels);
+    b->channels =      channels;
+    b->channels_size = b->nchannels;
+    return (0);
+}
+
+/*  Scan csrows, channels and DIMMs of memory controller `b->mc' into
+ *   the builder's own arrays. Directories are listed in no particular
+ *   order, so csrows and DIMMs are sorted by number, as MCs are in
+ *   mc_list_create ().
+ */
+static int
+mc_detail_scan (struct topology_builder *b)
+{
+    struct edac_mc *mc = b->mc;
+
+    if (edac_sysfs_dir_scan (mc->dev, "csrow", csrow_scan_one, b) < 0)
+        return (-1);
+
+    /*  DIMMs are exported as dimmN, or rankN when the driver
+     *   tracks errors per rank.
+     */
+    if (edac_sysfs_dir_scan (mc->dev, "dimm", dimm_scan_one, b) < 0)
+        return (-1);
+    if ((b->ndimms == 0) 
+       && (edac_sysfs_dir_scan (mc->dev, "rank", dimm_scan_one, b) < 0))
+        return (-1);
+
+    if (b->ncsrows && (builder_csrows_sort (b) < 0))
+        return (-1);
+    if (b->ndimms)
+        qsort (b->dimms, b->ndimms, sizeof (*b->dimms), dimm_cmp);
+
+    return (mc_dimm_index_create (b));
+}
+
+/*  Read csrows and DIMMs of MC `i'. Pool job.
+ */
+static void
+mc_detail_scan_one (void *arg, unsigned int i)
+{
+    struct topology_builder *b = arg;
+
+    b[i].rc = mc_detail_scan (&b[i]);
+}
+
+static void
+builders_destroy (struct topology_builder *b, unsigned int n)
+{
+    unsigned int i;
+
+    for (i = 0; i < n; i++) {
+        free (b[i].csrows);
+        free (b[i].channels);
+        free (b[i].dimms);
+    }
+    free (b);
+}
+
+/*  Concatenate the per-MC arrays of builders `b' into the handle in
+ *   MC order, rebasing local indices onto the merged arrays.
+ */
+static int
+builders_merge (edac_handle *edac, struct topology_builder *b)
+{
+    unsigned int ncsrows = 0;
+    unsigned int nchannels = 0;
+    unsigned int ndimms = 0;
+    unsigned int i;
+    unsigned int j;
+
+    for (i = 0; i < edac->nmcs; i++) {
+        ncsrows +=   b[i].ncsrows;
+        nchannels += b[i].nchannels;
+        ndimms +=    b[i].ndimms;
+    }
+
+    if (  (ncsrows 
+          && !(edac->csrows = malloc (ncsrows * sizeof (*b->csrows))))
+       || (nchannels 
+          && !(edac->channels = malloc (nchannels * sizeof (*b->channels))))
+       || (ndimms 
+          && !(edac->dimms = malloc (ndimms * sizeof (*b->dimms))))) {
+        free (edac->csrows);
+        free (edac->channels);
+        free (edac->dimms);
+        edac->csrows =   NULL;
+        edac->channels = NULL;
+        edac->dimms =    NULL;
+        return (-1);
+    }
+
+    for (i = 0; i < edac->nmcs; i++) {
+        struct edac_mc *mc = &edac->mcs[i];
+        unsigned int    size = 1;
+        int             l;
+
+        mc->csrow_first = edac->ncsrows;
+        mc->ncsrows =     b[i].ncsrows;
+        mc->dimm_first =  edac->ndimms;
+        mc->ndimms =      b[i].ndimms;
+
+        for (j = 0; j < b[i].ncsrows; j++) {
+            struct edac_csrow *csrow = &edac->csrows[edac->ncsrows++];
+            *csrow = b[i].csrows[j];
+            csrow->chan_first += edac->nchannels;
+        }
+
+        memcpy (&edac->channels[edac->nchannels], b[i].channels,
+                b[i].nchannels * sizeof (*b->channels));
+        edac->nchannels += b[i].nchannels;
+
+        memcpy (&edac->dimms[edac->ndimms], b[i].dimms,
+                b[i].ndimms * sizeof (*b->dimms));
+        edac->ndimms += b[i].ndimms;
+
+        if (mc->dimm_index == NULL)
+            continue;
+
+        for (l = 0; l < mc->nlayers; l++)
+            size *= mc->layer_size[l];
+        for (j = 0; j < size; j++) {
+            if (mc->dimm_index[j] >= 0)
+                mc->dimm_index[j] += mc->dimm_first;
+        }
+    }
+
+    return (0);
+}
+
+/*  Point store slot `valp' at sysfs attribute `format' in `dev'.
+ */
+static void
+edac_counter_init (edac_handle *edac, uint64_t *valp, edac_sysfs_dir *dev,
+        const char *format, ...)
+{
+    struct edac_counter *c = &edac->counters[valp - edac->store.values];
+    va_list              ap;
+    int                  n;
+
+    va_start (ap, format);
+    n = vsnprintf (c->name, sizeof (c->name), format, ap);
+    va_end (ap);
+
+    if ((n < 0) || ((size_t) n >= sizeof (c->name))) {
+        c->name[0] = '\0';
+        return;
+    }
+
+    c->dev = dev;
+
+    /*  Attributes which do not exist (e.g. dimm_ce_count on older
+     *   kernels) are left out of the table entirely.
+     */
+    if (((c->fd = edac_sysfs_open_attr (dev, c->name)) < 0) 
+       && (errno == ENOENT))
+        c->name[0] = '\0';
+}
+
+static void
+edac_batch_destroy (struct edac_batch *b)
+{
+    edac_uring_destroy (b->ring);
+    free (b->counter);
+    free (b->bufs);
+    free (b->res);
+    memset (b, 0, sizeof (*b));
+}
+
+/*  Register every counter with an open fd in an io_uring so that a
+ *   sample is one system call instead of one pread(2) per counter.
+ *   On any failure the batch is left empty and counters are read
+ *   one at a time.
+ */
+static void
+edac_batch_create (edac_handle *edac)
+{
+    struct edac_batch *b = &edac->batch;
+    const char *       env = getenv (EDAC_IO_URING_ENV);
+    int *              fds;
+    unsigned int       i;
+
+    memset (b, 0, sizeof (*b));
+
+    if (env && (strcmp (env, "0") == 0))
+        return;
+
+    for (i = 0; i < edac->store.nvalues; i++) {
+        if (edac->counters[i].name[0] && (edac->counters[i].fd >= 0))
+            b->n++;
+    }
+    if (b->n == 0)
+        return;
+
+    b->counter = malloc (b->n * sizeof (*b->counter));
+    b->bufs =    malloc (b->n * EDAC_URING_BUFLEN);
+    b->res =     malloc (b->n * sizeof (*b->res));
+    fds =        malloc (b->n * sizeof (*fds));
+
+    if (!b->counter || !b->bufs || !b->res || !fds) {
+        free (fds);
+        edac_batch_destroy (b);
+        return;
+    }
+
+    b->n = 0;
+    for (i = 0; i < edac->store.nvalues; i++) {
+        if (edac->counters[i].name[0] && (edac->counters[i].fd >= 0)) {
+            fds[b->n] = edac->counters[i].fd;
+            b->counter[b->n++] = i;
+        }
+    }
+
+    b->ring = edac_uring_create (fds, b->n);
+    free (fds);
+
+    if (b->ring == NULL)
+        edac_batch_destroy (b);
+}
+
+/*  Number of counters in the store for the handle's topology.
+ */
+static inline unsigned int
+edac_store_size (edac_handle *edac)
+{
+    return (4 * edac->nmcs + 2 * edac->ncsrows + edac->nchannels
+            + 2 * edac->ndimms + 1);
+}
+
+/*  Allocate the counter store for the current topology and lay out
+ *   its sections, without attaching any counters to it.
+ */
+static int
+edac_store_alloc (edac_handle *edac)
+{
+    struct edac_store *s = &edac->store;
+    uint64_t *         p;
+
+    s->nvalues = edac_store_size (edac);
+
+    if (!(s->values = calloc (s->nvalues, sizeof (*s->values))))
+        return (-1);
+
+    edac->layout_gen++;
+
+    p = s->values;
+    s->mc_ce =        p;   p += edac->nmcs;
+    s->mc_ue =        p;   p += edac->nmcs;
+    s->mc_ce_noinfo = p;   p += edac->nmcs;
+    s->mc_ue_noinfo = p;   p += edac->nmcs;
+    s->csrow_ce =     p;   p += edac->ncsrows;
+    s->csrow_ue =     p;   p += edac->ncsrows;
+    s->chan_ce =      p;   p += edac->nchannels;
+    s->dimm_ce =      p;   p += edac->ndimms;
+    s->dimm_ue =      p;   p += edac->ndimms;
+    s->pci_parity =   p;
+
+    return (0);
+}
+
+/*  Allocate the counter store once the topology is known, resolve
+ *   every counter attribute and take the initial sample.
+ */
+static int
+edac_store_create (edac_handle *edac)
+{
+    struct edac_store *s = &edac->store;
+    unsigned int       i;
+    unsigned int       j;
+
+    if (edac_store_alloc (edac) < 0)
+        return (-1);
+
+    if (!(edac->counters = calloc (s->nvalues, sizeof (*edac->counters))))
+        return (-1);
+
+    for (i = 0; i < s->nvalues; i++)
+        edac->counters[i].fd = -1;
 
-    if (edac->dev->children) {
-        dlist_for_each_data (edac->dev->children, dev, struct sysfs_device) {
-            struct edac_mc *mc;
-            if ((mc = edac_mc_create (edac, dev)))
-                dlist_push (l, mc);
+    for (i = 0; i < edac->nmcs; i++) {
+        edac_sysfs_dir *dev = edac->mcs[i].dev;
+        edac_counter_init (edac, &s->mc_ce[i], dev, "ce_count");
+        edac_counter_init (edac, &s->mc_ue[i], dev, "ue_count");
+        edac_counter_init (edac, &s->mc_ce_noinfo[i], dev, "ce_noinfo_count");
+        edac_counter_init (edac, &s->mc_ue_noinfo[i], dev, "ue_noinfo_count");
+    }
+
+    for (i = 0; i < edac->ncsrows; i++) {
+        struct edac_csrow *csrow = &edac->csrows[i];
+
+        edac_counter_init (edac, &s->csrow_ce[i], csrow->dev, "ce_count");
+        edac_counter_init (edac, &s->csrow_ue[i], csrow->dev, "ue_count");
+
+        for (j = 0; j < csrow->nchannels; j++) {
+            unsigned int k = csrow->chan_first + j;
+            if (edac->channels[k].valid)
+                edac_counter_init (edac, &s->chan_ce[k], csrow->dev,
+                                   "ch%d_ce_count", j);
         }
     }
 
-    edac_dlist_reset (l); 
+    for (i = 0; i < edac->ndimms; i++) {
+        edac_sysfs_dir *dev = edac->dimms[i].dev;
+        edac_counter_init (edac, &s->dimm_ce[i], dev, "dimm_ce_count");
+        edac_counter_init (edac, &s->dimm_ue[i], dev, "dimm_ue_count");
+    }
 
-    return (l);
+    if (edac->pci)
+        edac_counter_init (edac, s->pci_parity, edac->pci, "pci_parity_count");
+
+    edac_batch_create (edac);
+    edac_store_sample (edac);
+
+    return (0);
 }
 
-static int edac_totals_refresh (edac_handle *edac)
+/*  Build the mcN lookup table for the handle's MCs and give the
+ *   topology arrays an owner.
+ */
+static int
+edac_topology_index (edac_handle *edac)
 {
-    struct dl_node *i;
+    unsigned int i;
 
+    for (i = 0; i < edac->nmcs; i++) {
+        if (edac->mcs[i].num >= edac->mc_by_num_size)
+            edac->mc_by_num_size = edac->mcs[i].num + 1;
+    }
 
-    if (edac->pci) {
-        int rc = get_sysfs_uint_attr (edac->pci, 
-                           (unsigned int *) &edac->pci_parity_count, 
-                           "pci_parity_count");
-        if (rc < 0)
-            return (-1);
+    if (edac->mc_by_num_size &&
+       !(edac->mc_by_num = malloc (edac->mc_by_num_size * sizeof (int)))) {
+        edac->error_num = EDAC_OUT_OF_MEMORY;
+        return (-1);
     }
 
-    if (edac->mc_list->count == 0) {
-        edac->error_num = EDAC_MC_OPEN_FAILED;
+    for (i = 0; i < edac->mc_by_num_size; i++)
+        edac->mc_by_num[i] = -1;
+    for (i = 0; i < edac->nmcs; i++)
+        edac->mc_by_num[edac->mcs[i].num] = i;
+
+    if (!(edac->topo = malloc (sizeof (*edac->topo)))) {
+        edac->error_num = EDAC_OUT_OF_MEMORY;
         return (-1);
     }
+    edac->topo->refs = 1;
+    topology_capture (edac, edac->topo);
+
+    return (0);
+}
+
+static int
+edac_topology_create (edac_handle *edac)
+{
+    if (mc_list_create (edac) < 0)
+        return (-1);
 
-    dlist_for_each_nomark (edac->mc_list, i) {
-        struct edac_mc *mc = i->data;
-        /* edac_mc_refresh (mc); */
-        edac->ue_total += mc->info.ue_count;
-        edac->ce_total += mc->info.ce_count;
+    if (edac_topology_index (edac) < 0)
+        return (-1);
+
+    if (edac_store_create (edac) < 0) {
+        edac->error_num = EDAC_OUT_OF_MEMORY;
+        return (-1);
     }
 
-    edac->totals_valid = 1;
+    edac->mc_iter = 0;
 
     return (0);
 }
 
-static int edac_handle_reload (edac_handle *edac)
+/*  Close the attributes of store `s' and free it
+ */
+static void
+edac_store_free (struct edac_store *s, struct edac_counter *counters,
+        struct edac_batch *batch)
+{
+    unsigned int i;
+
+    edac_batch_destroy (batch);
+
+    if (counters) {
+        for (i = 0; i < s->nvalues; i++) {
+            if (counters[i].fd >= 0)
+                close (counters[i].fd);
+        }
+        free (counters);
+    }
+    if (s->values)
+        free (s->values);
+}
+
+static void
+edac_store_destroy (edac_handle *edac)
+{
+    edac_store_free (&edac->store, edac->counters, &edac->batch);
+
+    memset (&edac->store, 0, sizeof (edac->store));
+    memset (&edac->totals, 0, sizeof (edac->totals));
+    edac->counters =  NULL;
+}
+
+/*  Undo builders_merge () and mc_detail_scan (), leaving the handle with
+ *   MCs only, as it was after init.
+ */
+static void
+edac_detail_free (edac_handle *edac)
+{
+    unsigned int i;
+
+    for (i = 0; i < edac->nmcs; i++) {
+        struct edac_mc *mc = &edac->mcs[i];
+        if (mc->dimm_index)
+            free (mc->dimm_index);
+        mc->dimm_index =  NULL;
+        mc->nlayers =     0;
+        mc->csrow_first = 0;
+        mc->ncsrows =     0;
+        mc->dimm_first =  0;
+        mc->ndimms =      0;
+    }
+
+    free (edac->csrows);
+    free (edac->channels);
+    free (edac->dimms);
+    edac->csrows =    NULL;
+    edac->channels =  NULL;
+    edac->dimms =     NULL;
+    edac->ncsrows =   0;
+    edac->nchannels = 0;
+    edac->ndimms =    0;
+
+    if (edac->topo)
+        topology_capture (edac, edac->topo);
+}
+
+/*  Load csrows, channels and DIMMs for all MCs, and rebuild the
+ *   counter store to include them. Only MCs are read at init, so
+ *   that status and totals queries never touch csrow directories.
+ *   Absent channels get no counter slot here and are never read again.
+ *   On failure the handle is left as it was, with the MC-only store.
+ */
+static int
+edac_detail_load (edac_handle *edac)
 {
-    if (!edac->mc_list) {
-        edac->error_num = EDAC_BAD_HANDLE;
+    struct topology_builder *b = NULL;
+    struct edac_store        store;
+    struct edac_counter *    counters;
+    struct edac_batch        batch;
+    struct edac_totals       totals;
+    unsigned int             layout_gen;
+    unsigned int             i;
+
+    if (edac->detail_loaded)
+        return (0);
+
+    if (edac->nmcs && !(b = calloc (edac->nmcs, sizeof (*b)))) {
+        edac->error_num = EDAC_OUT_OF_MEMORY;
         return (-1);
     }
 
-    dlist_destroy (edac->mc_list);
+    for (i = 0; i < edac->nmcs; i++) {
+        b[i].edac = edac;
+        b[i].mc =   &edac->mcs[i];
+    }
 
-    if (!(edac->mc_list = mc_list_create (edac))) {
-        edac->error_num = EDAC_MC_OPEN_FAILED;
+    /*  MCs are independent until merged, so each one may be read by
+     *   a different thread.
+     */
+    edac_pool_run (edac_handle_pool (edac), mc_detail_scan_one, b,
+                   edac->nmcs);
+
+    for (i = 0; i < edac->nmcs; i++) {
+        if (b[i].rc < 0)
+            goto fail;
+    }
+
+    if (builders_merge (edac, b) < 0)
+        goto fail;
+
+    builders_destroy (b, edac->nmcs);
+    topology_capture (edac, edac->topo);
+
+    /*  Build the new store aside, keeping the old one until the new
+     *   one is complete.
+     */
+    store =      edac->store;
+    counters =   edac->counters;
+    batch =      edac->batch;
+    totals =     edac->totals;
+    layout_gen = edac->layout_gen;
+    memset (&edac->store, 0, sizeof (edac->store));
+    memset (&edac->batch, 0, sizeof (edac->batch));
+    edac->counters = NULL;
+
+    if (edac_store_create (edac) < 0) {
+        edac_store_destroy (edac);
+        edac->store =      store;
+        edac->counters =   counters;
+        edac->batch =      batch;
+        edac->totals =     totals;
+        edac->layout_gen = layout_gen;
+        edac_detail_free (edac);
+        edac->error_num = EDAC_OUT_OF_MEMORY;
         return (-1);
     }
 
-    edac_handle_reset (edac);
+    edac_store_free (&store, counters, &batch);
+    edac->detail_loaded = 1;
+
+    return (0);
+
+fail:
+    /*  Leave the handle as it was. Nothing has been merged into the
+     *   handle's arrays yet, so only the MCs need to be reset.
+     */
+    edac_detail_free (edac);
+    builders_destroy (b, edac->nmcs);
+    edac->error_num = EDAC_CSROW_OPEN_FAILED;
+
+    return (-1);
+}
+
+static inline int
+edac_detail_ready (struct edac_handle *edac)
+{
+    return (edac->detail_loaded || (edac_detail_load (edac) == 0));
+}
+
+static void
+edac_topology_destroy (edac_handle *edac)
+{
+    edac_store_destroy (edac);
+
+    edac_shm_destroy (edac->shm);
+    edac->shm = NULL;
+
+    /*  Arrays are freed with the last reference to the topology.
+     *   If init failed before it was created, free them directly.
+     */
+    if (edac->topo)
+        topology_release (edac->topo);
+    else {
+        struct edac_topology t;
+        topology_capture (edac, &t);
+        topology_free_arrays (&t);
+    }
+
+    edac->topo =      NULL;
+    edac->detail_loaded = 0;
+
+    edac->mcs =       NULL;
+    edac->csrows =    NULL;
+    edac->channels =  NULL;
+    edac->dimms =     NULL;
+    edac->mc_by_num = NULL;
+    edac->nmcs =      0;
+    edac->ncsrows =   0;
+    edac->nchannels = 0;
+    edac->ndimms =    0;
+    edac->mc_by_num_size = 0;
+    edac->mc_iter =   0;
+}
+
+static int 
+get_sysfs_uint_attr (edac_sysfs_dir *dev, unsigned int *valp, 
+        const char *format, ...)
+{
+    char                      name[1024];
+    char                      buf[64];
+    char *                    p;
+    va_list                   ap;
+    int                       n;
+
+    va_start (ap, format);
+    n = vsnprintf (name, sizeof (name), format, ap); 
+    va_end (ap);
+
+    if ((n < 0) || ((size_t) n >= sizeof (name)))
+        return (-1);
+
+    if (edac_sysfs_read_attr (dev, name, buf, sizeof (buf)) < 0)
+        return (-1);
+
+    *valp = strtoul (buf, &p, 10);
+    /*
+     * XXX: Check for valid number?
+     */
+
+    return (0);
+
+}
+
+static int
+get_sysfs_string_attr (edac_sysfs_dir *dev, char *dest, int len,
+                      const char *format, ...)
+{
+    va_list                   ap;
+    char                      name[1024];
+    char                      buf[1024];
+    char *                    nl;
+    int                       n;
+
+    va_start (ap, format);
+    n = vsnprintf (name, sizeof (name), format, ap); 
+    va_end (ap);
+
+    if ((n < 0) || ((size_t) n >= sizeof (name)))
+        return (-1);
+
+    if (edac_sysfs_read_attr (dev, name, buf, sizeof (buf)) < 0)
+        return (-1);
+
+    /*  Terminate any final newline 
+     */
+    if ((nl = strrchr (buf, '\n')))
+        *nl = '\0';
+
+    /*  Copy at most len - 1 bytes and always terminate dest
+     */
+    n = strnlen (buf, len - 1);
+    memcpy (dest, buf, n);
+    dest[n] = '\0';
+    return (0);
+}
+
+static int 
+edac_counter_sample (struct edac_counter *c, uint64_t *valp)
+{
+    char    buf[64];
+    ssize_t n;
+
+    if (c->fd < 0)
+        n = edac_sysfs_read_attr (c->dev, c->name, buf, sizeof (buf));
+    else if ((n = pread (c->fd, buf, sizeof (buf) - 1, 0)) >= 0)
+        buf[n] = '\0';
+
+    if (n < 0)
+        return (-1);
+
+    *valp = strtoull (buf, NULL, 10);
 
     return (0);
 }
 
+/*  Records of the shared-memory segment. Only plain data is stored;
+ *   a reader rebuilds the csrow, channel and DIMM ranges of each MC
+ *   from the counts, in the same order as the publisher's arrays.
+ */
+struct shm_mc {
+    char                   id[EDAC_NAME_LEN];
+    char                   mc_name[EDAC_NAME_LEN];
+    uint32_t               size_mb;
+    uint32_t               num;
+    uint32_t               ncsrows;
+    uint32_t               ndimms;
+    int32_t                nlayers;
+    char                   layer[EDAC_MAX_LAYERS][EDAC_LAYER_NAME_LEN];
+    uint32_t               layer_size[EDAC_MAX_LAYERS];
+};
+
+struct shm_csrow {
+    char                   id[EDAC_NAME_LEN];
+    uint32_t               size_mb;
+    uint32_t               nchannels;
+};
 
-#if HAVE_SYSFS_OPEN_DEVICE_TREE
+struct shm_dimm {
+    char                   id[EDAC_NAME_LEN];
+    int32_t                location[EDAC_MAX_LAYERS];
+    uint32_t               size_mb;
+    int32_t                dimm_label_valid;
+    char                   dimm_label[EDAC_LABEL_LEN];
+};
 
-static struct sysfs_device *
-_sysfs_open_device_tree (const char *path)
+static inline uint64_t
+shm_align (uint64_t off)
 {
-    return (sysfs_open_device_tree (path));
+    return ((off + 7) & ~((uint64_t) 7));
 }
 
-#else
+#define shm_record(__h, __off, __type, __i) \
+    (((__type *) ((char *) (__h) + (__off))) + (__i))
 
-/*  libsysfs-2.0.0 did not implement sysfs_open_device_tree(). Replicate here.
+/*  Copy NUL terminated string `src' into `dst' of `len' bytes.
  */
+static inline void
+shm_strcpy (char *dst, const char *src, size_t len)
+{
+    size_t n = strnlen (src, len - 1);
 
-static void
-_null (void *x)
+    memset (dst, 0, len);
+    memcpy (dst, src, n);
+}
+
+/*  Write the handle's whole topology and counters to the segment
+ *   we publish, after edac_handle_init () or the csrow/DIMM load
+ *   changed the layout.
+ */
+static int
+edac_shm_publish_layout (edac_handle *edac)
 {
-    return;
+    struct edac_shm_header *h;
+    struct edac_store *     s = &edac->store;
+    uint64_t                off_mcs;
+    uint64_t                off_csrows;
+    uint64_t                off_channels;
+    uint64_t                off_dimms;
+    uint64_t                off_values;
+    uint64_t                size;
+    unsigned int            i;
+
+    off_mcs =      shm_align (sizeof (*h));
+    off_csrows =   shm_align (off_mcs + edac->nmcs * sizeof (struct shm_mc));
+    off_channels = shm_align (off_csrows 
+                              + edac->ncsrows * sizeof (struct shm_csrow));
+    off_dimms =    shm_align (off_channels 
+                              + edac->nchannels * sizeof (*edac->channels));
+    off_values =   shm_align (off_dimms 
+                              + edac->ndimms * sizeof (struct shm_dimm));
+    size =         off_values + s->nvalues * sizeof (uint64_t);
+
+    if (edac_shm_reserve (edac->pub, size) < 0)
+        return (-1);
+
+    h = edac_shm_header (edac->pub);
+
+    edac_shm_write_begin (h);
+
+    h->size =         size;
+    h->nmcs =         edac->nmcs;
+    h->ncsrows =      edac->ncsrows;
+    h->nchannels =    edac->nchannels;
+    h->ndimms =       edac->ndimms;
+    h->nvalues =      s->nvalues;
+    h->off_mcs =      off_mcs;
+    h->off_csrows =   off_csrows;
+    h->off_channels = off_channels;
+    h->off_dimms =    off_dimms;
+    h->off_values =   off_values;
+    shm_strcpy (h->root, edac_root (edac), sizeof (h->root));
+
+    for (i = 0; i < edac->nmcs; i++) {
+        struct edac_mc *mc = &edac->mcs[i];
+        struct shm_mc * m = shm_record (h, off_mcs, struct shm_mc, i);
+
+        memset (m, 0, sizeof (*m));
+        memcpy (m->id, mc->id, sizeof (m->id));
+        memcpy (m->mc_name, mc->mc_name, sizeof (m->mc_name));
+        memcpy (m->layer, mc->layer, sizeof (m->layer));
+        memcpy (m->layer_size, mc->layer_size, sizeof (m->layer_size));
+        m->size_mb = mc->size_mb;
+        m->num =     mc->num;
+        m->ncsrows = mc->ncsrows;
+        m->ndimms =  mc->ndimms;
+        m->nlayers = mc->nlayers;
+    }
+
+    for (i = 0; i < edac->ncsrows; i++) {
+        struct edac_csrow *csrow = &edac->csrows[i];
+        struct shm_csrow * c = shm_record (h, off_csrows, struct shm_csrow, i);
+
+        memcpy (c->id, csrow->id, sizeof (c->id));
+        c->size_mb =   csrow->size_mb;
+        c->nchannels = csrow->nchannels;
+    }
+
+    memcpy ((char *) h + off_channels, edac->channels,
+            edac->nchannels * sizeof (*edac->channels));
+
+    for (i = 0; i < edac->ndimms; i++) {
+        struct edac_dimm *dimm = &edac->dimms[i];
+        struct shm_dimm * d = shm_record (h, off_dimms, struct shm_dimm, i);
+
+        memcpy (d->id, dimm->id, sizeof (d->id));
+        memcpy (d->location, dimm->location, sizeof (d->location));
+        memcpy (d->dimm_label, dimm->dimm_label, sizeof (d->dimm_label));
+        d->size_mb =          dimm->size_mb;
+        d->dimm_label_valid = dimm->dimm_label_valid;
+    }
+
+    memcpy ((char *) h + off_values, s->values, 
+            s->nvalues * sizeof (uint64_t));
+    h->totals =  edac->totals;
+    h->updated = time (NULL);
+    h->generation++;
+
+    edac_shm_write_end (h);
+
+    edac->pub_gen = edac->layout_gen;
+
+    return (0);
 }
 
-static void
-_dev_create_child_list (struct sysfs_device *dev)
+/*  Write the latest sample to the segment we publish.
+ */
+static int
+edac_shm_publish (edac_handle *edac)
 {
-    dev->children = dlist_new_with_delete (sizeof (struct sysfs_device), _null);
+    struct edac_shm_header *h;
+    struct edac_store *     s = &edac->store;
+
+    if (edac->pub_gen != edac->layout_gen)
+        return (edac_shm_publish_layout (edac));
+
+    h = edac_shm_header (edac->pub);
+
+    edac_shm_write_begin (h);
+    memcpy ((char *) h + h->off_values, s->values, 
+            s->nvalues * sizeof (uint64_t));
+    h->totals =  edac->totals;
+    h->updated = time (NULL);
+    edac_shm_write_end (h);
+
+    return (0);
 }
 
-static struct sysfs_device * 
-_sysfs_open_device_tree (const char *path)
+/*  Build the handle's topology and counter store from `c', a private
+ *   copy of a segment. The copy came from another process, so every
+ *   count and offset is checked before use.
+ */
+static int
+shm_topology_parse (edac_handle *edac, struct edac_shm_header *c)
 {
-    struct sysfs_device * dev;
-    struct sysfs_device * child;
-    struct dlist *        dirs;
-    char *                subdir;
+    unsigned int ncsrows = 0;
+    unsigned int nchannels = 0;
+    unsigned int ndimms = 0;
+    unsigned int i;
+    unsigned int j;
 
-    if (!(dev = sysfs_open_device_path (path)))
-        return (NULL);
+    c->root[sizeof (c->root) - 1] = '\0';
+
+    if (  (c->generation == 0) || (c->pid == 0)
+       || (strcmp (c->root, edac_root (edac)) != 0))
+        return (-1);
 
-    if (!(dirs = sysfs_open_directory_list (path)))
-        return (dev);
+    if (  (c->off_mcs + (uint64_t) c->nmcs * sizeof (struct shm_mc) > c->size)
+       || (c->off_csrows 
+          + (uint64_t) c->ncsrows * sizeof (struct shm_csrow) > c->size)
+       || (c->off_channels 
+          + (uint64_t) c->nchannels * sizeof (*edac->channels) > c->size)
+       || (c->off_dimms 
+          + (uint64_t) c->ndimms * sizeof (struct shm_dimm) > c->size)
+       || (c->off_values 
+          + (uint64_t) c->nvalues * sizeof (uint64_t) > c->size))
+        return (-1);
+
+    if (  (c->nmcs 
+          && !(edac->mcs = calloc (c->nmcs, sizeof (*edac->mcs))))
+       || (c->ncsrows 
+          && !(edac->csrows = calloc (c->ncsrows, sizeof (*edac->csrows))))
+       || (c->nchannels 
+          && !(edac->channels = malloc (c->nchannels 
+                                        * sizeof (*edac->channels))))
+       || (c->ndimms 
+          && !(edac->dimms = calloc (c->ndimms, sizeof (*edac->dimms)))))
+        goto fail;
+
+    edac->nmcs =      c->nmcs;
+    edac->ncsrows =   c->ncsrows;
+    edac->nchannels = c->nchannels;
+    edac->ndimms =    c->ndimms;
+
+    for (i = 0; i < edac->nmcs; i++) {
+        struct edac_mc *mc = &edac->mcs[i];
+        struct shm_mc * m = shm_record (c, c->off_mcs, struct shm_mc, i);
+
+        if (  (m->nlayers < 0) || (m->nlayers > EDAC_MAX_LAYERS)
+           || (m->ncsrows > edac->ncsrows - ncsrows)
+           || (m->ndimms > edac->ndimms - ndimms))
+            goto fail;
+
+        mc->edac = edac;
+        shm_strcpy (mc->id, m->id, sizeof (mc->id));
+        shm_strcpy (mc->mc_name, m->mc_name, sizeof (mc->mc_name));
+        memcpy (mc->layer, m->layer, sizeof (mc->layer));
+        memcpy (mc->layer_size, m->layer_size, sizeof (mc->layer_size));
+        mc->size_mb =     m->size_mb;
+        mc->num =         m->num;
+        mc->nlayers =     m->nlayers;
+        mc->csrow_first = ncsrows;
+        mc->ncsrows =     m->ncsrows;
+        mc->dimm_first =  ndimms;
+        mc->ndimms =      m->ndimms;
+
+        ncsrows += mc->ncsrows;
+        ndimms +=  mc->ndimms;
+
+        for (j = mc->dimm_first; j < mc->dimm_first + mc->ndimms; j++) {
+            struct edac_dimm *dimm = &edac->dimms[j];
+            struct shm_dimm * d = 
+                shm_record (c, c->off_dimms, struct shm_dimm, j);
+
+            dimm->edac = edac;
+            dimm->mc =   i;
+            shm_strcpy (dimm->id, d->id, sizeof (dimm->id));
+            shm_strcpy (dimm->dimm_label, d->dimm_label, 
+                        sizeof (dimm->dimm_label));
+            memcpy (dimm->location, d->location, sizeof (dimm->location));
+            dimm->size_mb =          d->size_mb;
+            dimm->dimm_label_valid = d->dimm_label_valid;
+        }
+
+        if (  mc->ndimms 
+           && (mc_dimm_index_build (mc, &edac->dimms[mc->dimm_first], 
+                                    mc->ndimms, mc->dimm_first) < 0))
+            goto fail;
+    }
+
+    for (i = 0; i < edac->ncsrows; i++) {
+        struct edac_csrow *csrow = &edac->csrows[i];
+        struct shm_csrow * r = shm_record (c, c->off_csrows, 
+                                           struct shm_csrow, i);
+
+        if (r->nchannels > edac->nchannels - nchannels)
+            goto fail;
+
+        csrow->edac = edac;
+        shm_strcpy (csrow->id, r->id, sizeof (csrow->id));
+        csrow->size_mb =    r->size_mb;
+        csrow->chan_first = nchannels;
+        csrow->nchannels =  r->nchannels;
+
+        nchannels += csrow->nchannels;
+    }
+
+    memcpy (edac->channels, (char *) c + c->off_channels, 
+            edac->nchannels * sizeof (*edac->channels));
+    for (i = 0; i < edac->nchannels; i++) {
+        struct edac_chan_info *ch = &edac->channels[i];
+        ch->dimm_label[sizeof (ch->dimm_label) - 1] = '\0';
+    }
+
+    if (  (ncsrows != edac->ncsrows) || (nchannels != edac->nchannels)
+       || (ndimms != edac->ndimms) || (c->nvalues != edac_store_size (edac)))
+        goto fail;
+
+    if (edac_topology_index (edac) < 0)
+        goto fail;
+
+    if (edac_store_alloc (edac) < 0)
+        goto fail;
+
+    memcpy (edac->store.values, (char *) c + c->off_values,
+            edac->store.nvalues * sizeof (uint64_t));
+    edac->totals =        c->totals;
+    edac->detail_loaded = 1;
 
-    dlist_for_each_data (dirs, subdir, char) {
-        int  n;
-        char fq_subdir [SYSFS_PATH_MAX + 1];
+    return (0);
+
+fail:
+    edac_topology_destroy (edac);
+    return (-1);
+}
+
+/*  Load topology and counters from the segment named by
+ *   edac_handle_attach_shm (). Returns <0, leaving the handle empty,
+ *   if there is no live publisher for the same EDAC root.
+ */
+static int
+edac_shm_load (edac_handle *edac)
+{
+    struct edac_shm_header *c = NULL;
+    edac_shm *              shm;
+    int                     tries;
 
-        memset (fq_subdir, 0, sizeof (fq_subdir));
+    if (!(shm = edac_shm_attach (edac->shm_name)))
+        return (-1);
 
-        if (!sysfs_path_is_dir (subdir)) {
+    /*  Take a consistent private copy of the whole segment, then parse
+     *   the copy at leisure.
+     */
+    for (tries = 0; tries < EDAC_SHM_RETRIES; tries++) {
+        struct edac_shm_header *h = edac_shm_header (shm);
+        uint32_t                seq = edac_shm_read_begin (h);
+        uint64_t                size = h->size;
+        void *                  p;
+
+        if ((seq & 1) || (size < sizeof (*h))) {
+            sched_yield ();
             continue;
         }
 
-        n = snprintf (fq_subdir, SYSFS_PATH_MAX, "%s/%s", path, subdir);
-
-        if ((n < 0) || (n > SYSFS_PATH_MAX)) {
+        if (size > edac_shm_length (shm)) {
+            if (edac_shm_remap (shm) < 0)
+                break;
             continue;
         }
 
-        if (!(child = _sysfs_open_device_tree (fq_subdir))) {
+        if (!(p = realloc (c, size)))
+            break;
+        c = p;
+        memcpy (c, h, size);
+
+        if (!edac_shm_read_retry (h, seq))
+            break;
+        sched_yield ();
+    }
+
+    if (  (tries == EDAC_SHM_RETRIES) || (c == NULL)
+       || (shm_topology_parse (edac, c) < 0)) {
+        free (c);
+        edac_shm_destroy (shm);
+        return (-1);
+    }
+
+    edac->shm =            shm;
+    edac->shm_gen =        c->generation;
+    edac->shm_off_values = c->off_values;
+    free (c);
+
+    return (0);
+}
+
+/*  Copy the latest published sample into the store. Fails if the
+ *   publisher has exited, even if killed without cleaning up, or has
+ *   changed the layout since it was loaded.
+ */
+static int
+edac_shm_sample (edac_handle *edac)
+{
+    struct edac_shm_header *h = edac_shm_header (edac->shm);
+    struct edac_store *     s = &edac->store;
+    struct edac_totals      t;
+    int                     tries;
+
+    for (tries = 0; tries < EDAC_SHM_RETRIES; tries++) {
+        uint32_t seq = edac_shm_read_begin (h);
+
+        if (seq & 1) {
+            sched_yield ();
             continue;
         }
 
-        if (!dev->children) {
-            _dev_create_child_list (dev);
+        if (  (h->generation != edac->shm_gen)
+           || !edac_shm_publisher_alive (h))
+            return (-1);
+
+        memcpy (s->values, (char *) h + edac->shm_off_values,
+                s->nvalues * sizeof (uint64_t));
+        t = h->totals;
+
+        if (!edac_shm_read_retry (h, seq)) {
+            edac->totals = t;
+            return (0);
         }
+    }
+
+    return (-1);
+}
+
+/*  Counters not read through io_uring, sampled in chunks of
+ *   EDAC_SAMPLE_CHUNK on the worker pool.
+ */
+struct sample_job {
+    struct edac_handle *   edac;
+    int                    rc;             /* <0 if any counter failed       */
+};
+
+/*  Sample counters in chunk `job' of the store. Pool job.
+ */
+static void
+store_sample_chunk (void *arg, unsigned int job)
+{
+    struct sample_job * j = arg;
+    struct edac_handle *edac = j->edac;
+    int                 batched = (edac->batch.ring != NULL);
+    unsigned int        i = job * EDAC_SAMPLE_CHUNK;
+    unsigned int        last = i + EDAC_SAMPLE_CHUNK;
+
+    if (last > edac->store.nvalues)
+        last = edac->store.nvalues;
+
+    for (; i < last; i++) {
+        struct edac_counter *c = &edac->counters[i];
+        if ((c->name[0] == '\0') || (batched && (c->fd >= 0)))
+            continue;
+        if (edac_counter_sample (c, &edac->store.values[i]) < 0)
+            __sync_lock_test_and_set (&j->rc, -1);
+    }
+}
 
-        dlist_push (dev->children, child);
+/*  Resample every counter in the store and recompute the handle's
+ *   totals from the new values, so edac_error_totals () is a copy.
+ *   Totals are updated even if some counter could not be read, so
+ *   that they always match the values in the store.
+ */
+static int edac_store_sample (edac_handle *edac)
+{
+    struct edac_store * s = &edac->store;
+    struct edac_totals *t = &edac->totals;
+    struct edac_batch * b = &edac->batch;
+    struct sample_job   j;
+    unsigned int        i;
+    int                 rc = 0;
+
+    if (edac->shm)
+        return (edac_shm_sample (edac));
+
+    /*  A ring which fails as a whole is dropped for good; counters
+     *   which fail individually are retried below with pread(2).
+     */
+    if (b->ring && (edac_uring_read (b->ring, b->bufs, b->res) < 0))
+        edac_batch_destroy (b);
+
+    for (i = 0; i < b->n; i++) {
+        if (b->res[i] >= 0)
+            s->values[b->counter[i]] =
+                strtoull (b->bufs + i * EDAC_URING_BUFLEN, NULL, 10);
+        else if (edac_counter_sample (&edac->counters[b->counter[i]],
+                                      &s->values[b->counter[i]]) < 0)
+            rc = -1;
     }
 
-    sysfs_close_list (dirs);
+    j.edac = edac;
+    j.rc =   rc;
+    edac_pool_run (edac_handle_pool (edac), store_sample_chunk, &j,
+                   (s->nvalues + EDAC_SAMPLE_CHUNK - 1) / EDAC_SAMPLE_CHUNK);
+    rc = j.rc;
+
+    memset (t, 0, sizeof (*t));
+    for (i = 0; i < edac->nmcs; i++) {
+        t->ce_total += s->mc_ce[i];
+        t->ue_total += s->mc_ue[i];
+    }
+    if (s->pci_parity)
+        t->pci_parity_total = *s->pci_parity;
 
-    return (dev);
+    return (rc);
 }
-#endif /* HAVE_SYSFS_OPEN_DEVICE_TREE */
 
 
 /* vi: ts=4 sw=4 expandtab 
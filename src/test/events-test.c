@@ -0,0 +1,214 @@
+/*****************************************************************************
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2005-2007 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  Written by Mark Grondona <mgrondona@llnl.gov>
+ *  UCRL-CODE-230739.
+ *
+ *  This file is part of edac-utils.
+ *
+ *  This is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *****************************************************************************/
+
+/*
+ *  events-test: decode the recorded trace pages under events/ with
+ *   edac_events_read () and check the mc_event records found.
+ *
+ *   events/kernel     pages recorded from a live kernel, holding only
+ *                     ftrace print records, inline and with a length
+ *                     word, between time extends. No event is decoded.
+ *   events/mc_event   one corrected error for each channel of a 1x2x2
+ *                     tree, as written by edac-mktree --events.
+ *   events/corrupt    events/mc_event with the length word of the
+ *                     MC0_CS1_CH0 record zeroed. The rest of that page
+ *                     must be dropped, and decoding must not hang.
+ */
+
+#if HAVE_CONFIG_H
+#  include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <edac.h>
+
+/*****************************************************************************
+ *  Data Types
+ *****************************************************************************/
+
+struct expect {
+    const char *       label;               /* DIMM label of the record   */
+    int                row;                 /* Top layer                  */
+    int                channel;             /* Middle layer               */
+    unsigned long long syndrome;            /* Syndrome, 0x1234 + n       */
+};
+
+/*****************************************************************************
+ *  Prototypes
+ *****************************************************************************/
+
+static void fail (const char *name, const char *fmt, ...)
+    __attribute__ ((format (printf, 2, 3)));
+
+/*****************************************************************************
+ *  Private Functions
+ *****************************************************************************/
+
+static const struct expect mc_event_records[] = {
+    { "MC0_CS0_CH0", 0, 0, 0x1234 },
+    { "MC0_CS0_CH1", 0, 1, 0x1235 },
+    { "MC0_CS1_CH0", 1, 0, 0x1236 },
+    { "MC0_CS1_CH1", 1, 1, 0x1237 },
+};
+
+static int failures = 0;
+
+static void fail (const char *name, const char *fmt, ...)
+{
+    va_list ap;
+
+    fprintf (stderr, "FAIL: %s: ", name);
+    va_start (ap, fmt);
+    vfprintf (stderr, fmt, ap);
+    va_end (ap);
+    fputc ('\n', stderr);
+    failures++;
+}
+
+/*  Read all events recorded under fixture `name' into `events'.
+ *   Returns the count, or -1 after reporting a failure.
+ */
+static int read_fixture (const char *name, struct edac_event *events,
+        int len)
+{
+    const char * srcdir = getenv ("srcdir");
+    char         root[4096];
+    edac_events *ev;
+    int          n, total = 0;
+
+    snprintf (root, sizeof (root), "%s/events/%s", srcdir ? srcdir : ".",
+              name);
+
+    if (!(ev = edac_events_open (root, 0))) {
+        fail (name, "edac_events_open (%s): %m", root);
+        return (-1);
+    }
+
+    while ((n = edac_events_read (ev, events + total, len - total)) > 0) {
+        total += n;
+        if (total == len)
+            break;
+    }
+
+    if (n < 0) {
+        fail (name, "edac_events_read: %m");
+        total = -1;
+    }
+    else if (edac_events_lost (ev) != 0)
+        fail (name, "%llu events reported lost", edac_events_lost (ev));
+
+    edac_events_close (ev);
+    return (total);
+}
+
+static const struct edac_event *
+find_event (const struct edac_event *events, int n, const char *label)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        if (strcmp (events[i].label, label) == 0)
+            return (&events[i]);
+    }
+    return (NULL);
+}
+
+/*  Check that events[] holds exactly the records of mc_event_records[]
+ *   other than `missing' (if not NULL).
+ */
+static void check_records (const char *name, const struct edac_event *events,
+        int n, const char *missing)
+{
+    int want = 0;
+    int i;
+
+    for (i = 0; i < (int) (sizeof (mc_event_records) /
+                           sizeof (mc_event_records[0])); i++) {
+        const struct expect *x = &mc_event_records[i];
+        const struct edac_event *e = find_event (events, n, x->label);
+
+        if (missing && (strcmp (x->label, missing) == 0)) {
+            if (e)
+                fail (name, "%s decoded from a corrupt record", x->label);
+            continue;
+        }
+        want++;
+
+        if (!e) {
+            fail (name, "%s not decoded", x->label);
+            continue;
+        }
+        if (  (e->type != EDAC_EVENT_CORRECTED) || (e->count != 1)
+           || (e->mc != 0) || (e->layer[0] != x->row)
+           || (e->layer[1] != x->channel) || (e->layer[2] != -1))
+            fail (name, "%s: type %d count %u at mc%u %d:%d:%d", x->label,
+                  e->type, e->count, e->mc,
+                  e->layer[0], e->layer[1], e->layer[2]);
+        if ((e->grain != 64) || (e->syndrome != x->syndrome))
+            fail (name, "%s: grain %llu syndrome 0x%llx", x->label,
+                  e->grain, e->syndrome);
+        if (strcmp (e->msg, "memory read error") || e->detail[0])
+            fail (name, "%s: msg \"%s\" detail \"%s\"", x->label,
+                  e->msg, e->detail);
+        if (e->cpu != i % 2)
+            fail (name, "%s: logged by cpu %d", x->label, e->cpu);
+    }
+
+    if (n != want)
+        fail (name, "%d events decoded, expected %d", n, want);
+}
+
+/*****************************************************************************
+ *  Functions
+ *****************************************************************************/
+
+int main (void)
+{
+    struct edac_event events[16];
+    int               n;
+
+    /*  A corrupt page must not leave the decoder spinning
+     */
+    alarm (10);
+
+    if ((n = read_fixture ("kernel", events, 16)) > 0)
+        fail ("kernel", "%d events decoded from print records", n);
+
+    if ((n = read_fixture ("mc_event", events, 16)) >= 0)
+        check_records ("mc_event", events, n, NULL);
+
+    if ((n = read_fixture ("corrupt", events, 16)) >= 0)
+        check_records ("corrupt", events, n, "MC0_CS1_CH0");
+
+    return (failures ? 1 : 0);
+}
+
+/* vi: ts=4 sw=4 expandtab
+ */
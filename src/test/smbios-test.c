@@ -0,0 +1,179 @@
+/*****************************************************************************
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2005-2007 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  Written by Mark Grondona <mgrondona@llnl.gov>
+ *  UCRL-CODE-230739.
+ *
+ *  This file is part of edac-utils.
+ *
+ *  This is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *****************************************************************************/
+
+/*
+ *  smbios-test: read the SMBIOS tables under smbios/ with the reader
+ *   edac-labels uses and check the mainboard and memory devices found.
+ *
+ *   smbios/server.dmi  SMBIOS 3.2 table of a two socket board, with
+ *                      BIOS, system, baseboard, memory array and
+ *                      full length type 17 structures. DIMMs of 32 and
+ *                      64 GB give their size in the extended size
+ *                      field (size 0x7fff), and there is an empty
+ *                      socket and one of unknown size (0xffff).
+ *   smbios/kb.dmi      SMBIOS 2.3 table with no baseboard structure and
+ *                      type 17 sizes in KB (bit 15 set).
+ */
+
+#if HAVE_CONFIG_H
+#  include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "smbios.h"
+
+/*****************************************************************************
+ *  Data Types
+ *****************************************************************************/
+
+struct expect {
+    unsigned int  handle;                   /* Structure handle           */
+    const char *  locator;                  /* Device locator             */
+    const char *  bank_locator;             /* Bank locator               */
+    unsigned long size_mb;                  /* Size in MB                 */
+};
+
+struct table {
+    const char *          name;             /* File under smbios/         */
+    const char *          vendor;           /* Mainboard vendor           */
+    const char *          model;            /* Mainboard model            */
+    const struct expect * memdevs;          /* Memory devices in order    */
+    int                   nmemdevs;         /* Number of memory devices   */
+};
+
+/*****************************************************************************
+ *  Prototypes
+ *****************************************************************************/
+
+static void fail (const char *name, const char *fmt, ...)
+    __attribute__ ((format (printf, 2, 3)));
+
+/*****************************************************************************
+ *  Private Functions
+ *****************************************************************************/
+
+static const struct expect server_memdevs[] = {
+    { 0x0029, "P1-DIMMA1", "P0_Node0_Channel0_Dimm0", 32768 },
+    { 0x002b, "P1-DIMMA2", "P0_Node0_Channel0_Dimm1", 0     },
+    { 0x002d, "P1-DIMMB1", "P0_Node0_Channel1_Dimm0", 65536 },
+    { 0x002f, "P1-DIMMC1", "P0_Node0_Channel2_Dimm0", 16384 },
+    { 0x0031, "P2-DIMMD1", "P1_Node1_Channel0_Dimm0", 0     },
+};
+
+static const struct expect kb_memdevs[] = {
+    { 0x0011, "DIMM0", "BANK0", 16 },
+    { 0x0012, "DIMM1", "BANK1", 8  },
+    { 0x0013, "DIMM2", "BANK2", 0  },
+};
+
+static const struct table tables[] = {
+    { "server.dmi", "Supermicro", "X11DPH-T", server_memdevs, 5 },
+    { "kb.dmi", "Acme Embedded", "EB-430", kb_memdevs, 3 },
+};
+
+static int failures = 0;
+
+static void fail (const char *name, const char *fmt, ...)
+{
+    va_list ap;
+
+    fprintf (stderr, "FAIL: %s: ", name);
+    va_start (ap, fmt);
+    vfprintf (stderr, fmt, ap);
+    va_end (ap);
+    fputc ('\n', stderr);
+    failures++;
+}
+
+static void check_table (const struct table *t)
+{
+    const char *         srcdir = getenv ("srcdir");
+    char                 path[4096];
+    char                 vendor[SMBIOS_STRING_LEN];
+    char                 model[SMBIOS_STRING_LEN];
+    struct smbios_memdev devs[16];
+    smbios_t *           s;
+    int                  i, n;
+
+    snprintf (path, sizeof (path), "%s/smbios/%s", srcdir ? srcdir : ".",
+              t->name);
+
+    if (!(s = smbios_open (path))) {
+        fail (t->name, "smbios_open (%s): %m", path);
+        return;
+    }
+
+    if (smbios_board (s, vendor, sizeof (vendor), model, sizeof (model)) < 0)
+        fail (t->name, "no mainboard found");
+    else if (strcmp (vendor, t->vendor) || strcmp (model, t->model))
+        fail (t->name, "mainboard \"%s\" \"%s\"", vendor, model);
+
+    if ((n = smbios_memdevs (s, NULL, 0)) != t->nmemdevs)
+        fail (t->name, "%d memory devices counted", n);
+
+    /*  A short array is filled in order, and the total still returned
+     */
+    memset (devs, 0, sizeof (devs));
+    if (  ((n = smbios_memdevs (s, devs, 2)) != t->nmemdevs)
+       || (devs[0].handle != t->memdevs[0].handle)
+       || (devs[2].handle != 0))
+        fail (t->name, "%d memory devices into 2 slots", n);
+
+    n = smbios_memdevs (s, devs, 16);
+    for (i = 0; (i < n) && (i < t->nmemdevs); i++) {
+        const struct expect *x = &t->memdevs[i];
+        if (  (devs[i].handle != x->handle)
+           || strcmp (devs[i].locator, x->locator)
+           || strcmp (devs[i].bank_locator, x->bank_locator))
+            fail (t->name, "device %d: handle 0x%04x \"%s\" \"%s\"", i,
+                  devs[i].handle, devs[i].locator, devs[i].bank_locator);
+        if (devs[i].size_mb != x->size_mb)
+            fail (t->name, "%s: %lu MB, expected %lu", x->locator,
+                  devs[i].size_mb, x->size_mb);
+    }
+
+    smbios_close (s);
+}
+
+/*****************************************************************************
+ *  Functions
+ *****************************************************************************/
+
+int main (void)
+{
+    unsigned int i;
+
+    for (i = 0; i < sizeof (tables) / sizeof (tables[0]); i++)
+        check_table (&tables[i]);
+
+    return (failures ? 1 : 0);
+}
+
+/* vi: ts=4 sw=4 expandtab
+ */
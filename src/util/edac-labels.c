@@ -0,0 +1,835 @@
+/*****************************************************************************
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2005-2007 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  Written by Mark Grondona <mgrondona@llnl.gov>
+ *  UCRL-CODE-230739.
+ *
+ *  This file is part of edac-utils.
+ *
+ *  This is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *****************************************************************************/
+
+/*
+ *  edac-labels: compile and query the DIMM label database, and
+ *   register the labels of this mainboard with the EDAC drivers.
+ */
+
+#if HAVE_CONFIG_H
+#  include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <edac.h>
+
+#include "smbios.h"
+
+#ifndef SYSCONFDIR
+#  define SYSCONFDIR "/etc"
+#endif
+
+#define MAINBOARD_CONFIG  SYSCONFDIR "/edac/mainboard"
+#define DMI_ID_DIR        "/sys/class/dmi/id"
+#define EDAC_SYSFS_ROOT   "/sys/devices/system/edac"
+
+/*****************************************************************************
+ *  Command-Line Options
+ *****************************************************************************/
+
+#include <getopt.h>
+struct option opt_table[] = {
+    { "help",         0, NULL, 'h' },
+    { "quiet",        0, NULL, 'q' },
+    { "labeldb",      1, NULL, 'd' },
+    { "labeldir",     1, NULL, 'D' },
+    { "cache",        1, NULL, 'C' },
+    { "compile",      0, NULL, 'c' },
+    { "vendor",       1, NULL, 'V' },
+    { "model",        1, NULL, 'M' },
+    { "register",     0, NULL, 'r' },
+    { "dry-run",      0, NULL, 'n' },
+    { "delay",        1, NULL, 'w' },
+    { "mainboard",    0, NULL, 'm' },
+    { "guess",        0, NULL, 'g' },
+    { "smbios",       1, NULL, 'S' },
+    {  NULL,          0, NULL,  0  }
+};
+
+const char * const opt_string = "hqd:D:C:cV:M:rnw:mgS:";
+
+#define USAGE "\
+Usage: %s [OPTIONS]\n\
+  -h, --help           Display this help\n\
+  -q, --quiet          Display only fatal errors\n\
+  -d, --labeldb=DB     Read DIMM labels from file DB\n\
+  -D, --labeldir=DIR   Also read DIMM labels from the files in DIR\n\
+  -C, --cache=FILE     Use FILE for the compiled label database\n\
+  -c, --compile        Compile the label database and exit\n\
+  -V, --vendor=VENDOR  Mainboard vendor (default: detected)\n\
+  -M, --model=MODEL    Mainboard model (default: detected)\n\
+  -r, --register       Write changed DIMM labels to the EDAC drivers\n\
+  -n, --dry-run        With --register, only display what would change\n\
+  -w, --delay=SECS     With --register, wait SECS before writing labels\n\
+  -m, --mainboard      Display the detected mainboard vendor and model\n\
+  -g, --guess          Propose labels from the SMBIOS memory devices\n\
+  -S, --smbios=FILE    Read the SMBIOS table from FILE\n"
+
+
+/*****************************************************************************
+ *  Data Types
+ *****************************************************************************/
+
+/*  Program context
+ */
+struct prog_ctx {
+    char *progname;
+    int quiet;
+    char *labeldb;
+    char *labeldir;
+    char *cache;
+    int compile;
+    char *vendor;
+    char *model;
+    int do_register;
+    int dry_run;
+    double delay;
+    int mainboard;
+    int guess;
+    char *smbios;
+};
+
+static struct prog_ctx prog_ctx = { NULL, 0, NULL, NULL, NULL, 0, 
+                                    NULL, NULL, 0, 0, 0, 0, 0, NULL };
+
+
+/*****************************************************************************
+ *  Prototypes
+ *****************************************************************************/
+
+static void parse_cmdline (struct prog_ctx *, int ac, char **av);
+
+static void mainboard_detect (struct prog_ctx *ctx);
+
+static int print_labels (struct prog_ctx *ctx);
+
+static int register_labels (struct prog_ctx *ctx);
+
+static int guess_labels (struct prog_ctx *ctx);
+
+static void log_fatal (int errnum, const char *format, ...);
+
+static void log_err (const char *format, ...);
+
+
+/*****************************************************************************
+ *  Functions
+ *****************************************************************************/
+
+int main (int ac, char *av[])
+{
+    char *prog;
+
+    prog = (prog = strrchr (av[0], '/')) ? prog + 1 : av[0];
+    prog_ctx.progname = prog;
+
+    parse_cmdline (&prog_ctx, ac, av);
+
+    if (prog_ctx.compile) {
+        if (edac_labeldb_compile (prog_ctx.labeldb, prog_ctx.labeldir, 
+                                  prog_ctx.cache) < 0)
+            log_fatal (1, "Unable to compile label database: %s\n", 
+                       strerror (errno));
+        return (0);
+    }
+
+    mainboard_detect (&prog_ctx);
+
+    if (prog_ctx.mainboard) {
+        fprintf (stdout, "vendor = %s\nmodel = %s\n", 
+                 prog_ctx.vendor, prog_ctx.model);
+        return (0);
+    }
+
+    if (prog_ctx.guess)
+        return (guess_labels (&prog_ctx));
+
+    if (prog_ctx.do_register)
+        return (register_labels (&prog_ctx));
+
+    return (print_labels (&prog_ctx));
+}
+
+static void
+parse_cmdline (struct prog_ctx *ctx, int ac, char **av)
+{
+    char *p;
+    int   c;
+
+    opterr = 0;
+
+    while ((c = getopt_long (ac, av, opt_string, opt_table, NULL)) != -1) {
+        switch (c) {
+            case 'h':
+                fprintf (stderr, USAGE, ctx->progname);
+                exit (0);
+                break;
+            case 'q':
+                ctx->quiet++;
+                break;
+            case 'd':
+                ctx->labeldb = optarg;
+                break;
+            case 'D':
+                ctx->labeldir = optarg;
+                break;
+            case 'C':
+                ctx->cache = optarg;
+                break;
+            case 'c':
+                ctx->compile = 1;
+                break;
+            case 'V':
+                ctx->vendor = optarg;
+                break;
+            case 'M':
+                ctx->model = optarg;
+                break;
+            case 'r':
+                ctx->do_register = 1;
+                break;
+            case 'n':
+                ctx->dry_run = 1;
+                break;
+            case 'w':
+                ctx->delay = strtod (optarg, &p);
+                if ((*p != '\0') || !(ctx->delay >= 0.0)
+                   || (ctx->delay > 86400.0))
+                    log_fatal (1, "Invalid delay \"%s\"\n", optarg);
+                break;
+            case 'm':
+                ctx->mainboard = 1;
+                break;
+            case 'g':
+                ctx->guess = 1;
+                break;
+            case 'S':
+                ctx->smbios = optarg;
+                break;
+            case '?':
+                if (optopt > 0)
+                    log_fatal (1, "Invalid option \"-%c\"\n", optopt);
+                else
+                    log_fatal (1, "Invalid option \"%s\"\n", av[optind - 1]);
+                break;
+            default:
+                log_fatal (1, "Unimplemented option \"%s\"\n", 
+                           av[optind - 1]);
+                break;
+        }
+    }
+
+    if (av[optind])
+        log_fatal (1, "Unrecognized parameter \"%s\"\n", av[optind]);
+
+    if ((ctx->compile + ctx->do_register + ctx->mainboard + ctx->guess) > 1)
+        log_fatal (1, "Only one of --compile, --register, --mainboard "
+                      "and --guess may be used\n");
+
+    if (ctx->compile && (ctx->vendor || ctx->model || ctx->smbios))
+        log_fatal (1, "--compile may not be used with --vendor, --model "
+                      "or --smbios\n");
+
+    if ((ctx->dry_run || (ctx->delay > 0.0)) && !ctx->do_register)
+        log_fatal (1, "--dry-run and --delay require --register\n");
+}
+
+/*  Copy `s' without surrounding whitespace into a new string
+ */
+static char *
+strip (const char *s)
+{
+    const char *end = s + strlen (s);
+    char *      p;
+
+    while (isspace ((unsigned char) *s))
+        s++;
+    while ((end > s) && isspace ((unsigned char) end[-1]))
+        end--;
+
+    if (!(p = strndup (s, end - s)))
+        log_fatal (1, "Out of memory\n");
+
+    return (p);
+}
+
+/*  Read the first line of file `path' into a new string, or NULL
+ */
+static char *
+read_line (const char *path)
+{
+    char  buf[1024];
+    FILE *fp;
+    char *p = NULL;
+
+    if (!(fp = fopen (path, "r")))
+        return (NULL);
+    if (fgets (buf, sizeof (buf), fp))
+        p = strip (buf);
+    fclose (fp);
+
+    return (p);
+}
+
+/*  Read "vendor = ..." and "model = ..." from the mainboard config
+ *   file `fp', as edac-ctl does. A "script = ..." line names a 
+ *   program whose output is read the same way.
+ */
+static int
+mainboard_config (struct prog_ctx *ctx, FILE *fp, int depth)
+{
+    char  buf[1024];
+    char *script = NULL;
+    int   rc = 0;
+
+    while (fgets (buf, sizeof (buf), fp)) {
+        char *key = buf;
+        char *val;
+        char *p;
+
+        if ((p = strchr (buf, '#')))
+            *p = '\0';
+        if (!(val = strchr (buf, '=')))
+            continue;
+        *val++ = '\0';
+
+        key = strip (key);
+        val = strip (val);
+
+        if (!ctx->vendor && (strcmp (key, "vendor") == 0))
+            ctx->vendor = val;
+        else if (!ctx->model && (strcmp (key, "model") == 0))
+            ctx->model = val;
+        else if (!script && (strcmp (key, "script") == 0))
+            script = val;
+        else
+            free (val);
+        free (key);
+    }
+
+    if (script && (depth == 0)) {
+        FILE *sp;
+        if (!(sp = popen (script, "r")))
+            log_fatal (1, "Failed to run mainboard script %s\n", script);
+        mainboard_config (ctx, sp, depth + 1);
+        if (pclose (sp) != 0)
+            rc = -1;
+    }
+    free (script);
+
+    return (rc);
+}
+
+/*  Fill in the mainboard vendor and model still unknown from the
+ *   baseboard (or system) structure of the SMBIOS table.
+ */
+static void
+smbios_board_detect (struct prog_ctx *ctx)
+{
+    char      vendor[SMBIOS_STRING_LEN];
+    char      model[SMBIOS_STRING_LEN];
+    smbios_t *s;
+
+    if (!(s = smbios_open (ctx->smbios))) {
+        if (ctx->smbios)
+            log_fatal (1, "Unable to read SMBIOS table %s: %s\n",
+                       ctx->smbios, strerror (errno));
+        return;
+    }
+
+    if (!smbios_board (s, vendor, sizeof (vendor), model, sizeof (model))) {
+        if ((!ctx->vendor || !*ctx->vendor) && *vendor)
+            ctx->vendor = strip (vendor);
+        if ((!ctx->model || !*ctx->model) && *model)
+            ctx->model = strip (model);
+    }
+
+    smbios_close (s);
+}
+
+/*  Find the mainboard vendor and model not given on the command line:
+ *   from the mainboard config file if there is one, as for edac-ctl,
+ *   otherwise from DMI in sysfs or the SMBIOS table. With --smbios,
+ *   only the given table is read.
+ */
+static void
+mainboard_detect (struct prog_ctx *ctx)
+{
+    FILE *fp;
+
+    if (ctx->vendor && ctx->model)
+        return;
+
+    if ((fp = fopen (MAINBOARD_CONFIG, "r"))) {
+        if (mainboard_config (ctx, fp, 0) < 0)
+            log_fatal (1, "Failed to run mainboard script\n");
+        fclose (fp);
+    }
+    else if (!ctx->smbios) {
+        if (!ctx->vendor)
+            ctx->vendor = read_line (DMI_ID_DIR "/board_vendor");
+        if (!ctx->model)
+            ctx->model = read_line (DMI_ID_DIR "/board_name");
+    }
+
+    /*  Without DMI in sysfs, read the SMBIOS table as dmidecode would
+     */
+    if (!ctx->vendor || !ctx->model || !*ctx->vendor || !*ctx->model)
+        smbios_board_detect (ctx);
+
+    if (!ctx->vendor || !ctx->model || !*ctx->vendor || !*ctx->model)
+        log_fatal (1, "Unable to find mainboard vendor and model. "
+                      "Use --vendor and --model\n");
+}
+
+/*  Look up the labels of mainboard ctx->vendor ctx->model in `ldb'.
+ *   Returns their number, or <0 if the mainboard has none.
+ */
+static int
+board_labels (struct prog_ctx *ctx, edac_labeldb *ldb, 
+        struct edac_label **labelsp)
+{
+    struct edac_label *labels;
+    int                n;
+
+    if ((n = edac_labeldb_lookup (ldb, ctx->vendor, ctx->model, NULL, 0)) < 0) {
+        log_err ("No DIMM labels for %s %s\n", ctx->vendor, ctx->model);
+        return (-1);
+    }
+
+    if (!(labels = malloc ((n + 1) * sizeof (*labels))))
+        log_fatal (1, "Out of memory\n");
+
+    *labelsp = labels;
+
+    return (edac_labeldb_lookup (ldb, ctx->vendor, ctx->model, labels, n));
+}
+
+static edac_labeldb *
+labeldb_open (struct prog_ctx *ctx)
+{
+    edac_labeldb *ldb;
+
+    if (!(ldb = edac_labeldb_open (ctx->labeldb, ctx->labeldir, ctx->cache)))
+        log_fatal (1, "Unable to read label database: %s\n", 
+                   strerror (errno));
+
+    return (ldb);
+}
+
+/*  Display the labels of mainboard ctx->vendor ctx->model, one 
+ *   "MC.ROW.CHANNEL LABEL" line per csrow channel.
+ */
+static int
+print_labels (struct prog_ctx *ctx)
+{
+    struct edac_label *labels;
+    edac_labeldb *     ldb = labeldb_open (ctx);
+    int                n;
+    int                i;
+
+    if ((n = board_labels (ctx, ldb, &labels)) < 0) {
+        edac_labeldb_close (ldb);
+        return (1);
+    }
+
+    for (i = 0; i < n; i++)
+        fprintf (stdout, "%u.%u.%u %s\n", labels[i].mc, labels[i].row,
+                 labels[i].channel, labels[i].label);
+
+    free (labels);
+    edac_labeldb_close (ldb);
+
+    return (0);
+}
+
+/*  Write `label' to sysfs file `path' unless `cur' is already the same,
+ *   and report the change as one of location `loc'. Returns 1 if the
+ *   label changed, 0 if not, and -1 on error.
+ */
+static int
+label_update (struct prog_ctx *ctx, const char *path, const char *loc,
+        const char *cur, const char *label)
+{
+    size_t  len = strlen (label);
+    ssize_t n;
+    int     fd;
+
+    if (strcmp (cur, label) == 0)
+        return (0);
+
+    if (!ctx->dry_run) {
+        if ((fd = open (path, O_WRONLY | O_TRUNC | O_CLOEXEC)) < 0) {
+            log_err ("Unable to open %s: %s\n", path, strerror (errno));
+            return (-1);
+        }
+        if ((n = write (fd, label, len)) < 0 || (size_t) n != len) {
+            log_err ("Unable to write %s: %s\n", path,
+                     (n < 0) ? strerror (errno) : "Short write");
+            close (fd);
+            return (-1);
+        }
+        if (close (fd) < 0) {
+            log_err ("Unable to write %s: %s\n", path, strerror (errno));
+            return (-1);
+        }
+    }
+
+    if (!ctx->quiet)
+        fprintf (stdout, "%s: \"%s\" -> \"%s\"\n", loc, cur, label);
+
+    return (1);
+}
+
+/*  Update the label of one csrow channel or DIMM at `loc' (relative to
+ *   the EDAC sysfs root `root') from current label `cur'.
+ */
+static int
+label_register (struct prog_ctx *ctx, const char *root, const char *loc,
+        int valid, const char *cur, const char *label)
+{
+    char  path[4096];
+    char *old;
+    int   rc;
+
+    snprintf (path, sizeof (path), "%s/mc/%s", root, loc);
+
+    /*  The driver may keep a trailing newline
+     */
+    old = strip (valid ? cur : "");
+    rc = label_update (ctx, path, loc, old, label);
+    free (old);
+
+    return (rc);
+}
+
+/*  Write the DIMM labels of this mainboard which differ from those
+ *   already registered. DIMMs in the mcN/dimmN layout are matched by
+ *   their position in the MC's two layers, and csrow channels of MCs
+ *   without DIMMs by csrow and channel number.
+ */
+static int
+register_labels (struct prog_ctx *ctx)
+{
+    struct edac_label *    labels;
+    struct edac_mc_info    mci;
+    struct edac_csrow_info csi;
+    struct edac_dimm_info  di;
+    edac_labeldb *         ldb = labeldb_open (ctx);
+    edac_handle *          edac;
+    edac_mc *              mc;
+    edac_csrow *           csrow;
+    edac_dimm *            dimm;
+    const char *           root;
+    char                   loc[256];
+    unsigned int           mcnum;
+    unsigned int           row;
+    int                    ndimms;
+    int                    errors = 0;
+    int                    n;
+    int                    i;
+
+    if ((n = board_labels (ctx, ldb, &labels)) < 0) {
+        edac_labeldb_close (ldb);
+        return (1);
+    }
+
+    /*  The delay may be fractional, as forwarded by edac-ctl
+     */
+    if (ctx->delay > 0.0) {
+        struct timespec ts;
+
+        ts.tv_sec =  (time_t) ctx->delay;
+        ts.tv_nsec = (long) ((ctx->delay - ts.tv_sec) * 1e9);
+        while ((nanosleep (&ts, &ts) < 0) && (errno == EINTR))
+            ;
+    }
+
+    if (!(root = getenv (EDAC_SYSFS_ROOT_ENV)))
+        root = EDAC_SYSFS_ROOT;
+
+    if (!(edac = edac_handle_create ()) || (edac_handle_init (edac) < 0))
+        log_fatal (1, "Unable to get EDAC data: %s\n", 
+                   edac ? edac_strerror (edac) : "Out of memory");
+
+    edac_for_each_mc_info (edac, mc, mci) {
+        if (sscanf (mci.id, "mc%u", &mcnum) != 1)
+            continue;
+
+        ndimms = 0;
+        edac_for_each_dimm_info (mc, dimm, di) {
+            ndimms++;
+            if (di.nlayers != 2)
+                continue;
+            for (i = 0; i < n; i++) {
+                if (  (labels[i].mc != mcnum) 
+                   || ((int) labels[i].row != di.location[0])
+                   || ((int) labels[i].channel != di.location[1]))
+                    continue;
+                snprintf (loc, sizeof (loc), "%s/%s/dimm_label", 
+                          mci.id, di.id);
+                if (label_register (ctx, root, loc, di.dimm_label_valid,
+                                    di.dimm_label, labels[i].label) < 0)
+                    errors++;
+            }
+        }
+
+        /*  Legacy csrow label files of an MC with DIMMs are aliases
+         */
+        if (ndimms)
+            continue;
+
+        edac_for_each_csrow_info (mc, csrow, csi) {
+            if (sscanf (csi.id, "csrow%u", &row) != 1)
+                continue;
+            for (i = 0; i < n; i++) {
+                struct edac_channel *ch;
+
+                if (  (labels[i].mc != mcnum) || (labels[i].row != row)
+                   || (labels[i].channel >= EDAC_MAX_CHANNELS))
+                    continue;
+
+                ch = &csi.channel[labels[i].channel];
+                if (!ch->valid)
+                    continue;
+
+                snprintf (loc, sizeof (loc), "%s/%s/ch%u_dimm_label", 
+                          mci.id, csi.id, labels[i].channel);
+                if (label_register (ctx, root, loc, ch->dimm_label_valid,
+                                    ch->dimm_label, labels[i].label) < 0)
+                    errors++;
+            }
+        }
+    }
+
+    edac_handle_destroy (edac);
+    free (labels);
+    edac_labeldb_close (ldb);
+
+    return (errors ? 1 : 0);
+}
+
+/*  A populated DIMM known to EDAC
+ */
+struct guess_dimm {
+    unsigned int          mc;               /* MC number                     */
+    struct edac_dimm_info info;
+};
+
+static int
+guess_dimm_cmp (const void *x, const void *y)
+{
+    const struct guess_dimm *a = x;
+    const struct guess_dimm *b = y;
+    int                      i;
+
+    if (a->mc != b->mc)
+        return ((a->mc < b->mc) ? -1 : 1);
+    for (i = 0; (i < a->info.nlayers) && (i < b->info.nlayers); i++) {
+        if (a->info.location[i] != b->info.location[i])
+            return ((a->info.location[i] < b->info.location[i]) ? -1 : 1);
+    }
+    return (a->info.nlayers - b->info.nlayers);
+}
+
+/*  Name memory device number `n' after its locator, for use in the text
+ *   label database, where ':', ';' and ',' separate fields.
+ */
+static void
+guess_label (const struct smbios_memdev *d, int n, char *buf, size_t len)
+{
+    char *p;
+
+    if (*d->locator)
+        snprintf (buf, len, "%s", d->locator);
+    else if (*d->bank_locator)
+        snprintf (buf, len, "%s", d->bank_locator);
+    else
+        snprintf (buf, len, "DIMM%d", n);
+
+    for (p = buf; *p; p++) {
+        if ((*p == ':') || (*p == ';') || (*p == ','))
+            *p = '_';
+    }
+}
+
+/*  Propose labels for this mainboard by pairing the populated memory
+ *   devices of the SMBIOS table, in table order, with the DIMMs known
+ *   to EDAC in order of MC and location. The proposal is only made if
+ *   there are as many of each and their sizes agree, and is printed
+ *   as a labels.db entry.
+ */
+static int
+guess_labels (struct prog_ctx *ctx)
+{
+    struct smbios_memdev * devs;
+    struct guess_dimm *    dimms = NULL;
+    struct edac_mc_info    mci;
+    struct edac_dimm_info  di;
+    edac_handle *          edac;
+    edac_mc *              mc;
+    edac_dimm *            dimm;
+    smbios_t *             s;
+    char                   label[SMBIOS_STRING_LEN];
+    unsigned int           mcnum;
+    int                    ndevs;
+    int                    ndimms = 0;
+    int                    rc = 1;
+    int                    i, n;
+
+    if (!(s = smbios_open (ctx->smbios)))
+        log_fatal (1, "Unable to read SMBIOS table %s: %s\n",
+                   ctx->smbios ? ctx->smbios : SMBIOS_TABLE_PATH, 
+                   strerror (errno));
+
+    ndevs = smbios_memdevs (s, NULL, 0);
+    if (!(devs = calloc (ndevs + 1, sizeof (*devs))))
+        log_fatal (1, "Out of memory\n");
+    ndevs = smbios_memdevs (s, devs, ndevs);
+    smbios_close (s);
+
+    /*  Drop empty sockets
+     */
+    for (i = n = 0; i < ndevs; i++) {
+        if (devs[i].size_mb)
+            devs[n++] = devs[i];
+    }
+    ndevs = n;
+
+    if (!(edac = edac_handle_create ()) || (edac_handle_init (edac) < 0))
+        log_fatal (1, "Unable to get EDAC data: %s\n", 
+                   edac ? edac_strerror (edac) : "Out of memory");
+
+    edac_for_each_mc_info (edac, mc, mci) {
+        if (sscanf (mci.id, "mc%u", &mcnum) != 1)
+            continue;
+        edac_for_each_dimm_info (mc, dimm, di) {
+            struct guess_dimm *d;
+
+            if (di.size_mb == 0)
+                continue;
+            if (!(d = realloc (dimms, (ndimms + 1) * sizeof (*d))))
+                log_fatal (1, "Out of memory\n");
+            dimms = d;
+            dimms[ndimms].mc = mcnum;
+            dimms[ndimms++].info = di;
+        }
+    }
+
+    edac_handle_destroy (edac);
+
+    if (ndimms == 0) {
+        log_err ("No DIMMs found in EDAC sysfs\n");
+        goto out;
+    }
+    if (ndimms != ndevs) {
+        log_err ("SMBIOS table has %d populated memory devices "
+                 "but EDAC has %d DIMMs\n", ndevs, ndimms);
+        goto out;
+    }
+
+    qsort (dimms, ndimms, sizeof (*dimms), guess_dimm_cmp);
+
+    for (i = 0; i < ndimms; i++) {
+        if (dimms[i].info.size_mb != devs[i].size_mb) {
+            log_err ("Size of %s/%s (%u MB) does not match memory "
+                     "device %s (%lu MB)\n", dimms[i].info.mc_id, 
+                     dimms[i].info.id, dimms[i].info.size_mb, 
+                     devs[i].locator, devs[i].size_mb);
+            goto out;
+        }
+    }
+
+    fprintf (stdout, "# DIMM labels proposed from the SMBIOS memory devices."
+                     "\n# Check them against the mainboard manual.\n");
+    fprintf (stdout, "Vendor: %s\n  Model: %s\n", ctx->vendor, ctx->model);
+
+    for (i = 0; i < ndimms; i++) {
+        struct edac_dimm_info *d = &dimms[i].info;
+
+        guess_label (&devs[i], i, label, sizeof (label));
+
+        /*  labels.db locations only name DIMMs of two layers
+         */
+        if (d->nlayers != 2) {
+            fprintf (stdout, "    # %s: %s/%s\n", label, d->mc_id, d->id);
+            continue;
+        }
+        fprintf (stdout, "    %s: %u.%d.%d\n", label, dimms[i].mc, 
+                 d->location[0], d->location[1]);
+    }
+    rc = 0;
+
+  out:
+    free (dimms);
+    free (devs);
+    return (rc);
+}
+
+static void
+vlog_msg (const char *prefix, const char *format, va_list ap)
+{
+    fprintf (stderr, "%s: ", prog_ctx.progname);
+    if (prefix)
+        fprintf (stderr, "%s: ", prefix);
+    vfprintf (stderr, format, ap);
+}
+
+static void
+log_err (const char *format, ...)
+{
+    va_list ap;
+
+    if (prog_ctx.quiet)
+        return;
+
+    va_start (ap, format);
+    vlog_msg ("Error", format, ap);
+    va_end (ap);
+}
+
+static void
+log_fatal (int rc, const char *format, ...)
+{
+    va_list ap;
+
+    va_start (ap, format);
+    vlog_msg ("Fatal", format, ap);
+    va_end (ap);
+
+    exit (rc);
+}
+
+/*
+ * vi: ts=4 sw=4 expandtab
+ */
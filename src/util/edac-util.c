@@ -31,6 +31,17 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h> 
+#include <signal.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <stdint.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
 #include <edac.h>
 
 #include "list.h"
@@ -47,10 +58,25 @@ struct option opt_table[] = {
     { "verbose",      0, NULL, 'v' },
     { "report",       2, NULL, 'r' },
     { "status",       0, NULL, 's' },
+    { "publish",      0, NULL, 'P' },
+    { "interval",     1, NULL, 'i' },
+    { "watch",        1, NULL, 'w' },
+    { "count",        1, NULL, 'c' },
+    { "windows",      1, NULL, 'W' },
+    { "threshold",    1, NULL, 'T' },
+    { "format",       1, NULL, 'f' },
+    { "listen",       1, NULL, 'l' },
+    { "textfile",     1, NULL, 'o' },
+    { "record",       1, NULL, 'R' },
+    { "history",      1, NULL, 'H' },
+    { "since",        1, NULL, 'S' },
+    { "until",        1, NULL, 'U' },
+    { "layout",       0, NULL, 'L' },
+    { "events",       0, NULL, 'E' },
     {  NULL,          0, NULL,  0  }
 };
 
-const char * const opt_string = "hqvsr::";
+const char * const opt_string = "hqvsr::Pi:w:c:W:T:f:l:o:R:H:S:U:LE";
 
 #define USAGE "\
 Usage: %s [OPTIONS]\n\
@@ -59,14 +85,48 @@ Usage: %s [OPTIONS]\n\
   -v, --verbose        Increase verbosity. Multiple -v's may be used\n\
   -s, --status         Display EDAC status\n\
   -r, --report=REPORT  Display EDAC error report REPORT\n\
+  -P, --publish        Publish EDAC counters in shared memory until killed\n\
+  -i, --interval=SECS  Seconds between samples with --publish, --record or\n\
+                       --textfile (default 1)\n\
+  -w, --watch=SECS     Sample every SECS and display new errors until killed\n\
+  -c, --count=N        With --watch, stop after N samples\n\
+  -W, --windows=LIST   With --watch, also display error counts within each\n\
+                       window in LIST, e.g. 1m,1h,24h\n\
+  -T, --threshold=[LABEL@]WINDOW:COUNT\n\
+                       With --watch, report DIMMs (or only DIMM LABEL) with\n\
+                       COUNT or more errors within WINDOW\n\
+  -f, --format=FORMAT  Display all error counts as FORMAT records\n\
+  -l, --listen=[ADDR:]PORT\n\
+                       Serve Prometheus metrics over HTTP until killed\n\
+  -o, --textfile=PATH  Write Prometheus metrics to PATH until killed\n\
+  -R, --record=PATH    Append EDAC counters to history file PATH until killed\n\
+  -H, --history=PATH   Display errors recorded in history file PATH\n\
+  -S, --since=WHEN     With --history, start at WHEN\n\
+  -U, --until=WHEN     With --history, stop at WHEN\n\
+  -L, --layout         Display a grid of DIMMs by location with error counts\n\
+  -E, --events         Display errors as the kernel reports them until killed\n\
   \n\
-Valid REPORT types are default, simple, full, ue, ce\n"
+Valid REPORT types are default, simple, full, ue, ce\n\
+Valid FORMAT types are text, json, csv, kv\n\
+WHEN is a time ago, e.g. 30m or 2d, or seconds since the Epoch after @\n"
   
 
 /*****************************************************************************
  *  Data Types
  *****************************************************************************/
 
+/*  Maximum number of rate windows for --windows and --threshold
+ */
+#define MAX_WINDOWS 16
+
+/*  Error count threshold given by --threshold
+ */
+struct threshold {
+    char *              label;      /* DIMM label or NULL for all DIMMs  */
+    unsigned int        window;     /* Index into prog_ctx windows       */
+    unsigned long long  count;      /* Errors within window to report    */
+};
+
 /*  Program context
  */
 struct prog_ctx {
@@ -76,14 +136,110 @@ struct prog_ctx {
     int quiet;
     int print_status;
     List reports;
+    int publish;
+    unsigned int interval;
+    double watch;
+    unsigned long count;
+    unsigned int windows[MAX_WINDOWS];
+    unsigned int nwindows;
+    struct threshold *thresholds;
+    int nthresholds;
+    struct format *format;
+    char *listen;
+    char *textfile;
+    char *record;
+    char *history;
+    time_t since;
+    time_t until;
+    int layout;
+    int events;
+};
+
+/*  Growable output buffer
+ */
+struct obuf {
+    char   *data;
+    size_t  len;
+    size_t  size;
+};
+
+/*  Running totals of one report during generate_reports (), and the
+ *   buffer shared by all reports
+ */
+struct report_state {
+    struct obuf * out;
+    unsigned int  count;
+    unsigned int  ce;
+    unsigned int  ue;
+};
+
+/*  A run of bytes written by report `report' into the shared buffer
+ */
+struct report_span {
+    int           report;
+    size_t        off;
+    size_t        len;
+};
+
+/*  Output of all reports, and which report wrote each part of it
+ */
+struct report_output {
+    struct obuf          buf;
+    struct report_span * spans;
+    int                  nspans;
+    int                  size;
 };
 
-typedef void (*report_f) (struct prog_ctx *);
+/*  A report is a set of callbacks fed by one walk of the handle:
+ *   mc_begin () and mc_end () around each MC, csrow () for each of
+ *   its csrows, and end () with the error totals. Any may be NULL,
+ *   and csrows are only read if some selected report wants them.
+ */
+typedef void (*report_mc_f) (struct prog_ctx *, struct report_state *,
+        const edac_mc *);
+typedef void (*report_csrow_f) (struct prog_ctx *, struct report_state *,
+        const edac_mc *, const edac_csrow *);
+typedef void (*report_end_f) (struct prog_ctx *, struct report_state *,
+        const struct edac_totals *);
 
 struct report {
     int   id;
-    report_f report;
     char *name;
+    report_mc_f    mc_begin;
+    report_csrow_f csrow;
+    report_mc_f    mc_end;
+    report_end_f   end;
+};
+
+/*  Kinds of record, by which of `ce' and `ue' they count
+ */
+enum record_type {
+    RECORD_NOINFO,                          /* ce and ue with no DIMM info   */
+    RECORD_CSROW,                           /* ue of a csrow                 */
+    RECORD_CHANNEL,                         /* ce of a csrow channel         */
+    RECORD_DIMM                             /* ce and ue of a DIMM           */
+};
+
+/*  One error count location, as emitted by --format. Strings which do
+ *   not apply to the location are NULL, and `channel' is -1 if unused.
+ */
+struct record {
+    enum record_type type;
+    const char   *mc;
+    const char   *csrow;
+    int           channel;
+    const char   *dimm;
+    const char   *label;
+    unsigned int  ce;
+    unsigned int  ue;
+};
+
+typedef void (*record_f) (const struct record *, void *arg);
+
+struct format {
+    char     *name;
+    void    (*header) (void);
+    record_f  record;
 };
 
 enum report_type {
@@ -98,26 +254,69 @@ enum report_type {
  *  Globals
  *****************************************************************************/
 
-static struct prog_ctx prog_ctx = { NULL, NULL, 0, 0, 0, NULL }; 
+static struct prog_ctx prog_ctx = { NULL, NULL, 0, 0, 0, NULL, 
+                                    0, 1, 0.0, 0, { 0 }, 0, NULL, 0,
+                                    NULL, NULL, NULL, NULL, NULL, 0, 0,
+                                    0, 0 }; 
+
+/*  Set by SIGTERM or SIGINT to stop publishing or watching
+ */
+static volatile sig_atomic_t terminated = 0;
 
 
 /*  Report prototypes
  */
-static void default_report (struct prog_ctx *);
-static void simple_report (struct prog_ctx *);
-static void full_report (struct prog_ctx *);
-static void ue_report (struct prog_ctx *);
-static void ce_report (struct prog_ctx *);
-static void pci_report (struct prog_ctx *ctx);
+static void default_mc (struct prog_ctx *, struct report_state *,
+        const edac_mc *);
+static void default_csrow (struct prog_ctx *, struct report_state *,
+        const edac_mc *, const edac_csrow *);
+static void default_end (struct prog_ctx *, struct report_state *,
+        const struct edac_totals *);
+static void simple_mc (struct prog_ctx *, struct report_state *,
+        const edac_mc *);
+static void simple_end (struct prog_ctx *, struct report_state *,
+        const struct edac_totals *);
+static void full_csrow (struct prog_ctx *, struct report_state *,
+        const edac_mc *, const edac_csrow *);
+static void full_mc_end (struct prog_ctx *, struct report_state *,
+        const edac_mc *);
+static void ue_end (struct prog_ctx *, struct report_state *,
+        const struct edac_totals *);
+static void ce_end (struct prog_ctx *, struct report_state *,
+        const struct edac_totals *);
+static void pci_end (struct prog_ctx *, struct report_state *,
+        const struct edac_totals *);
 
 static struct report report_table[] = {
-    { EDAC_REPORT_DEFAULT, (report_f) default_report, "default" },
-    { EDAC_REPORT_SIMPLE,  (report_f) simple_report,  "simple"  },
-    { EDAC_REPORT_FULL,    (report_f) full_report,    "full"    },
-    { EDAC_REPORT_UE,      (report_f) ue_report,      "ue"      },
-    { EDAC_REPORT_CE,      (report_f) ce_report,      "ce"      },
-    { EDAC_REPORT_PCI,     (report_f) pci_report,     "pci"     },
-    { -1,                  NULL,                       NULL     }
+    { EDAC_REPORT_DEFAULT, "default", default_mc, default_csrow, NULL,
+                                      default_end },
+    { EDAC_REPORT_SIMPLE,  "simple",  simple_mc,  NULL,          NULL,
+                                      simple_end  },
+    { EDAC_REPORT_FULL,    "full",    NULL,       full_csrow,    full_mc_end,
+                                      NULL        },
+    { EDAC_REPORT_UE,      "ue",      NULL,       NULL,          NULL,
+                                      ue_end      },
+    { EDAC_REPORT_CE,      "ce",      NULL,       NULL,          NULL,
+                                      ce_end      },
+    { EDAC_REPORT_PCI,     "pci",     NULL,       NULL,          NULL,
+                                      pci_end     },
+    { -1,                  NULL,      NULL,       NULL,          NULL,
+                                      NULL        }
+};
+
+/*  Record format prototypes
+ */
+static void json_record (const struct record *, void *);
+static void csv_header (void);
+static void csv_record (const struct record *, void *);
+static void kv_record (const struct record *, void *);
+
+static struct format format_table[] = {
+    { "text", NULL,       NULL        },
+    { "json", NULL,       json_record },
+    { "csv",  csv_header, csv_record  },
+    { "kv",   NULL,       kv_record   },
+    { NULL,   NULL,       NULL        }
 };
 
 
@@ -137,8 +336,25 @@ static List report_list_create (List l);
 
 static void generate_reports (struct prog_ctx *ctx);
 
+static void walk_records (edac_handle *edac, int quiet, record_f f, 
+        void *arg);
+
+static void generate_records (struct prog_ctx *ctx);
+
 static int print_status (struct prog_ctx *ctx);
 
+static int publish (struct prog_ctx *ctx);
+
+static int watch (struct prog_ctx *ctx);
+
+static int export (struct prog_ctx *ctx);
+
+static int history (struct prog_ctx *ctx);
+
+static int layout (struct prog_ctx *ctx);
+
+static int events (struct prog_ctx *ctx);
+
 static void usage (void);
 
 static void log_fatal (int errnum, const char *format, ...);
@@ -168,6 +384,27 @@ int main (int ac, char *av[])
 
     parse_cmdline (&prog_ctx, ac, av);
 
+    /*  History files are read without the EDAC handle
+     */
+    if (prog_ctx.history) {
+        int rc = history (&prog_ctx);
+        prog_ctx_fini (&prog_ctx);
+        return (rc);
+    }
+
+    /*  So are tracepoint events
+     */
+    if (prog_ctx.events) {
+        int rc = events (&prog_ctx);
+        prog_ctx_fini (&prog_ctx);
+        return (rc);
+    }
+
+    /*  Read counters from a running publisher if there is one
+     */
+    if (!prog_ctx.publish)
+        edac_handle_attach_shm (prog_ctx.edac, NULL);
+
     if (edac_handle_init (prog_ctx.edac) < 0) {
         log_fatal (1, "Unable to get EDAC data: %s\n", 
                 edac_strerror (prog_ctx.edac));
@@ -177,8 +414,30 @@ int main (int ac, char *av[])
         return (print_status (&prog_ctx));
     }
 
+    if (prog_ctx.publish || prog_ctx.record || (prog_ctx.watch > 0.0)) {
+        int rc = (prog_ctx.watch > 0.0) ? watch (&prog_ctx) 
+                                        : publish (&prog_ctx);
+        prog_ctx_fini (&prog_ctx);
+        return (rc);
+    }
+
+    if (prog_ctx.layout) {
+        int rc = layout (&prog_ctx);
+        prog_ctx_fini (&prog_ctx);
+        return (rc);
+    }
+
+    if (prog_ctx.listen || prog_ctx.textfile) {
+        int rc = export (&prog_ctx);
+        prog_ctx_fini (&prog_ctx);
+        return (rc);
+    }
+
     if (edac_mc_count (prog_ctx.edac)) {
-        generate_reports (&prog_ctx);
+        if (prog_ctx.format && prog_ctx.format->record)
+            generate_records (&prog_ctx);
+        else
+            generate_reports (&prog_ctx);
     }
     else {
         log_err ("No memory controller data found.\n");
@@ -208,6 +467,8 @@ prog_ctx_fini (struct prog_ctx *ctx)
 {
     if (ctx->reports)
         list_destroy (ctx->reports);
+    if (ctx->thresholds)
+        free (ctx->thresholds);
     if (ctx->edac)
         edac_handle_destroy (ctx->edac);
     if (ctx->progname)
@@ -215,11 +476,171 @@ prog_ctx_fini (struct prog_ctx *ctx)
     return;
 }
 
+/*  Parse a window length such as "90", "90s", "5m", "1h" or "1d" into
+ *   `secs'. Returns -1 if `s' is not a valid duration.
+ */
+static int
+parse_duration (const char *s, unsigned int *secs)
+{
+    unsigned long n;
+    char *        p;
+
+    n = strtoul (s, &p, 10);
+    if ((p == s) || (n == 0))
+        return (-1);
+
+    switch (*p) {
+        case 'd':
+            n *= 24;
+            /* fall through */
+        case 'h':
+            n *= 60;
+            /* fall through */
+        case 'm':
+            n *= 60;
+            /* fall through */
+        case 's':
+            p++;
+            /* fall through */
+        case '\0':
+            break;
+        default:
+            return (-1);
+    }
+
+    if ((*p != '\0') || (n > UINT_MAX))
+        return (-1);
+
+    *secs = n;
+    return (0);
+}
+
+/*  Return the index of window `secs' in ctx->windows, adding it if
+ *   not already present.
+ */
+static unsigned int
+window_index (struct prog_ctx *ctx, unsigned int secs)
+{
+    unsigned int i;
+
+    for (i = 0; i < ctx->nwindows; i++) {
+        if (ctx->windows[i] == secs)
+            return (i);
+    }
+
+    if (ctx->nwindows == MAX_WINDOWS)
+        log_fatal (1, "Too many rate windows (max %d)\n", MAX_WINDOWS);
+
+    ctx->windows[ctx->nwindows] = secs;
+    return (ctx->nwindows++);
+}
+
+static void
+parse_windows (struct prog_ctx *ctx, const char *arg)
+{
+    unsigned int secs;
+    char *       str;
+    char *       tok;
+    char *       p;
+
+    if (!(str = strdup (arg)))
+        log_fatal (1, "Out of memory\n");
+
+    for (tok = strtok_r (str, ",", &p); tok; tok = strtok_r (NULL, ",", &p)) {
+        if (parse_duration (tok, &secs) < 0)
+            log_fatal (1, "Invalid window \"%s\"\n", tok);
+        window_index (ctx, secs);
+    }
+
+    free (str);
+}
+
+/*  Parse a --since or --until time: a duration ago, or "@SECS" since
+ *   the Epoch.
+ */
+static time_t
+parse_when (const char *s)
+{
+    unsigned int secs;
+    char *       p;
+    long long    t;
+
+    if (*s == '@') {
+        t = strtoll (s + 1, &p, 10);
+        if ((p == s + 1) || (*p != '\0') || (t <= 0))
+            log_fatal (1, "Invalid time \"%s\"\n", s);
+        return ((time_t) t);
+    }
+
+    if (parse_duration (s, &secs) < 0)
+        log_fatal (1, "Invalid time \"%s\"\n", s);
+
+    return (time (NULL) - secs);
+}
+
+/*  Parse --threshold=[LABEL@]WINDOW:COUNT. The window is kept in
+ *   seconds until resolve_thresholds () has the final window list.
+ */
+static void
+parse_threshold (struct prog_ctx *ctx, char *arg)
+{
+    struct threshold *t;
+    char *            window;
+    char *            count;
+    char *            p;
+
+    if (!(count = strrchr (arg, ':')))
+        log_fatal (1, "Invalid threshold \"%s\"\n", arg);
+    *count++ = '\0';
+
+    if ((window = strrchr (arg, '@'))) {
+        *window++ = '\0';
+        if (*arg == '\0')
+            log_fatal (1, "Invalid threshold label for \"%s\"\n", window);
+    } else {
+        window = arg;
+        arg =    NULL;
+    }
+
+    if (!(t = realloc (ctx->thresholds, 
+                       (ctx->nthresholds + 1) * sizeof (*t))))
+        log_fatal (1, "Out of memory\n");
+    ctx->thresholds = t;
+    t = &t[ctx->nthresholds++];
+
+    t->label = arg;
+    if (parse_duration (window, &t->window) < 0)
+        log_fatal (1, "Invalid threshold window \"%s\"\n", window);
+    t->count = strtoull (count, &p, 10);
+    if ((*count == '\0') || (*p != '\0') || (t->count == 0))
+        log_fatal (1, "Invalid threshold count \"%s\"\n", count);
+}
+
+/*  Convert threshold windows to indexes into ctx->windows, which
+ *   defaults to 1m,1h,24h when only --threshold was given.
+ */
+static void
+resolve_thresholds (struct prog_ctx *ctx)
+{
+    int i;
+
+    if (ctx->nthresholds && (ctx->nwindows == 0)) {
+        window_index (ctx, 60);
+        window_index (ctx, 3600);
+        window_index (ctx, 86400);
+    }
+
+    for (i = 0; i < ctx->nthresholds; i++)
+        ctx->thresholds[i].window = 
+            window_index (ctx, ctx->thresholds[i].window);
+}
+
 static void
 parse_cmdline (struct prog_ctx *ctx, int ac, char **av)
 {
     int   c;
     List  l;
+    char *p;
 
     opterr = 0; 
     l =      NULL;
@@ -245,6 +666,63 @@ parse_cmdline (struct prog_ctx *ctx, int ac, char **av)
             case 's':
                 ctx->print_status = 1;
                 break;
+            case 'P':
+                ctx->publish = 1;
+                break;
+            case 'i':
+                ctx->interval = strtoul (optarg, &p, 10);
+                if ((*p != '\0') || (ctx->interval == 0))
+                    log_fatal (1, "Invalid interval \"%s\"\n", optarg);
+                break;
+            case 'w':
+                ctx->watch = strtod (optarg, &p);
+                if ((*p != '\0') || !(ctx->watch > 0.0))
+                    log_fatal (1, "Invalid interval \"%s\"\n", optarg);
+                break;
+            case 'c':
+                ctx->count = strtoul (optarg, &p, 10);
+                if ((*p != '\0') || (ctx->count == 0))
+                    log_fatal (1, "Invalid count \"%s\"\n", optarg);
+                break;
+            case 'W':
+                parse_windows (ctx, optarg);
+                break;
+            case 'T':
+                parse_threshold (ctx, optarg);
+                break;
+            case 'f':
+                for (ctx->format = format_table; ctx->format->name; 
+                     ctx->format++) {
+                    if (strcmp (optarg, ctx->format->name) == 0)
+                        break;
+                }
+                if (!ctx->format->name)
+                    log_fatal (1, "Invalid format \"%s\"\n", optarg);
+                break;
+            case 'l':
+                ctx->listen = optarg;
+                break;
+            case 'o':
+                ctx->textfile = optarg;
+                break;
+            case 'R':
+                ctx->record = optarg;
+                break;
+            case 'H':
+                ctx->history = optarg;
+                break;
+            case 'L':
+                ctx->layout = 1;
+                break;
+            case 'E':
+                ctx->events = 1;
+                break;
+            case 'S':
+                ctx->since = parse_when (optarg);
+                break;
+            case 'U':
+                ctx->until = parse_when (optarg);
+                break;
             case 'r':
                 if (optarg)
                     l = list_append_from_string (l, optarg);
@@ -273,6 +751,75 @@ parse_cmdline (struct prog_ctx *ctx, int ac, char **av)
         log_fatal (1, "Only specify one of --report or --status\n");
     }
 
+    if (ctx->publish && ((l != NULL) || ctx->print_status)) {
+        log_fatal (1, "--publish may not be used with --report or --status\n");
+    }
+
+    if ((ctx->watch > 0.0) 
+       && ((l != NULL) || ctx->print_status || ctx->publish)) {
+        log_fatal (1, "--watch may not be used with --report, --status "
+                      "or --publish\n");
+    }
+
+    if (  ctx->format && ctx->format->record 
+       && ((l != NULL) || ctx->print_status || ctx->publish 
+          || (ctx->watch > 0.0))) {
+        log_fatal (1, "--format may not be used with --report, --status, "
+                      "--publish or --watch\n");
+    }
+
+    if (  (ctx->listen || ctx->textfile) 
+       && ((l != NULL) || ctx->print_status || ctx->publish 
+          || (ctx->watch > 0.0) || ctx->format)) {
+        log_fatal (1, "--listen and --textfile may not be used with "
+                      "--report, --status, --publish, --watch or --format\n");
+    }
+
+    if (ctx->listen && ctx->textfile) {
+        log_fatal (1, "Only specify one of --listen or --textfile\n");
+    }
+
+    if (ctx->count && !(ctx->watch > 0.0)) {
+        log_fatal (1, "--count requires --watch\n");
+    }
+
+    if ((ctx->nwindows || ctx->nthresholds) && !(ctx->watch > 0.0)) {
+        log_fatal (1, "--windows and --threshold require --watch\n");
+    }
+
+    resolve_thresholds (ctx);
+
+    if (  ctx->record
+       && ((l != NULL) || ctx->print_status || (ctx->watch > 0.0)
+          || ctx->format || ctx->listen || ctx->textfile)) {
+        log_fatal (1, "--record may only be used with --publish\n");
+    }
+
+    if (  ctx->history
+       && ((l != NULL) || ctx->print_status || ctx->publish || ctx->record
+          || (ctx->watch > 0.0) || ctx->format || ctx->listen 
+          || ctx->textfile)) {
+        log_fatal (1, "--history may not be used with other modes\n");
+    }
+
+    if (  ctx->layout
+       && ((l != NULL) || ctx->print_status || ctx->publish || ctx->record
+          || (ctx->watch > 0.0) || ctx->format || ctx->listen 
+          || ctx->textfile || ctx->history)) {
+        log_fatal (1, "--layout may not be used with other modes\n");
+    }
+
+    if (  ctx->events
+       && ((l != NULL) || ctx->print_status || ctx->publish || ctx->record
+          || (ctx->watch > 0.0) || ctx->format || ctx->listen 
+          || ctx->textfile || ctx->history || ctx->layout)) {
+        log_fatal (1, "--events may not be used with other modes\n");
+    }
+
+    if ((ctx->since || ctx->until) && !ctx->history) {
+        log_fatal (1, "--since and --until require --history\n");
+    }
+
     if (l == NULL)
         l = list_append_from_string (l, "default");
 
@@ -284,322 +831,2004 @@ parse_cmdline (struct prog_ctx *ctx, int ac, char **av)
     return;
 }
 
-static int
-print_status (struct prog_ctx *ctx)
+static void
+terminate_sighandler (int sig)
 {
-    edac_mc *           mc;
-    struct edac_mc_info mci;
-    char                buf [1024];
-    char *              p;
-    int                 count;
-    int                 n;
-    int                 len;
+    (void) sig;
+    terminated = 1;
+}
 
-    if (!ctx->edac) {
-        log_msg ("EDAC info unavailable.\n");
-        return (1);
-    } 
+/*  Stop on SIGTERM or SIGINT. Without SA_RESTART a blocking read or
+ *   sleep returns early, so the caller's loop sees `terminated' soon.
+ */
+static void
+terminate_on_signals (void)
+{
+    struct sigaction sa;
 
-    if ((count = edac_mc_count (ctx->edac)) == 0) {
-        log_msg ("EDAC drivers loaded. No memory controllers found\n");
+    memset (&sa, 0, sizeof (sa));
+    sa.sa_handler = terminate_sighandler;
+    sigemptyset (&sa.sa_mask);
+    sigaction (SIGTERM, &sa, NULL);
+    sigaction (SIGINT, &sa, NULL);
+}
+
+/*  Sample EDAC counters every ctx->interval seconds until terminated,
+ *   publishing them into the default shared-memory segment with
+ *   --publish and appending them to the history file with --record.
+ *   The segment is removed when the handle is destroyed.
+ */
+static int
+publish (struct prog_ctx *ctx)
+{
+    edac_history *hist = NULL;
+    int           rc = 0;
+
+    if (  ctx->record 
+       && !(hist = edac_history_create (ctx->edac, ctx->record, 0))) {
+        log_err ("Unable to open history file %s: %s\n", ctx->record,
+                 strerror (errno));
         return (1);
     }
 
-    if (!ctx->verbose) {
-        log_msg ("EDAC drivers are loaded. %u MC%sdetected\n",
-                count, (count > 1) ? "s " : " ");
-        return (0);
-    }
+    terminate_on_signals ();
 
-    p =   buf;
-    len = sizeof (buf);
+    log_verbose ("%s EDAC counters every %us\n", 
+                 ctx->publish ? "Publishing" : "Recording", ctx->interval);
 
-    n = snprintf (p, len, "EDAC drivers are loaded. %u MC%sdetected:\n", 
-            count, (count > 1) ? "s " : " ");
+    while (!terminated) {
+        if (ctx->publish) {
+            if (edac_handle_publish_shm (ctx->edac, NULL) < 0) {
+                log_err ("Unable to publish EDAC data: %s\n", 
+                         edac_strerror (ctx->edac));
+                rc = 1;
+                break;
+            }
+        }
+        else if (  (edac_handle_refresh (ctx->edac) < 0)
+                && (edac_handle_init (ctx->edac) < 0)) {
+            log_err ("Unable to get EDAC data: %s\n", 
+                     edac_strerror (ctx->edac));
+            rc = 1;
+            break;
+        }
 
-    if ((n < 0) || (n >= len)) {
-        p += len - 1;
-        len = 0;
-    }
-    else {
-        p += n;
-        len -= n;
+        if (hist && (edac_history_append (hist) < 0)) {
+            log_err ("Unable to record EDAC data in %s: %s\n", ctx->record,
+                     strerror (errno));
+            rc = 1;
+            break;
+        }
+
+        sleep (ctx->interval);
     }
 
-    edac_for_each_mc_info (ctx->edac, mc, mci) {
-        if (mci.mc_name[0] != '\0' || mci.mc_name[0] != '\n') {
+    edac_history_close (hist);
 
-            n = snprintf (p, len, "  %s:%s\n", mci.id, mci.mc_name);
+    return (rc);
+}
 
-            if ((n < 0) || (n >= len)) {
-                p += len - 1;
-                len = 0;
+/*  Copy the label of the DIMM or channel at `loc' in `snap' into `buf',
+ *   or its id if no label is registered.
+ */
+static void
+watch_label (const edac_snapshot *snap, const struct edac_location *loc,
+        char *buf, int len)
+{
+    struct edac_mc_info    mci;
+    struct edac_csrow_info csi;
+    struct edac_dimm_info  di;
+    unsigned int           i;
+    unsigned int           j;
+
+    snprintf (buf, len, "%s", loc->id);
+    if (loc->channel >= 0)
+        snprintf (buf, len, "ch%d", loc->channel);
+
+    for (i = 0; edac_snapshot_mc_info (snap, i, &mci) == 0; i++) {
+        if (strcmp (mci.id, loc->mc_id) != 0)
+            continue;
+
+        if (loc->type == EDAC_COUNTER_CHANNEL_CE) {
+            for (j = 0; edac_snapshot_csrow_info (snap, i, j, &csi) == 0; j++) {
+                struct edac_channel *ch = &csi.channel[loc->channel];
+                if ((strcmp (csi.id, loc->id) == 0) && ch->dimm_label_valid)
+                    snprintf (buf, len, "%s", ch->dimm_label);
             }
-            else {
-                p += n;
-                len -= n;
+        }
+        else {
+            for (j = 0; edac_snapshot_dimm_info (snap, i, j, &di) == 0; j++) {
+                if ((strcmp (di.id, loc->id) == 0) && di.dimm_label_valid)
+                    snprintf (buf, len, "%s", di.dimm_label);
             }
         }
+        break;
     }
-
-    *p = '\0';
-
-    fprintf (stdout, "%s: %s\n", ctx->progname, buf);
-
-    return (0);
 }
 
-static struct report *
-get_report_by_name (const char *str)
+/*  Describe counter location `loc' as a location prefix in `buf' (e.g.
+ *   "mc0: csrow1: DIMM_A1", using `label' for channels and DIMMs) and
+ *   the kind of errors it counts. Returns NULL for MC and csrow CE 
+ *   totals, which only repeat the channel and DIMM counts.
+ */
+static const char *
+location_describe (const struct edac_location *loc, const char *label,
+        char *buf, int len)
 {
-    struct report *r;
-
-    for (r = report_table; r->name != NULL; r++) {
-        if (strncmp (str, r->name, strlen (str)) == 0)
-            return (r);
+    switch (loc->type) {
+        case EDAC_COUNTER_MC_CE_NOINFO:
+            snprintf (buf, len, "%s", loc->mc_id);
+            return ("Corrected Errors with no DIMM info");
+        case EDAC_COUNTER_MC_UE_NOINFO:
+            snprintf (buf, len, "%s", loc->mc_id);
+            return ("Uncorrected Errors with no DIMM info");
+        case EDAC_COUNTER_CSROW_UE:
+            snprintf (buf, len, "%s: %s", loc->mc_id, loc->id);
+            return ("Uncorrected Errors");
+        case EDAC_COUNTER_CHANNEL_CE:
+            snprintf (buf, len, "%s: %s: %s", loc->mc_id, loc->id, label);
+            return ("Corrected Errors");
+        case EDAC_COUNTER_DIMM_CE:
+        case EDAC_COUNTER_DIMM_UE:
+            snprintf (buf, len, "%s: %s", loc->mc_id, label);
+            return ((loc->type == EDAC_COUNTER_DIMM_UE) ? "Uncorrected Errors"
+                                                        : "Corrected Errors");
+        case EDAC_COUNTER_PCI_PARITY:
+            snprintf (buf, len, "PCI");
+            return ("Parity Errors");
+        default:
+            break;
     }
-    
+
     return (NULL);
 }
 
-static int 
-report_find (struct report *r, char *name)
+/*  Returns nonzero if MC `mc_id' in `snap' has DIMMs. Its channel
+ *   counters then only repeat the DIMM counts.
+ */
+static int
+watch_mc_has_dimms (const edac_snapshot *snap, const char *mc_id)
 {
-    if (strcmp (r->name, name) == 0)
-        return (1);
+    struct edac_mc_info   mci;
+    struct edac_dimm_info di;
+    unsigned int          i;
+
+    for (i = 0; edac_snapshot_mc_info (snap, i, &mci) == 0; i++) {
+        if (strcmp (mci.id, mc_id) == 0)
+            return (edac_snapshot_dimm_info (snap, i, 0, &di) == 0);
+    }
     return (0);
 }
 
-static List
-report_list_create (List l)
+/*  As location_describe () for counter `counter' of the handle, with
+ *   labels from snapshot `snap'. Also returns NULL for the channels of
+ *   an MC with DIMMs, so that each error is displayed once.
+ */
+static const char *
+counter_describe (struct prog_ctx *ctx, const edac_snapshot *snap,
+        unsigned int counter, char *buf, int len)
 {
-    List reports;
-    ListIterator i;
-    char *str;
-    int got_err = 0;
+    struct edac_location loc;
+    char                 label[EDAC_LABEL_LEN] = "";
 
-    if (l == NULL)
+    if (edac_counter_location (ctx->edac, counter, &loc) < 0)
         return (NULL);
 
-    /*  No destroy needed for reports list
-     */
-    reports = list_create (NULL);
+    if (  (loc.type == EDAC_COUNTER_CHANNEL_CE)
+       && watch_mc_has_dimms (snap, loc.mc_id))
+        return (NULL);
 
-    i = list_iterator_create (l);
-    while ((str = list_next (i))) {
-        struct report *r = get_report_by_name (str);
-        if (r == NULL) {
-            log_err ("Invalid report: \"%s\"\n", str);
-            got_err = 1;
-        } 
-        else {
-            if (!list_find_first (reports, (ListFindF) report_find, r->name))
-                list_append (reports, r);
+    if (  (loc.type == EDAC_COUNTER_CHANNEL_CE)
+       || (loc.type == EDAC_COUNTER_DIMM_CE)
+       || (loc.type == EDAC_COUNTER_DIMM_UE))
+        watch_label (snap, &loc, label, sizeof (label));
+
+    return (location_describe (&loc, label, buf, len));
+}
+
+/*  Format window length `secs' as e.g. "90s", "5m", "1h" or "1d"
+ */
+static const char *
+window_name (unsigned int secs, char *buf, int len)
+{
+    if ((secs % 86400) == 0)
+        snprintf (buf, len, "%ud", secs / 86400);
+    else if ((secs % 3600) == 0)
+        snprintf (buf, len, "%uh", secs / 3600);
+    else if ((secs % 60) == 0)
+        snprintf (buf, len, "%um", secs / 60);
+    else
+        snprintf (buf, len, "%us", secs);
+    return (buf);
+}
+
+/*  Display the change in counter `d' over `secs' seconds, followed by
+ *   its error count in each window of `rate' if set.
+ */
+static void
+watch_print_delta (struct prog_ctx *ctx, const edac_snapshot *snap,
+        edac_rate *rate, const struct edac_delta *d, double secs)
+{
+    struct edac_rate_info info;
+    unsigned long long    n;
+    const char *          what;
+    char                  where[512];
+    char                  windows[256];
+    char                  name[16];
+    unsigned int          i;
+    int                   len = 0;
+
+    if (!(what = counter_describe (ctx, snap, d->counter, where, 
+                                   sizeof (where))))
+        return;
+
+    /*  A count lower than before means the counters were reset
+     */
+    n = (d->new_count >= d->old_count) ? d->new_count - d->old_count 
+                                       : d->new_count;
+
+    windows[0] = '\0';
+    for (i = 0; rate && (edac_rate_get (rate, d->counter, i, &info) == 0); 
+         i++) {
+        len += snprintf (windows + len, sizeof (windows) - len, "%s %s: %llu",
+                         i ? "," : ";", window_name (info.window, name, 
+                                                     sizeof (name)),
+                         info.count);
+        if (len >= (int) sizeof (windows))
+            break;
+    }
+
+    fprintf (stdout, "%s: %llu %s (%.2f/s%s)\n", where, n, what, n / secs, 
+             windows);
+}
+
+/*  Display the alerts raised by the last update of `rate'
+ */
+static void
+watch_print_alerts (struct prog_ctx *ctx, const edac_snapshot *snap,
+        edac_rate *rate, int n)
+{
+    struct edac_rate_alert *alerts;
+    struct edac_rate_info   info;
+    const char *            what;
+    char                    where[512];
+    char                    name[16];
+    int                     i;
+
+    if ((n <= 0) || !(alerts = malloc (n * sizeof (*alerts))))
+        return;
+
+    n = edac_rate_alerts (rate, alerts, n);
+
+    for (i = 0; i < n; i++) {
+        if (  !(what = counter_describe (ctx, snap, alerts[i].counter, 
+                                         where, sizeof (where)))
+           || (edac_rate_get (rate, alerts[i].counter, alerts[i].window, 
+                              &info) < 0))
+            continue;
+        fprintf (stdout, "%s: %llu %s within %s reached threshold %llu\n",
+                 where, alerts[i].count, what, 
+                 window_name (info.window, name, sizeof (name)),
+                 alerts[i].threshold);
+    }
+
+    free (alerts);
+}
+
+/*  Create the rate tracker for --watch, with ctx->windows and the
+ *   thresholds given by --threshold. A threshold with no label applies
+ *   to every DIMM, and to every channel of an MC without DIMMs; one
+ *   with a label only to those with that label.
+ */
+static edac_rate *
+watch_rate_create (struct prog_ctx *ctx)
+{
+    struct edac_location loc;
+    edac_snapshot *      snap;
+    edac_rate *          rate;
+    char                 label[EDAC_LABEL_LEN];
+    unsigned int         i;
+    int                  k;
+
+    if (!(rate = edac_rate_create (ctx->edac, ctx->windows, ctx->nwindows))) {
+        log_err ("Unable to track error rates: %s\n", 
+                 edac_strerror (ctx->edac));
+        return (NULL);
+    }
+
+    if ((ctx->nthresholds == 0) || !(snap = edac_snapshot_take (ctx->edac)))
+        return (rate);
+
+    for (i = 0; edac_counter_location (ctx->edac, i, &loc) == 0; i++) {
+        if (  (loc.type != EDAC_COUNTER_CHANNEL_CE)
+           && (loc.type != EDAC_COUNTER_DIMM_CE)
+           && (loc.type != EDAC_COUNTER_DIMM_UE))
+            continue;
+
+        /*  Only the DIMM counter of an error may reach a threshold
+         */
+        if (  (loc.type == EDAC_COUNTER_CHANNEL_CE)
+           && watch_mc_has_dimms (snap, loc.mc_id))
+            continue;
+
+        watch_label (snap, &loc, label, sizeof (label));
+
+        for (k = 0; k < ctx->nthresholds; k++) {
+            struct threshold *t = &ctx->thresholds[k];
+            if (!t->label || (strcmp (t->label, label) == 0))
+                edac_rate_set_threshold (rate, i, t->window, t->count);
+        }
+    }
+
+    edac_snapshot_destroy (snap);
+
+    return (rate);
+}
+
+static double
+timespec_diff (const struct timespec *a, const struct timespec *b)
+{
+    return ((a->tv_sec - b->tv_sec) + (a->tv_nsec - b->tv_nsec) / 1e9);
+}
+
+/*  Refresh counters in place every ctx->watch seconds and display the
+ *   errors which appeared since the previous sample, until terminated
+ *   or ctx->count samples after the initial baseline have been taken.
+ */
+static int
+watch (struct prog_ctx *ctx)
+{
+    struct itimerspec  its;
+    struct timespec    prev_ts = { 0, 0 };
+    struct timespec    ts;
+    struct edac_delta *deltas = NULL;
+    edac_snapshot *    prev = NULL;
+    edac_snapshot *    cur;
+    edac_rate *        rate = NULL;
+    unsigned long      samples = 0;
+    int                maxdeltas = 0;
+    int                nalerts = 0;
+    int                fd;
+    int                rc = 1;
+    int                i;
+    int                n;
+
+    if ((fd = timerfd_create (CLOCK_MONOTONIC, TFD_CLOEXEC)) < 0) {
+        log_err ("timerfd_create: %s\n", strerror (errno));
+        return (1);
+    }
+
+    memset (&its, 0, sizeof (its));
+    its.it_interval.tv_sec =  (time_t) ctx->watch;
+    its.it_interval.tv_nsec = (ctx->watch - its.it_interval.tv_sec) * 1e9;
+    its.it_value =            its.it_interval;
+
+    if (timerfd_settime (fd, 0, &its, NULL) < 0) {
+        log_err ("timerfd_settime: %s\n", strerror (errno));
+        close (fd);
+        return (1);
+    }
+
+    if (ctx->nwindows && !(rate = watch_rate_create (ctx))) {
+        close (fd);
+        return (1);
+    }
+
+    terminate_on_signals ();
+
+    while (!terminated) {
+        uint64_t expirations;
+
+        if (prev) {
+            if (read (fd, &expirations, sizeof (expirations)) < 0) {
+                if (errno == EINTR)
+                    continue;
+                log_err ("timerfd read: %s\n", strerror (errno));
+                break;
+            }
+        }
+
+        /*  If counters can no longer be refreshed (e.g. a shared-memory
+         *   publisher went away), reload and start a new baseline.
+         */
+        if (  (edac_handle_refresh (ctx->edac) < 0)
+           && (edac_handle_init (ctx->edac) < 0)) {
+            log_err ("Unable to get EDAC data: %s\n", 
+                     edac_strerror (ctx->edac));
+            break;
+        }
+
+        clock_gettime (CLOCK_MONOTONIC, &ts);
+
+        if (!(cur = edac_snapshot_take (ctx->edac))) {
+            log_err ("Unable to save EDAC counters: %s\n", 
+                     edac_strerror (ctx->edac));
+            break;
+        }
+
+        /*  Error rates are updated before the deltas are displayed so
+         *   they include the errors of this interval. If the handle was
+         *   reloaded the counters moved, so start again with new windows.
+         */
+        if (rate && ((nalerts = edac_rate_update (rate)) < 0)) {
+            edac_rate_destroy (rate);
+            if (!(rate = watch_rate_create (ctx))) {
+                edac_snapshot_destroy (cur);
+                break;
+            }
+            nalerts = edac_rate_update (rate);
+        }
+
+        if (prev && ((n = edac_snapshot_diff (prev, cur, deltas, 
+                                              maxdeltas)) > 0)) {
+            if (n > maxdeltas) {
+                struct edac_delta *p;
+                if (!(p = realloc (deltas, n * sizeof (*deltas)))) {
+                    log_err ("Out of memory\n");
+                    edac_snapshot_destroy (cur);
+                    break;
+                }
+                deltas =    p;
+                maxdeltas = n;
+                edac_snapshot_diff (prev, cur, deltas, maxdeltas);
+            }
+            for (i = 0; i < n; i++)
+                watch_print_delta (ctx, cur, rate, &deltas[i], 
+                                   timespec_diff (&ts, &prev_ts));
+        }
+        if (rate && (nalerts > 0))
+            watch_print_alerts (ctx, cur, rate, nalerts);
+        fflush (stdout);
+
+        if (prev) {
+            edac_snapshot_destroy (prev);
+            samples++;
+        }
+        prev =    cur;
+        prev_ts = ts;
+
+        if (ctx->count && (samples >= ctx->count)) {
+            rc = 0;
+            break;
+        }
+    }
+
+    if (terminated)
+        rc = 0;
+
+    if (prev)
+        edac_snapshot_destroy (prev);
+    if (rate)
+        edac_rate_destroy (rate);
+    free (deltas);
+    close (fd);
+
+    return (rc);
+}
+
+/*  Label of a counter in a history file, or its id if none was
+ *   recorded.
+ */
+static void
+history_label (const struct edac_location *loc, char *buf, int len)
+{
+    if (buf[0] != '\0')
+        return;
+    if (loc->channel >= 0)
+        snprintf (buf, len, "ch%d", loc->channel);
+    else
+        snprintf (buf, len, "%s", loc->id);
+}
+
+/*  Mark in `skip' the channel counters of history `hist' on MCs which
+ *   also recorded DIMM counters, as they only repeat the DIMM counts.
+ *   `skip' holds info->nvalues entries.
+ */
+static void
+history_skip_aliases (edac_history *hist, const struct edac_history_info *info,
+        unsigned char *skip)
+{
+    struct edac_location loc;
+    char                 label[EDAC_LABEL_LEN];
+    char (*              mcs)[EDAC_NAME_LEN];
+    unsigned int         nmcs = 0;
+    unsigned int         i;
+    unsigned int         j;
+
+    if (!(mcs = calloc (info->nvalues + 1, sizeof (*mcs))))
+        log_fatal (1, "Out of memory\n");
+
+    /*  DIMM counters are stored in MC order
+     */
+    for (i = 0; i < info->nvalues; i++) {
+        if (  (edac_history_location (hist, i, &loc, label, 
+                                      sizeof (label)) < 0)
+           || (loc.type != EDAC_COUNTER_DIMM_CE))
+            continue;
+        if (!nmcs || strcmp (mcs[nmcs - 1], loc.mc_id))
+            snprintf (mcs[nmcs++], sizeof (*mcs), "%s", loc.mc_id);
+    }
+
+    for (i = 0; nmcs && (i < info->nvalues); i++) {
+        if (  (edac_history_location (hist, i, &loc, label, 
+                                      sizeof (label)) < 0)
+           || (loc.type != EDAC_COUNTER_CHANNEL_CE))
+            continue;
+        for (j = 0; j < nmcs; j++) {
+            if (strcmp (mcs[j], loc.mc_id) == 0)
+                skip[i] = 1;
+        }
+    }
+
+    free (mcs);
+}
+
+/*  Display the errors recorded in history file ctx->history between
+ *   ctx->since and ctx->until, one line per counter which changed
+ *   between two samples. Only the records in range are read.
+ */
+static int
+history (struct prog_ctx *ctx)
+{
+    struct edac_history_info info;
+    struct edac_location     loc;
+    edac_history *           hist;
+    unsigned long long *     prev;
+    unsigned long long *     cur;
+    unsigned char *          skip;
+    unsigned long long       rec;
+    unsigned long long       end;
+    unsigned long long       n;
+    const char *             what;
+    char                     where[512];
+    char                     label[EDAC_LABEL_LEN];
+    char                     when[64];
+    time_t                   t;
+    unsigned int             i;
+
+    if (!(hist = edac_history_open (ctx->history))) {
+        log_err ("Unable to open history file %s: %s\n", ctx->history,
+                 strerror (errno));
+        return (1);
+    }
+
+    edac_history_info (hist, &info);
+
+    if (  !(prev = calloc (info.nvalues + 1, sizeof (*prev)))
+       || !(cur = calloc (info.nvalues + 1, sizeof (*cur)))
+       || !(skip = calloc (info.nvalues + 1, sizeof (*skip)))) 
+        log_fatal (1, "Out of memory\n");
+
+    history_skip_aliases (hist, &info, skip);
+
+    /*  Errors are counted from the last sample before `since', so the
+     *   first interval in range is included.
+     */
+    rec = ctx->since ? edac_history_find (hist, ctx->since) : info.first;
+    if (rec > info.first)
+        rec--;
+    end = ctx->until ? edac_history_find (hist, ctx->until + 1) : info.next;
+
+    /*  Skip records overwritten since info was taken
+     */
+    while ((rec < end) && (edac_history_read (hist, rec, &t, prev, 
+                                              info.nvalues) < 0))
+        rec++;
+
+    for (rec++; rec < end; rec++) {
+        if (edac_history_read (hist, rec, &t, cur, info.nvalues) < 0)
+            continue;
+
+        strftime (when, sizeof (when), "%Y-%m-%d %H:%M:%S", localtime (&t));
+
+        for (i = 0; i < info.nvalues; i++) {
+            if (skip[i] || (cur[i] == prev[i]))
+                continue;
+
+            /*  A count lower than before means the counters were reset
+             */
+            n = (cur[i] > prev[i]) ? cur[i] - prev[i] : cur[i];
+            prev[i] = cur[i];
+
+            if (  (n == 0) 
+               || (edac_history_location (hist, i, &loc, label, 
+                                          sizeof (label)) < 0))
+                continue;
+            history_label (&loc, label, sizeof (label));
+
+            if ((what = location_describe (&loc, label, where, 
+                                           sizeof (where))))
+                fprintf (stdout, "%s %s: %llu %s\n", when, where, n, what);
+        }
+    }
+
+    free (prev);
+    free (cur);
+    free (skip);
+    edac_history_close (hist);
+
+    return (0);
+}
+
+static const char *
+event_type_name (enum edac_event_type type)
+{
+    switch (type) {
+        case EDAC_EVENT_CORRECTED:   return ("Corrected");
+        case EDAC_EVENT_UNCORRECTED: return ("Uncorrected");
+        case EDAC_EVENT_DEFERRED:    return ("Deferred");
+        case EDAC_EVENT_FATAL:       return ("Fatal");
+        case EDAC_EVENT_INFO:        return ("Info");
+    }
+    return ("Unknown");
+}
+
+/*  Display a batch of ras:mc_event events, one line each
+ */
+static void
+events_print (const struct edac_event *events, int n, void *arg)
+{
+    const struct edac_event *e;
+    char                     where[128];
+    int                      len;
+    int                      i, j;
+
+    (void) arg;
+
+    for (e = events; e < events + n; e++) {
+        len = 0;
+        for (j = 0; j < EDAC_MAX_LAYERS; j++) {
+            if (e->layer[j] < 0)
+                continue;
+            i = snprintf (where + len, sizeof (where) - len, "%s%d",
+                          len ? ":" : " (location ", e->layer[j]);
+            if ((i < 0) || (len + i >= (int) sizeof (where) - 1))
+                break;
+            len += i;
+        }
+        if (len)
+            strcpy (where + len, ")");
+        else
+            where[0] = '\0';
+
+        fprintf (stdout, "[%llu.%06llu] mc%u: %s%s: %u %s Error%s at 0x%llx "
+                 "(grain %llu, syndrome 0x%llx)%s%s%s%s\n",
+                 e->timestamp / 1000000000ULL,
+                 (e->timestamp % 1000000000ULL) / 1000ULL,
+                 e->mc, e->label[0] ? e->label : "unknown", where,
+                 e->count, event_type_name (e->type),
+                 (e->count == 1) ? "" : "s", e->address, e->grain,
+                 e->syndrome,
+                 e->msg[0] ? ": " : "", e->msg,
+                 e->detail[0] ? ": " : "", e->detail);
+    }
+}
+
+/*  Display memory errors as the kernel logs them, by reading the
+ *   ras:mc_event tracepoint, until terminated or, when reading
+ *   recorded pages, until they are all displayed.
+ */
+static int
+events (struct prog_ctx *ctx)
+{
+    edac_events *      ev;
+    unsigned long long lost = 0;
+    int                rc = 0;
+
+    if (!(ev = edac_events_open (NULL, EDAC_EVENTS_ENABLE))) {
+        log_err ("Unable to read ras:mc_event events: %s\n",
+                 strerror (errno));
+        return (1);
+    }
+
+    terminate_on_signals ();
+
+    while (!terminated) {
+        if (edac_events_wait (ev, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != ENODATA) {
+                log_err ("Wait for events: %s\n", strerror (errno));
+                rc = 1;
+            }
+            break;
+        }
+        if (edac_events_dispatch (ev, events_print, ctx) < 0) {
+            log_err ("Read events: %s\n", strerror (errno));
+            rc = 1;
+            break;
+        }
+        if (edac_events_lost (ev) != lost) {
+            log_msg ("%llu events lost\n", edac_events_lost (ev) - lost);
+            lost = edac_events_lost (ev);
+        }
+        fflush (stdout);
+    }
+
+    edac_events_close (ev);
+
+    return (rc);
+}
+
+static int
+print_status (struct prog_ctx *ctx)
+{
+    edac_mc *           mc;
+    struct edac_mc_info mci;
+    char                buf [1024];
+    char *              p;
+    int                 count;
+    int                 n;
+    int                 len;
+
+    if (!ctx->edac) {
+        log_msg ("EDAC info unavailable.\n");
+        return (1);
+    } 
+
+    if ((count = edac_mc_count (ctx->edac)) == 0) {
+        log_msg ("EDAC drivers loaded. No memory controllers found\n");
+        return (1);
+    }
+
+    if (!ctx->verbose) {
+        log_msg ("EDAC drivers are loaded. %u MC%sdetected\n",
+                count, (count > 1) ? "s " : " ");
+        return (0);
+    }
+
+    p =   buf;
+    len = sizeof (buf);
+
+    n = snprintf (p, len, "EDAC drivers are loaded. %u MC%sdetected:\n", 
+            count, (count > 1) ? "s " : " ");
+
+    if ((n < 0) || (n >= len)) {
+        p += len - 1;
+        len = 0;
+    }
+    else {
+        p += n;
+        len -= n;
+    }
+
+    edac_for_each_mc_info (ctx->edac, mc, mci) {
+        if (mci.mc_name[0] != '\0' || mci.mc_name[0] != '\n') {
+
+            n = snprintf (p, len, "  %s:%s\n", mci.id, mci.mc_name);
+
+            if ((n < 0) || (n >= len)) {
+                p += len - 1;
+                len = 0;
+            }
+            else {
+                p += n;
+                len -= n;
+            }
+        }
+    }
+
+    *p = '\0';
+
+    fprintf (stdout, "%s: %s\n", ctx->progname, buf);
+
+    return (0);
+}
+
+static struct report *
+get_report_by_name (const char *str)
+{
+    struct report *r;
+
+    for (r = report_table; r->name != NULL; r++) {
+        if (strncmp (str, r->name, strlen (str)) == 0)
+            return (r);
+    }
+    
+    return (NULL);
+}
+
+static int 
+report_find (struct report *r, char *name)
+{
+    if (strcmp (r->name, name) == 0)
+        return (1);
+    return (0);
+}
+
+static List
+report_list_create (List l)
+{
+    List reports;
+    ListIterator i;
+    char *str;
+    int got_err = 0;
+
+    if (l == NULL)
+        return (NULL);
+
+    /*  No destroy needed for reports list
+     */
+    reports = list_create (NULL);
+
+    i = list_iterator_create (l);
+    while ((str = list_next (i))) {
+        struct report *r = get_report_by_name (str);
+        if (r == NULL) {
+            log_err ("Invalid report: \"%s\"\n", str);
+            got_err = 1;
+        } 
+        else {
+            if (!list_find_first (reports, (ListFindF) report_find, r->name))
+                list_append (reports, r);
+        }
+    }
+    list_iterator_destroy (i);
+
+    if (got_err) {
+        list_destroy (reports);
+        return (NULL);
+    }
+
+    return (reports);
+}
+
+/*  Make room for `n' more bytes and a NUL in `b'
+ */
+static void
+obuf_reserve (struct obuf *b, size_t n)
+{
+    size_t size = b->size ? b->size : 4096;
+    char * p;
+
+    if (b->len + n < b->size)
+        return;
+
+    while (b->len + n >= size)
+        size *= 2;
+
+    if (!(p = realloc (b->data, size)))
+        log_fatal (1, "Out of memory\n");
+
+    b->data = p;
+    b->size = size;
+}
+
+static void
+obuf_write (struct obuf *b, const char *str, size_t n)
+{
+    obuf_reserve (b, n);
+    memcpy (b->data + b->len, str, n);
+    b->len += n;
+    b->data[b->len] = '\0';
+}
+
+static void
+obuf_printf (struct obuf *b, const char *format, ...)
+{
+    va_list ap;
+    int     n;
+
+    obuf_reserve (b, 128);
+
+    va_start (ap, format);
+    n = vsnprintf (b->data + b->len, b->size - b->len, format, ap);
+    va_end (ap);
+
+    if (n < 0)
+        return;
+
+    if ((size_t) n >= b->size - b->len) {
+        obuf_reserve (b, n);
+        va_start (ap, format);
+        vsnprintf (b->data + b->len, b->size - b->len, format, ap);
+        va_end (ap);
+    }
+    b->len += n;
+}
+
+/*  Note that report `k' wrote the output from `off' to the end of
+ *   `o->buf', extending its last span when nothing came in between.
+ */
+static void
+report_output_mark (struct report_output *o, int k, size_t off)
+{
+    struct report_span *s;
+
+    if (o->buf.len == off)
+        return;
+
+    s = o->nspans ? &o->spans[o->nspans - 1] : NULL;
+    if (s && (s->report == k) && (s->off + s->len == off)) {
+        s->len = o->buf.len - s->off;
+        return;
+    }
+
+    if (o->nspans == o->size) {
+        int size = o->size ? o->size * 2 : 16;
+        if (!(s = realloc (o->spans, size * sizeof (*s))))
+            log_fatal (1, "Out of memory\n");
+        o->spans = s;
+        o->size = size;
+    }
+
+    s = &o->spans[o->nspans++];
+    s->report = k;
+    s->off =    off;
+    s->len =    o->buf.len - off;
+}
+
+/*  Run every report in ctx->reports over a single walk of the handle,
+ *   reading fields in place through the edac_mc_* and edac_csrow_*
+ *   accessors. All reports write to one buffer, which is written out
+ *   in the order the reports were requested.
+ */
+static void generate_reports (struct prog_ctx *ctx)
+{
+    ListIterator           i;
+    struct report *        r;
+    struct report **       reports;
+    struct report_state *  state;
+    struct report_output   out;
+    struct edac_totals     tot;
+    edac_mc *              mc;
+    edac_csrow *           csrow;
+    size_t                 off;
+    int                    need_csrows = 0;
+    int                    need_totals = 0;
+    int                    n = 0;
+    int                    j, k;
+    
+    if (!ctx->reports)
+        log_fatal (1, "No reports requested!");
+
+    reports = malloc (list_count (ctx->reports) * sizeof (*reports));
+    state = calloc (list_count (ctx->reports), sizeof (*state));
+    if (!reports || !state)
+        log_fatal (1, "Out of memory\n");
+
+    memset (&out, 0, sizeof (out));
+    obuf_reserve (&out.buf, 1);
+
+    i = list_iterator_create (ctx->reports);
+    while ((r = list_next (i))) {
+        state[n].out = &out.buf;
+        reports[n++] = r;
+        need_csrows |= (r->csrow != NULL);
+        need_totals |= (r->end != NULL);
+    }
+    list_iterator_destroy (i);
+
+    edac_handle_reset (ctx->edac);
+
+    while ((mc = edac_next_mc (ctx->edac))) {
+        for (k = 0; k < n; k++) {
+            if (reports[k]->mc_begin) {
+                off = out.buf.len;
+                reports[k]->mc_begin (ctx, &state[k], mc);
+                report_output_mark (&out, k, off);
+            }
+        }
+
+        if (need_csrows) {
+            edac_mc_reset (mc);
+            while ((csrow = edac_next_csrow (mc))) {
+                for (k = 0; k < n; k++) {
+                    if (reports[k]->csrow) {
+                        off = out.buf.len;
+                        reports[k]->csrow (ctx, &state[k], mc, csrow);
+                        report_output_mark (&out, k, off);
+                    }
+                }
+            }
+        }
+
+        for (k = 0; k < n; k++) {
+            if (reports[k]->mc_end) {
+                off = out.buf.len;
+                reports[k]->mc_end (ctx, &state[k], mc);
+                report_output_mark (&out, k, off);
+            }
+        }
+    }
+
+    edac_handle_reset (ctx->edac);
+
+    if (need_totals && (edac_error_totals (ctx->edac, &tot) < 0)) {
+        log_fatal (1, "Unable to get EDAC error totals: %s\n", 
+                   edac_strerror (ctx->edac));
+    }
+
+    for (k = 0; k < n; k++) {
+        if (reports[k]->end) {
+            off = out.buf.len;
+            reports[k]->end (ctx, &state[k], &tot);
+            report_output_mark (&out, k, off);
+        }
+    }
+
+    for (k = 0; k < n; k++) {
+        for (j = 0; j < out.nspans; j++) {
+            if (out.spans[j].report == k)
+                fwrite (out.buf.data + out.spans[j].off, 1, 
+                        out.spans[j].len, stdout);
+        }
+    }
+
+    free (out.spans);
+    free (out.buf.data);
+    free (state);
+    free (reports);
+    return;
+}
+
+/*  Label of channel `n' of `csrow', or "chN" if none is registered
+ */
+static const char *
+channel_label (const edac_csrow *csrow, int n, char *buf, int len)
+{
+    const char *label = edac_channel_label (csrow, n);
+
+    if (label)
+        return (label);
+    snprintf (buf, len, "ch%d", n);
+    return (buf);
+}
+
+static void 
+default_mc (struct prog_ctx *ctx, struct report_state *st, 
+        const edac_mc *mc)
+{
+    unsigned int ue = edac_mc_ue_noinfo_count (mc);
+    unsigned int ce = edac_mc_ce_noinfo_count (mc);
+
+    if (ue || ctx->verbose)
+        obuf_printf (st->out, "%s: %u Uncorrected Errors with no DIMM info\n",
+                edac_mc_id (mc), ue);
+
+    if (ce || ctx->verbose)
+        obuf_printf (st->out, "%s: %u Corrected Errors with no DIMM info\n",
+                edac_mc_id (mc), ce);
+
+    st->count += ce + ue;
+}
+
+static void 
+default_csrow (struct prog_ctx *ctx, struct report_state *st, 
+        const edac_mc *mc, const edac_csrow *csrow)
+{
+    const char * mc_id = edac_mc_id (mc);
+    const char * csrow_id = edac_csrow_id (csrow);
+    unsigned int ue = edac_csrow_ue_count (csrow);
+    char         chname[16];
+    int          i;
+
+    st->count += ue;
+
+    if (ue || ctx->verbose)
+        obuf_printf (st->out, "%s: %s: %u Uncorrected Errors\n",
+                mc_id, csrow_id, ue);
+
+    for (i = 0; i < EDAC_MAX_CHANNELS; i++) {
+        unsigned int ce;
+
+        if (!edac_channel_valid (csrow, i))
+            continue;
+
+        ce = edac_channel_ce_count (csrow, i);
+        st->count += ce;
+
+        if (ce || ctx->verbose)
+            obuf_printf (st->out, "%s: %s: %s: %u Corrected Errors\n", 
+                    mc_id, csrow_id, 
+                    channel_label (csrow, i, chname, sizeof (chname)), ce);
+    }
+}
+
+static void 
+default_end (struct prog_ctx *ctx, struct report_state *st,
+        const struct edac_totals *tot)
+{
+    (void) tot;
+    if (!st->count && !ctx->quiet)
+        obuf_printf (st->out, "edac-util: No errors to report.\n");
+}
+
+static void 
+simple_mc (struct prog_ctx *ctx, struct report_state *st, 
+        const edac_mc *mc)
+{
+    unsigned int ce = edac_mc_ce_count (mc);
+    unsigned int ue = edac_mc_ue_count (mc);
+
+    if (!ctx->quiet || ce)
+        obuf_printf (st->out, "%s: Correctable errors:   %u\n", 
+                edac_mc_id (mc), ce);
+    if (!ctx->quiet || ue)
+        obuf_printf (st->out, "%s: Uncorrectable errors: %u\n",
+                edac_mc_id (mc), ue);
+
+    st->ue += ue;
+    st->ce += ce;
+}
+
+static void 
+simple_end (struct prog_ctx *ctx, struct report_state *st,
+        const struct edac_totals *tot)
+{
+    (void) tot;
+    if (!ctx->quiet || st->ce)
+        obuf_printf (st->out, "Total CE: %u\n", st->ce);
+    if (!ctx->quiet || st->ue)
+        obuf_printf (st->out, "Total UE: %u\n", st->ue);
+}
+
+static void 
+full_csrow (struct prog_ctx *ctx, struct report_state *st, 
+        const edac_mc *mc, const edac_csrow *csrow)
+{
+    const char * mc_id = edac_mc_id (mc);
+    const char * csrow_id = edac_csrow_id (csrow);
+    char         chname[16];
+    const char * label;
+    unsigned int ce;
+    int          i;
+
+    for (i = 0; i < EDAC_MAX_CHANNELS; i++) {
+        if (!edac_channel_valid (csrow, i))
+            continue;
+
+        label = channel_label (csrow, i, chname, sizeof (chname));
+        ce = edac_channel_ce_count (csrow, i);
+
+        if (ce || ctx->verbose)
+            obuf_printf (st->out, "%s: %s: %s: %u Corrected Errors\n", 
+                    mc_id, csrow_id, label, ce);
+
+        if (!ctx->quiet || edac_channel_ce_count (csrow, 1))
+            obuf_printf (st->out, "%s:%s:%s:CE:%u\n", 
+                    mc_id, csrow_id, label, ce);
+    }
+}
+
+static void 
+full_mc_end (struct prog_ctx *ctx, struct report_state *st, 
+        const edac_mc *mc)
+{
+    unsigned int ue = edac_mc_ue_noinfo_count (mc);
+    unsigned int ce = edac_mc_ce_noinfo_count (mc);
+
+    if (!ctx->quiet || ue)
+        obuf_printf (st->out, "%s:noinfo:all:UE:%u\n", edac_mc_id (mc), ue);
+    if (!ctx->quiet || ce)
+        obuf_printf (st->out, "%s:noinfo:all:CE:%u\n", edac_mc_id (mc), ce);
+}
+
+static void 
+ue_end (struct prog_ctx *ctx, struct report_state *st,
+        const struct edac_totals *tot)
+{
+    if (!ctx->quiet || tot->ue_total)
+        obuf_printf (st->out, "UE: %u\n", tot->ue_total);
+}
+
+static void
+ce_end (struct prog_ctx *ctx, struct report_state *st,
+        const struct edac_totals *tot)
+{
+    if (!ctx->quiet || tot->ce_total)
+        obuf_printf (st->out, "CE: %u\n", tot->ce_total);
+}
+
+static void
+pci_end (struct prog_ctx *ctx, struct report_state *st,
+        const struct edac_totals *tot)
+{
+    if (!ctx->quiet || tot->pci_parity_total)
+        obuf_printf (st->out, "PCI Parity Errors: %u\n", 
+                tot->pci_parity_total);
+}
+
+/*  Call `f' on every error count in `edac' as a record, in one pass
+ *   over MCs and their csrows or DIMMs. Channel records carry CE
+ *   counts, a csrow's UE count is in a record with no channel, and
+ *   noinfo counts are in a record with csrow "noinfo". Summing `ce' or
+ *   `ue' over records of one layout gives the MC totals. If `quiet',
+ *   records with no errors are skipped.
+ */
+static void
+walk_records (edac_handle *edac, int quiet, record_f f, void *arg)
+{
+    struct record  r;
+    edac_mc *      mc;
+    edac_csrow *   csrow;
+    edac_dimm *    dimm;
+    int            i;
+
+    edac_handle_reset (edac);
+
+    while ((mc = edac_next_mc (edac))) {
+        memset (&r, 0, sizeof (r));
+        r.type =    RECORD_NOINFO;
+        r.mc =      edac_mc_id (mc);
+        r.csrow =   "noinfo";
+        r.channel = -1;
+        r.ce =      edac_mc_ce_noinfo_count (mc);
+        r.ue =      edac_mc_ue_noinfo_count (mc);
+        if (!quiet || r.ce || r.ue)
+            f (&r, arg);
+
+        edac_mc_reset (mc);
+
+        while ((csrow = edac_next_csrow (mc))) {
+            r.type =    RECORD_CSROW;
+            r.csrow =   edac_csrow_id (csrow);
+            r.channel = -1;
+            r.ce =      0;
+            r.ue =      edac_csrow_ue_count (csrow);
+            if (!quiet || r.ue)
+                f (&r, arg);
+
+            r.type = RECORD_CHANNEL;
+            for (i = 0; i < EDAC_MAX_CHANNELS; i++) {
+                if (!edac_channel_valid (csrow, i))
+                    continue;
+                r.channel = i;
+                r.label =   edac_channel_label (csrow, i);
+                r.ce =      edac_channel_ce_count (csrow, i);
+                r.ue =      0;
+                if (!quiet || r.ce)
+                    f (&r, arg);
+            }
+            r.label = NULL;
+        }
+
+        r.type =    RECORD_DIMM;
+        r.csrow =   NULL;
+        r.channel = -1;
+
+        while ((dimm = edac_next_dimm (mc))) {
+            r.dimm =  edac_dimm_id (dimm);
+            r.label = edac_dimm_label (dimm);
+            r.ce =    edac_dimm_ce_count (dimm);
+            r.ue =    edac_dimm_ue_count (dimm);
+            if (!quiet || r.ce || r.ue)
+                f (&r, arg);
         }
     }
-    list_iterator_destroy (i);
 
-    if (got_err) {
-        list_destroy (reports);
-        return (NULL);
+    edac_handle_reset (edac);
+}
+
+/*  Display all records in the --format chosen, through one buffer
+ */
+static void
+generate_records (struct prog_ctx *ctx)
+{
+    static char buf[65536];
+
+    setvbuf (stdout, buf, _IOFBF, sizeof (buf));
+
+    if (ctx->format->header)
+        ctx->format->header ();
+
+    walk_records (ctx->edac, ctx->quiet, ctx->format->record, NULL);
+
+    fflush (stdout);
+}
+
+/*  Write `str' as a JSON string, or null
+ */
+static void
+json_string (const char *str)
+{
+    const char *p;
+
+    if (str == NULL) {
+        fputs ("null", stdout);
+        return;
     }
 
-    return (reports);
+    putchar ('"');
+    for (p = str; *p; p++) {
+        unsigned char c = *p;
+        if ((c == '"') || (c == '\\'))
+            printf ("\\%c", c);
+        else if (c < 0x20)
+            printf ("\\u%04x", c);
+        else
+            putchar (c);
+    }
+    putchar ('"');
 }
 
-static void generate_reports (struct prog_ctx *ctx)
+/*  One JSON object per line
+ */
+static void
+json_record (const struct record *r, void *arg)
 {
-    ListIterator   i;
-    struct report *r;
-    
-    if (!ctx->reports)
-        log_fatal (1, "No reports requested!");
+    (void) arg;
+    fputs ("{\"mc\":", stdout);
+    json_string (r->mc);
+    fputs (",\"csrow\":", stdout);
+    json_string (r->csrow);
+    if (r->channel >= 0)
+        printf (",\"channel\":%d", r->channel);
+    else
+        fputs (",\"channel\":null", stdout);
+    fputs (",\"dimm\":", stdout);
+    json_string (r->dimm);
+    fputs (",\"label\":", stdout);
+    json_string (r->label);
+    printf (",\"ce\":%u,\"ue\":%u}\n", r->ce, r->ue);
+}
 
-    i = list_iterator_create (ctx->reports);
-    while ((r = list_next (i))) {
-        if (r->report != NULL)
-            r->report (ctx);
+/*  Write `str' as a CSV field, quoted only if needed. NULL is empty.
+ */
+static void
+csv_string (const char *str)
+{
+    const char *p;
+
+    if (str == NULL)
+        return;
+
+    if (!strpbrk (str, ",\"\r\n")) {
+        fputs (str, stdout);
+        return;
     }
-    list_iterator_destroy (i);
-    return;
+
+    putchar ('"');
+    for (p = str; *p; p++) {
+        if (*p == '"')
+            putchar ('"');
+        putchar (*p);
+    }
+    putchar ('"');
 }
 
-static void default_report (struct prog_ctx *ctx)
+static void
+csv_header (void)
 {
-    edac_mc *mc;
-    edac_csrow *csrow;
-    struct edac_mc_info mci;
-    struct edac_csrow_info csi;
-    int count = 0;
-    int i;
+    fputs ("mc,csrow,channel,dimm,label,ce,ue\n", stdout);
+}
 
-    edac_for_each_mc_info (ctx->edac, mc, mci) {
+static void
+csv_record (const struct record *r, void *arg)
+{
+    (void) arg;
+    csv_string (r->mc);
+    putchar (',');
+    csv_string (r->csrow);
+    putchar (',');
+    if (r->channel >= 0)
+        printf ("%d", r->channel);
+    putchar (',');
+    csv_string (r->dimm);
+    putchar (',');
+    csv_string (r->label);
+    printf (",%u,%u\n", r->ce, r->ue);
+}
 
-        if (mci.ue_noinfo_count || ctx->verbose)
-            fprintf (stdout, "%s: %u Uncorrected Errors with no DIMM info\n",
-                    mci.id, mci.ue_noinfo_count);
+/*  Write `key=str', quoting `str' if it is empty or has spaces or
+ *   quotes. NULL is written as an empty value.
+ */
+static void
+kv_string (const char *key, const char *str)
+{
+    const char *p;
 
-        if (mci.ce_noinfo_count || ctx->verbose)
-            fprintf (stdout, "%s: %u Corrected Errors with no DIMM info\n",
-                    mci.id, mci.ce_noinfo_count);
+    printf ("%s=", key);
 
-        count += mci.ce_noinfo_count + mci.ue_noinfo_count;
- 
-        edac_for_each_csrow_info (mc, csrow, csi) {
+    if (str == NULL)
+        return;
 
-            count += csi.ue_count;
+    if (*str && !strpbrk (str, " \t\"\\=\r\n")) {
+        fputs (str, stdout);
+        return;
+    }
 
-            if (csi.ue_count || ctx->verbose)
-                fprintf (stdout, 
-                        "%s: %s: %u Uncorrected Errors\n",
-                        mci.id, csi.id, csi.ue_count);
+    putchar ('"');
+    for (p = str; *p; p++) {
+        if ((*p == '"') || (*p == '\\'))
+            putchar ('\\');
+        putchar (*p);
+    }
+    putchar ('"');
+}
 
-            for (i = 0; i < EDAC_MAX_CHANNELS; i++) {
-                struct edac_channel *ch = &csi.channel[i];
-                
-                if (!ch->valid)
-                    continue;
+static void
+kv_record (const struct record *r, void *arg)
+{
+    (void) arg;
+    kv_string ("mc", r->mc);
+    putchar (' ');
+    kv_string ("csrow", r->csrow);
+    if (r->channel >= 0)
+        printf (" channel=%d ", r->channel);
+    else
+        fputs (" channel= ", stdout);
+    kv_string ("dimm", r->dimm);
+    putchar (' ');
+    kv_string ("label", r->label);
+    printf (" ce=%u ue=%u\n", r->ce, r->ue);
+}
 
-                if (!ch->dimm_label_valid)
-                    snprintf (ch->dimm_label, EDAC_LABEL_LEN, "ch%d", i);
+/*****************************************************************************
+ *  Prometheus exporter
+ *****************************************************************************/
 
-                count += ch->ce_count;
+/*  Counter families are split by the layout a record belongs to, so
+ *   that no error is counted in two series of one family: the csrow
+ *   and DIMM layouts each cover every located error, and noinfo
+ *   counts are in neither.
+ */
+enum metrics_layout {
+    METRICS_NOINFO,
+    METRICS_CSROW,
+    METRICS_DIMM,
+    METRICS_NLAYOUTS
+};
 
-                if (ch->ce_count || ctx->verbose)
-                    fprintf (stdout, "%s: %s: %s: %u Corrected Errors\n", 
-                            mci.id, csi.id, ch->dimm_label, ch->ce_count);
-            }
+static const struct {
+    const char *name;                       /* edac_<name>_*_errors          */
+    const char *ce_help;                    /* HELP of corrected family      */
+    const char *ue_help;                    /* HELP of uncorrected family    */
+} metrics_layouts[METRICS_NLAYOUTS] = {
+    { "noinfo",
+      "Corrected memory errors with no DIMM information.",
+      "Uncorrected memory errors with no DIMM information." },
+    { "csrow",
+      "Corrected memory errors by csrow channel.",
+      "Uncorrected memory errors by csrow." },
+    { "dimm",
+      "Corrected memory errors by DIMM.",
+      "Uncorrected memory errors by DIMM." },
+};
+
+/*  Per-family sample buffers filled by one walk of the records
+ */
+struct metrics {
+    struct obuf ce[METRICS_NLAYOUTS];
+    struct obuf ue[METRICS_NLAYOUTS];
+    struct obuf page;
+};
+
+/*  Append label `name="value"' with value escaped, if `value' is set
+ */
+static void
+metrics_label (struct obuf *b, const char *name, const char *value)
+{
+    const char *p;
+
+    if (value == NULL)
+        return;
+
+    obuf_printf (b, "%s%s=\"", (b->data[b->len - 1] == '{') ? "" : ",", name);
+    for (p = value; *p; p++) {
+        if (*p == '\n')
+            obuf_write (b, "\\n", 2);
+        else {
+            if ((*p == '"') || (*p == '\\'))
+                obuf_write (b, "\\", 1);
+            obuf_write (b, p, 1);
         }
     }
+    obuf_write (b, "\"", 1);
+}
 
-    if (!count && !ctx->quiet)
-        fprintf (stdout, "edac-util: No errors to report.\n");
+static void
+metrics_sample (struct obuf *b, enum metrics_layout layout, const char *kind,
+        const struct record *r, unsigned int value)
+{
+    char channel[16];
+
+    obuf_printf (b, "edac_%s_%s_errors_total{", metrics_layouts[layout].name,
+                 kind);
+    metrics_label (b, "mc", r->mc);
+    if (layout == METRICS_CSROW)
+        metrics_label (b, "csrow", r->csrow);
+    if (r->channel >= 0) {
+        snprintf (channel, sizeof (channel), "%d", r->channel);
+        metrics_label (b, "channel", channel);
+    }
+    metrics_label (b, "dimm", r->dimm);
+    metrics_label (b, "label", r->label);
+    obuf_printf (b, "} %u\n", value);
+}
 
-    edac_handle_reset (ctx->edac);
+static void
+metrics_record (const struct record *r, void *arg)
+{
+    struct metrics *    m = arg;
+    enum metrics_layout l;
+
+    if (r->type == RECORD_NOINFO)
+        l = METRICS_NOINFO;
+    else if (r->type == RECORD_DIMM)
+        l = METRICS_DIMM;
+    else
+        l = METRICS_CSROW;
+
+    if (r->type != RECORD_CSROW)
+        metrics_sample (&m->ce[l], l, "correctable", r, r->ce);
+    if (r->type != RECORD_CHANNEL)
+        metrics_sample (&m->ue[l], l, "uncorrectable", r, r->ue);
 }
 
-static void simple_report (struct prog_ctx *ctx)
+static void
+metrics_family (struct obuf *b, const char *name, const char *help,
+        int openmetrics)
 {
-    edac_mc *mc;
-    struct edac_mc_info info;
-    unsigned int ue;
-    unsigned int ce;
+    /*  OpenMetrics names the counter family without its _total suffix
+     */
+    const char *suffix = openmetrics ? "" : "_total";
+
+    obuf_printf (b, "# HELP %s%s %s\n", name, suffix, help);
+    obuf_printf (b, "# TYPE %s%s counter\n", name, suffix);
+}
+
+/*  Append the family of `kind' errors of layout `l' and its samples
+ *   in `samples' to `b'. Families with no series are left out.
+ */
+static void
+metrics_layout_family (struct obuf *b, enum metrics_layout l, 
+        const char *kind, const char *help, const struct obuf *samples,
+        int openmetrics)
+{
+    char name[64];
 
-    ue = ce = 0;
+    if (samples->len == 0)
+        return;
 
-    edac_for_each_mc_info (ctx->edac, mc, info) {
+    snprintf (name, sizeof (name), "edac_%s_%s_errors", 
+              metrics_layouts[l].name, kind);
+    metrics_family (b, name, help, openmetrics);
+    obuf_write (b, samples->data, samples->len);
+}
 
-        if (!ctx->quiet || info.ce_count)
-            fprintf (stdout, "%s: Correctable errors:   %u\n", 
-                    info.id, info.ce_count);
-        if (!ctx->quiet || info.ue_count)
-            fprintf (stdout, "%s: Uncorrectable errors: %u\n",
-                    info.id, info.ue_count);
+/*  Format all counters of ctx->edac into m->page, in OpenMetrics or
+ *   Prometheus text format. Buffers are reused, so once they have
+ *   grown to size this allocates nothing.
+ */
+static void
+metrics_format (struct prog_ctx *ctx, struct metrics *m, int openmetrics)
+{
+    struct edac_totals tot;
+    int                l;
 
-        ue += info.ue_count;
-        ce += info.ce_count;
+    m->page.len = 0;
+    for (l = 0; l < METRICS_NLAYOUTS; l++) {
+        m->ce[l].len = m->ue[l].len = 0;
+        obuf_reserve (&m->ce[l], 1);
+        obuf_reserve (&m->ue[l], 1);
     }
 
-    if (!ctx->quiet || ce)
-        fprintf (stdout, "Total CE: %u\n", ce);
-    if (!ctx->quiet || ue)
-        fprintf (stdout, "Total UE: %u\n", ue);
+    walk_records (ctx->edac, 0, metrics_record, m);
 
-    edac_handle_reset (ctx->edac);
+    for (l = 0; l < METRICS_NLAYOUTS; l++) {
+        metrics_layout_family (&m->page, l, "correctable", 
+                               metrics_layouts[l].ce_help, &m->ce[l],
+                               openmetrics);
+        metrics_layout_family (&m->page, l, "uncorrectable", 
+                               metrics_layouts[l].ue_help, &m->ue[l],
+                               openmetrics);
+    }
 
-    return;
+    if (edac_error_totals (ctx->edac, &tot) == 0) {
+        metrics_family (&m->page, "edac_pci_parity_errors", 
+                        "PCI parity errors.", openmetrics);
+        obuf_printf (&m->page, "edac_pci_parity_errors_total %u\n", 
+                     tot.pci_parity_total);
+    }
+
+    if (openmetrics)
+        obuf_write (&m->page, "# EOF\n", 6);
 }
 
-static void full_report (struct prog_ctx *ctx)
+/*  Refresh counters in place, reloading the handle if that fails
+ */
+static int
+export_refresh (struct prog_ctx *ctx)
 {
-    edac_mc *mc;
-    edac_csrow *csrow;
-    struct edac_mc_info mci;
-    struct edac_csrow_info csi;
-    int i;
-
-    edac_for_each_mc_info (ctx->edac, mc, mci) {
-        edac_for_each_csrow_info (mc, csrow, csi) {
+    if (  (edac_handle_refresh (ctx->edac) < 0)
+       && (edac_handle_init (ctx->edac) < 0)) {
+        log_err ("Unable to get EDAC data: %s\n", edac_strerror (ctx->edac));
+        return (-1);
+    }
+    return (0);
+}
 
+static int
+write_all (int fd, const char *p, size_t n)
+{
+    while (n > 0) {
+        ssize_t rc = send (fd, p, n, MSG_NOSIGNAL);
+        if (rc < 0) {
+            if (errno == EINTR)
+                continue;
+            return (-1);
+        }
+        p += rc;
+        n -= rc;
+    }
+    return (0);
+}
 
-            for (i = 0; i < EDAC_MAX_CHANNELS; i++) {
-                struct edac_channel *ch = &csi.channel[i];
-                
-                if (!ch->valid)
-                    continue;
+/*  Write metrics to `path' atomically, through a temporary file in the
+ *   same directory renamed over it.
+ */
+static int
+export_textfile (struct prog_ctx *ctx, struct metrics *m)
+{
+    char   tmp[4096];
+    int    fd;
+    size_t off;
 
-                if (!ch->dimm_label_valid)
-                    snprintf (ch->dimm_label, EDAC_LABEL_LEN, "ch%d", i);
+    metrics_format (ctx, m, 0);
 
-                if (ch->ce_count || ctx->verbose)
-                    fprintf (stdout, "%s: %s: %s: %u Corrected Errors\n", 
-                            mci.id, csi.id, ch->dimm_label, ch->ce_count);
+    if (snprintf (tmp, sizeof (tmp), "%s.XXXXXX", ctx->textfile) 
+        >= (int) sizeof (tmp)) {
+        log_err ("%s: File name too long\n", ctx->textfile);
+        return (-1);
+    }
 
-                if (!ctx->quiet || csi.channel[1].ce_count)
-                    fprintf (stdout, "%s:%s:%s:CE:%u\n", 
-                            mci.id, csi.id, ch->dimm_label,ch->ce_count);
-            }
+    if ((fd = mkstemp (tmp)) < 0) {
+        log_err ("%s: %s\n", tmp, strerror (errno));
+        return (-1);
+    }
 
+    for (off = 0; off < m->page.len; ) {
+        ssize_t rc = write (fd, m->page.data + off, m->page.len - off);
+        if (rc < 0) {
+            if (errno == EINTR)
+                continue;
+            log_err ("%s: %s\n", tmp, strerror (errno));
+            close (fd);
+            unlink (tmp);
+            return (-1);
         }
-
-        if (!ctx->quiet || mci.ue_noinfo_count)
-            fprintf (stdout, "%s:noinfo:all:UE:%u\n", 
-                    mci.id, mci.ue_noinfo_count);
-        if (!ctx->quiet || mci.ce_noinfo_count)
-            fprintf (stdout, "%s:noinfo:all:CE:%u\n", 
-                    mci.id, mci.ce_noinfo_count);
+        off += rc;
     }
 
-    return;
+    fchmod (fd, 0644);
+    close (fd);
 
+    if (rename (tmp, ctx->textfile) < 0) {
+        log_err ("%s: %s\n", ctx->textfile, strerror (errno));
+        unlink (tmp);
+        return (-1);
+    }
+
+    return (0);
 }
 
-static void 
-ue_report (struct prog_ctx *ctx)
+/*  Open a listening socket on `spec', of the form [ADDR:]PORT. ADDR
+ *   defaults to localhost, and IPv6 addresses are given in brackets.
+ */
+static int
+export_listen (const char *spec)
 {
-    struct edac_totals tot;
+    struct addrinfo  hints;
+    struct addrinfo *res;
+    struct addrinfo *ai;
+    char             host[256];
+    const char *     port;
+    const char *     p;
+    int              one = 1;
+    int              fd = -1;
+    int              rc;
+
+    if ((p = strrchr (spec, ':'))) {
+        port = p + 1;
+        if ((spec[0] == '[') && (p > spec) && (p[-1] == ']'))
+            snprintf (host, sizeof (host), "%.*s", (int) (p - spec - 2), 
+                      spec + 1);
+        else
+            snprintf (host, sizeof (host), "%.*s", (int) (p - spec), spec);
+    }
+    else {
+        port = spec;
+        snprintf (host, sizeof (host), "localhost");
+    }
 
-    if (edac_error_totals (ctx->edac, &tot) < 0) {
-        log_fatal (1, "Unable to get EDAC error totals: %s\n", 
-                   edac_strerror (ctx->edac));
+    memset (&hints, 0, sizeof (hints));
+    hints.ai_family =   AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags =    AI_PASSIVE;
+
+    if ((rc = getaddrinfo (host[0] ? host : NULL, port, &hints, &res)) != 0) {
+        log_err ("%s: %s\n", spec, gai_strerror (rc));
+        return (-1);
     }
 
-    if (!ctx->quiet || tot.ue_total)
-        fprintf (stdout, "UE: %u\n", tot.ue_total);
+    for (ai = res; ai; ai = ai->ai_next) {
+        if ((fd = socket (ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, 
+                          ai->ai_protocol)) < 0)
+            continue;
+        setsockopt (fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof (one));
+        if (  (bind (fd, ai->ai_addr, ai->ai_addrlen) == 0)
+           && (listen (fd, 16) == 0))
+            break;
+        close (fd);
+        fd = -1;
+    }
 
-    return;
+    if (fd < 0)
+        log_err ("%s: %s\n", spec, strerror (errno));
+
+    freeaddrinfo (res);
+
+    return (fd);
 }
 
+/*  Answer one HTTP request on `fd'. Any GET of / or /metrics refreshes
+ *   the counters and returns them, in OpenMetrics format if the client
+ *   accepts it.
+ */
 static void
-ce_report (struct prog_ctx *ctx)
+export_serve (struct prog_ctx *ctx, struct metrics *m, int fd)
 {
-    struct edac_totals tot;
+    struct timeval tv = { 5, 0 };
+    char           req[4096];
+    char           hdr[256];
+    const char *   status = "200 OK";
+    const char *   type;
+    size_t         len = 0;
+    int            openmetrics;
+    int            head;
+    int            n;
+
+    setsockopt (fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof (tv));
+    setsockopt (fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof (tv));
+
+    /*  Read the request head; any body is ignored
+     */
+    while (len < sizeof (req) - 1) {
+        ssize_t rc = recv (fd, req + len, sizeof (req) - 1 - len, 0);
+        if (rc <= 0)
+            return;
+        len += rc;
+        req[len] = '\0';
+        if (strstr (req, "\r\n\r\n") || strstr (req, "\n\n"))
+            break;
+    }
 
-    if (edac_error_totals (ctx->edac, &tot) < 0) {
-        log_fatal (1, "Unable to get EDAC error totals: %s\n", 
-                   edac_strerror (ctx->edac));
+    head = (strncmp (req, "HEAD ", 5) == 0);
+    openmetrics = (strstr (req, "application/openmetrics-text") != NULL);
+    m->page.len = 0;
+
+    if (!head && (strncmp (req, "GET ", 4) != 0))
+        status = "405 Method Not Allowed";
+    else if (  (strncmp (req + 4 + head, "/ ", 2) != 0)
+            && (strncmp (req + 4 + head, "/metrics", 8) != 0))
+        status = "404 Not Found";
+    else if (export_refresh (ctx) < 0)
+        status = "500 Internal Server Error";
+    else
+        metrics_format (ctx, m, openmetrics);
+
+    if (openmetrics)
+        type = "application/openmetrics-text; version=1.0.0; charset=utf-8";
+    else
+        type = "text/plain; version=0.0.4; charset=utf-8";
+
+    n = snprintf (hdr, sizeof (hdr), 
+                  "HTTP/1.0 %s\r\n"
+                  "Content-Type: %s\r\n"
+                  "Content-Length: %lu\r\n"
+                  "Connection: close\r\n\r\n",
+                  status, type, (unsigned long) m->page.len);
+
+    if ((write_all (fd, hdr, n) == 0) && !head)
+        write_all (fd, m->page.data, m->page.len);
+}
+
+/*  Export Prometheus metrics until terminated, either by serving them
+ *   on ctx->listen or by rewriting ctx->textfile every ctx->interval
+ *   seconds. The handle stays loaded, and only counters are reread
+ *   for each scrape or write.
+ */
+static int
+export (struct prog_ctx *ctx)
+{
+    struct metrics m;
+    int            rc = 0;
+    int            fd = -1;
+    int            l;
+
+    memset (&m, 0, sizeof (m));
+
+    if (ctx->listen && ((fd = export_listen (ctx->listen)) < 0))
+        return (1);
+
+    terminate_on_signals ();
+
+    while (!terminated) {
+        if (ctx->textfile) {
+            if (  (export_refresh (ctx) < 0) 
+               || (export_textfile (ctx, &m) < 0)) {
+                rc = 1;
+                break;
+            }
+            sleep (ctx->interval);
+        }
+        else {
+            int c = accept (fd, NULL, NULL);
+            if (c < 0) {
+                if (errno == EINTR || errno == ECONNABORTED)
+                    continue;
+                log_err ("accept: %s\n", strerror (errno));
+                rc = 1;
+                break;
+            }
+            export_serve (ctx, &m, c);
+            close (c);
+        }
     }
 
-    if (!ctx->quiet || tot.ce_total)
-        fprintf (stdout, "CE: %u\n", tot.ce_total);
+    if (fd >= 0)
+        close (fd);
+    for (l = 0; l < METRICS_NLAYOUTS; l++) {
+        free (m.ce[l].data);
+        free (m.ue[l].data);
+    }
+    free (m.page.data);
 
-    return;
+    return (rc);
 }
 
+/*  Append `n' copies of `c' to `b'
+ */
 static void
-pci_report (struct prog_ctx *ctx)
+obuf_fill (struct obuf *b, int c, size_t n)
 {
-    struct edac_totals tot;
+    obuf_reserve (b, n);
+    memset (b->data + b->len, c, n);
+    b->len += n;
+    b->data[b->len] = '\0';
+}
 
-    if (edac_error_totals (ctx->edac, &tot) < 0) {
-        log_fatal (1, "Unable to get EDAC error totals: %s\n", 
+/*  Append `str' centered in `width' columns, cut to fit
+ */
+static void
+obuf_center (struct obuf *b, const char *str, size_t width)
+{
+    size_t n = strlen (str);
+
+    if (n > width)
+        n = width;
+    obuf_fill (b, ' ', (width - n) / 2);
+    obuf_write (b, str, n);
+    obuf_fill (b, ' ', width - n - (width - n) / 2);
+}
+
+/*  Append a border line of `ncols' cells of `width' columns to `b'
+ */
+static void
+layout_border (struct obuf *b, int c, size_t indent, unsigned int ncols,
+        size_t width)
+{
+    obuf_fill (b, c, indent);
+    obuf_write (b, "+", 1);
+    obuf_fill (b, '-', ncols * (width + 1) - 1);
+    obuf_write (b, "+\n", 2);
+}
+
+/*  Draw the DIMMs of all MCs as a grid, as edac-ctl --layout does: one
+ *   row per position of the last location layer, highest first, and
+ *   one column per position of the MC and the other layers. Each cell
+ *   shows the size of its DIMM and, below, its corrected and 
+ *   uncorrected error counts. The grid is built from the library's
+ *   dense layout in one pass per row.
+ */
+static int
+layout (struct prog_ctx *ctx)
+{
+    struct edac_layout_info  info;
+    struct edac_layout_cell *cells;
+    struct edac_layout_cell *cell;
+    struct obuf              out = { NULL, 0, 0 };
+    edac_layout *            l;
+    char                     buf[64];
+    unsigned int             nrows;
+    unsigned int             ncols;
+    unsigned int             span;
+    unsigned int             i, r, c;
+    size_t                   width = 0;
+    size_t                   indent;
+    size_t                   n;
+    int                      j;
+
+    if (!(l = edac_layout_create (ctx->edac)))
+        log_fatal (1, "Unable to read DIMM layout: %s\n", 
                    edac_strerror (ctx->edac));
+
+    edac_layout_get_info (l, &info);
+
+    if (info.ndimms == 0) {
+        log_err ("No DIMM layout information. Old kernel?\n");
+        edac_layout_destroy (l);
+        return (1);
     }
 
-    if (!ctx->quiet || tot.pci_parity_total)
-        fprintf (stdout, "PCI Parity Errors: %u\n", tot.pci_parity_total);
+    if (!(cells = malloc (info.ncells * sizeof (*cells))))
+        log_fatal (1, "Out of memory\n");
 
-    return;
+    edac_layout_cells (l, cells, info.ncells);
+    edac_layout_destroy (l);
+
+    /*  Make cells wide enough for the largest size and counts
+     */
+    for (i = 0; i < info.ncells; i++) {
+        if (!cells[i].dimm)
+            continue;
+        n = snprintf (buf, sizeof (buf), "%u MB", cells[i].size_mb);
+        if (n > width)
+            width = n;
+        n = snprintf (buf, sizeof (buf), "CE %u UE %u", 
+                      cells[i].ce_count, cells[i].ue_count);
+        if (n > width)
+            width = n;
+    }
+    width += 2;
+
+    nrows =  info.layer_size[info.nlayers - 1];
+    ncols =  info.ncells / nrows;
+    indent = snprintf (buf, sizeof (buf), "%s%u: ", 
+                       info.layer[info.nlayers - 1], nrows - 1);
+
+    /*  One header line per column layer, each position spanning the
+     *   columns of the layers within it
+     */
+    layout_border (&out, ' ', indent, ncols, width);
+    span = ncols;
+    for (j = 0; j < info.nlayers - 1; j++) {
+        span /= info.layer_size[j];
+        obuf_fill (&out, ' ', indent);
+        for (c = 0; c < ncols; c += span) {
+            snprintf (buf, sizeof (buf), "%s%u", info.layer[j],
+                      (c / span) % info.layer_size[j]);
+            obuf_write (&out, "|", 1);
+            obuf_center (&out, buf, span * (width + 1) - 1);
+        }
+        obuf_write (&out, "|\n", 2);
+    }
+
+    /*  Cell (row r, column c) is cells[c * nrows + r]
+     */
+    for (r = nrows; r-- > 0; ) {
+        layout_border (&out, '-', indent, ncols, width);
+
+        snprintf (buf, sizeof (buf), "%s%u:", info.layer[info.nlayers - 1],
+                  r);
+        obuf_printf (&out, "%-*s", (int) indent, buf);
+        for (c = 0, cell = &cells[r]; c < ncols; c++, cell += nrows) {
+            if (cell->dimm)
+                snprintf (buf, sizeof (buf), "%u MB", cell->size_mb);
+            obuf_write (&out, "|", 1);
+            obuf_center (&out, cell->dimm ? buf : "", width);
+        }
+        obuf_write (&out, "|\n", 2);
+
+        obuf_fill (&out, ' ', indent);
+        for (c = 0, cell = &cells[r]; c < ncols; c++, cell += nrows) {
+            if (cell->dimm)
+                snprintf (buf, sizeof (buf), "CE %u UE %u", 
+                          cell->ce_count, cell->ue_count);
+            obuf_write (&out, "|", 1);
+            obuf_center (&out, cell->dimm ? buf : "", width);
+        }
+        obuf_write (&out, "|\n", 2);
+    }
+    layout_border (&out, '-', indent, ncols, width);
+
+    fwrite (out.data, 1, out.len, stdout);
+
+    free (out.data);
+    free (cells);
+
+    return (0);
 }
 
 static List list_append_from_string (List l, char *str)
@@ -0,0 +1,301 @@
+/*****************************************************************************
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2005-2007 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  Written by Mark Grondona <mgrondona@llnl.gov>
+ *  UCRL-CODE-230739.
+ *
+ *  This file is part of edac-utils.
+ *
+ *  This is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *****************************************************************************/
+
+/*
+ *  SMBIOS structure table reader.
+ *
+ *  The table is a sequence of structures, each a formatted area
+ *   starting with its type, length and handle, followed by a set of
+ *   NUL-terminated strings ending with an empty string. Fields of the
+ *   formatted area refer to strings by their index in this set,
+ *   starting at 1. The table is read into memory once and every lookup
+ *   walks it, which is cheap for the few kilobytes of a typical table.
+ */
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "smbios.h"
+
+#define SMBIOS_TYPE_SYSTEM     1
+#define SMBIOS_TYPE_BASEBOARD  2
+#define SMBIOS_TYPE_MEMDEV     17
+#define SMBIOS_TYPE_END        127
+
+/*****************************************************************************
+ *  Data Types
+ *****************************************************************************/
+
+struct smbios {
+    uint8_t *             data;             /* Structure table               */
+    size_t                len;              /* Size of table                 */
+};
+
+/*  One structure of the table
+ */
+struct smbios_struct {
+    const uint8_t *       hdr;              /* Formatted area                */
+    unsigned int          type;             /* Structure type                */
+    unsigned int          length;           /* Size of formatted area        */
+    const char *          strings;          /* String set                    */
+    const char *          end;              /* End of string set             */
+};
+
+/*****************************************************************************
+ *  Prototypes
+ *****************************************************************************/
+
+static int smbios_next (smbios_t *s, size_t *offp, struct smbios_struct *st);
+
+static void smbios_string (struct smbios_struct *st, unsigned int offset,
+        char *buf, size_t len);
+
+/*****************************************************************************
+ *  Functions
+ *****************************************************************************/
+
+smbios_t *
+smbios_open (const char *path)
+{
+    smbios_t *s;
+    ssize_t   n;
+    size_t    size = 4096;
+    int       fd;
+    int       saved;
+
+    if (!path)
+        path = SMBIOS_TABLE_PATH;
+
+    if (!(s = calloc (1, sizeof (*s))))
+        return (NULL);
+
+    if ((fd = open (path, O_RDONLY | O_CLOEXEC)) < 0)
+        goto fail;
+
+    /*  sysfs reports no useful size for the table, so read until EOF
+     */
+    for (;;) {
+        if (s->len == size || !s->data) {
+            uint8_t *data;
+            if (s->data)
+                size *= 2;
+            if (!(data = realloc (s->data, size)))
+                goto fail;
+            s->data = data;
+        }
+        if ((n = read (fd, s->data + s->len, size - s->len)) < 0) {
+            if (errno == EINTR)
+                continue;
+            goto fail;
+        }
+        if (n == 0)
+            break;
+        s->len += n;
+    }
+
+    close (fd);
+    return (s);
+
+  fail:
+    saved = errno;
+    if (fd >= 0)
+        close (fd);
+    smbios_close (s);
+    errno = saved;
+    return (NULL);
+}
+
+void
+smbios_close (smbios_t *s)
+{
+    if (!s)
+        return;
+    free (s->data);
+    free (s);
+}
+
+int
+smbios_board (smbios_t *s, char *vendor, size_t vlen, 
+        char *model, size_t mlen)
+{
+    struct smbios_struct st;
+    char                 sys_vendor[SMBIOS_STRING_LEN] = "";
+    char                 sys_model[SMBIOS_STRING_LEN] = "";
+    size_t               off = 0;
+
+    vendor[0] = model[0] = '\0';
+
+    while (smbios_next (s, &off, &st) > 0) {
+        if ((st.length < 6) || (vendor[0] && model[0]))
+            continue;
+        if (st.type == SMBIOS_TYPE_BASEBOARD) {
+            if (!vendor[0])
+                smbios_string (&st, 4, vendor, vlen);
+            if (!model[0])
+                smbios_string (&st, 5, model, mlen);
+        }
+        else if (st.type == SMBIOS_TYPE_SYSTEM && !sys_vendor[0]) {
+            smbios_string (&st, 4, sys_vendor, sizeof (sys_vendor));
+            smbios_string (&st, 5, sys_model, sizeof (sys_model));
+        }
+    }
+
+    if (!vendor[0])
+        strncpy (vendor, sys_vendor, vlen - 1)[vlen - 1] = '\0';
+    if (!model[0])
+        strncpy (model, sys_model, mlen - 1)[mlen - 1] = '\0';
+
+    return ((vendor[0] || model[0]) ? 0 : -1);
+}
+
+int
+smbios_memdevs (smbios_t *s, struct smbios_memdev *devs, int len)
+{
+    struct smbios_struct st;
+    size_t               off = 0;
+    int                  n = 0;
+
+    while (smbios_next (s, &off, &st) > 0) {
+        struct smbios_memdev *d;
+        unsigned int          size;
+
+        /*  Locators and size are present from SMBIOS 2.1
+         */
+        if ((st.type != SMBIOS_TYPE_MEMDEV) || (st.length < 0x15))
+            continue;
+
+        if (!devs || (n >= len)) {
+            n++;
+            continue;
+        }
+
+        d = &devs[n++];
+        d->handle = st.hdr[2] | (st.hdr[3] << 8);
+        smbios_string (&st, 0x10, d->locator, sizeof (d->locator));
+        smbios_string (&st, 0x11, d->bank_locator, sizeof (d->bank_locator));
+
+        /*  0 is an empty socket and 0xffff an unknown size. 0x7fff means
+         *   the size is in the 32-bit extended size field, and bit 15
+         *   gives the size in KB instead of MB.
+         */
+        size = st.hdr[0x0c] | (st.hdr[0x0d] << 8);
+        if (size == 0xffff)
+            d->size_mb = 0;
+        else if ((size == 0x7fff) && (st.length >= 0x20))
+            d->size_mb = (st.hdr[0x1c] | (st.hdr[0x1d] << 8) 
+                       | (st.hdr[0x1e] << 16) 
+                       | ((unsigned long) st.hdr[0x1f] << 24)) & 0x7fffffff;
+        else if (size & 0x8000)
+            d->size_mb = (size & 0x7fff) / 1024;
+        else
+            d->size_mb = size;
+    }
+
+    return (n);
+}
+
+/*****************************************************************************
+ *  Private Functions
+ *****************************************************************************/
+
+/*  Read the structure at offset *offp into `st' and advance *offp to the
+ *   next one. Returns 0 at the end of the table or at a truncated
+ *   structure.
+ */
+static int
+smbios_next (smbios_t *s, size_t *offp, struct smbios_struct *st)
+{
+    const char *end = (const char *) s->data + s->len;
+    const char *p;
+    size_t      off = *offp;
+
+    if ((off + 4 > s->len) || (s->data[off + 1] < 4)
+       || (off + s->data[off + 1] > s->len))
+        return (0);
+
+    st->hdr = s->data + off;
+    st->type = st->hdr[0];
+    st->length = st->hdr[1];
+    st->strings = (const char *) st->hdr + st->length;
+
+    /*  The string set ends with two NULs, even when it is empty
+     */
+    for (p = st->strings; p + 1 < end; p++) {
+        if (!p[0] && !p[1])
+            break;
+    }
+    if (p + 1 >= end)
+        return (0);
+
+    st->end = p + 1;
+    *offp = (const uint8_t *) p + 2 - s->data;
+
+    return (st->type != SMBIOS_TYPE_END);
+}
+
+/*  Copy the string referred to by the byte at `offset' in the formatted
+ *   area of `st' into `buf', without surrounding whitespace. Missing
+ *   strings are copied as "".
+ */
+static void
+smbios_string (struct smbios_struct *st, unsigned int offset, 
+        char *buf, size_t len)
+{
+    const char * p = st->strings;
+    unsigned int index;
+    size_t       n;
+
+    buf[0] = '\0';
+
+    if ((offset >= st->length) || !(index = st->hdr[offset]))
+        return;
+
+    while (--index && (p < st->end))
+        p += strlen (p) + 1;
+    if (p >= st->end)
+        return;
+
+    while (isspace ((unsigned char) *p))
+        p++;
+    for (n = strlen (p); n && isspace ((unsigned char) p[n - 1]); n--)
+        ;
+    if (n >= len)
+        n = len - 1;
+
+    memcpy (buf, p, n);
+    buf[n] = '\0';
+}
+
+/* vi: ts=4 sw=4 expandtab
+ */
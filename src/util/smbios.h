@@ -0,0 +1,80 @@
+/*****************************************************************************
+ *  $Id$
+ *****************************************************************************
+ *  Copyright (C) 2005-2007 The Regents of the University of California.
+ *  Produced at Lawrence Livermore National Laboratory (cf, DISCLAIMER).
+ *  Written by Mark Grondona <mgrondona@llnl.gov>
+ *  UCRL-CODE-230739.
+ *
+ *  This file is part of edac-utils.
+ *
+ *  This is free software; you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *****************************************************************************/
+
+/*
+ *  Minimal reader for the SMBIOS structure table exported by the kernel
+ *   in /sys/firmware/dmi/tables/DMI, for finding the mainboard and the
+ *   memory devices without running dmidecode(8).
+ */
+
+#ifndef _SMBIOS_H
+#define _SMBIOS_H
+
+#include <stddef.h>
+
+#define SMBIOS_TABLE_PATH     "/sys/firmware/dmi/tables/DMI"
+
+#define SMBIOS_STRING_LEN     64
+
+/*  One SMBIOS type 17 (Memory Device) structure
+ */
+struct smbios_memdev {
+    unsigned int  handle;                  /* Structure handle              */
+    unsigned long size_mb;                 /* Size in MB, 0 if empty        */
+    char          locator[SMBIOS_STRING_LEN];
+                                           /* Device locator (e.g. DIMM_A1) */
+    char          bank_locator[SMBIOS_STRING_LEN];
+                                           /* Bank locator (e.g. NODE 0)    */
+};
+
+typedef struct smbios smbios_t;
+
+/*
+ *  Read the SMBIOS table at `path', or SMBIOS_TABLE_PATH if NULL.
+ *   Returns NULL with errno set on failure.
+ */
+smbios_t * smbios_open (const char *path);
+
+void smbios_close (smbios_t *s);
+
+/*
+ *  Copy the mainboard vendor and model into `vendor' and `model', from
+ *   the type 2 (Baseboard) structure or, if it has none, from type 1
+ *   (System). Returns <0 if the table names neither.
+ */
+int smbios_board (smbios_t *s, char *vendor, size_t vlen, 
+        char *model, size_t mlen);
+
+/*
+ *  Copy up to `len' memory devices, in table order, into `devs'.
+ *   Returns the number of memory devices in the table, which may be
+ *   more than `len'. `devs' may be NULL to only count them.
+ */
+int smbios_memdevs (smbios_t *s, struct smbios_memdev *devs, int len);
+
+#endif /* !_SMBIOS_H */
+
+/* vi: ts=4 sw=4 expandtab
+ */